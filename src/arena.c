@@ -0,0 +1,50 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include "arena.h"
+
+void init_arena(Arena* arena) {
+    arena->head = NULL;
+    arena->size = 0;
+}
+
+void free_arena(Arena* arena) {
+    ArenaBlock* block = arena->head;
+    while (block != NULL) {
+        ArenaBlock* next = block->next;
+        free(block);
+        block = next;
+    }
+    init_arena(arena);
+}
+
+void* arena_alloc(Arena* arena, size_t size, size_t align) {
+    ArenaBlock* head = arena->head;
+    if (head != NULL) {
+        size_t used = (head->used + align - 1) & ~(align - 1);
+        if (used <= head->size && size <= head->size - used) {
+            head->used = used + size;
+            return head->data + used;
+        }
+    }
+    size_t block_size = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+    if (block_size > SIZE_MAX - sizeof(ArenaBlock)) {
+        return NULL;
+    }
+    ArenaBlock* block = malloc(sizeof(ArenaBlock) + block_size);
+    if (block == NULL) {
+        return NULL;
+    }
+    block->size = block_size;
+    block->used = size;
+    // A block of its own goes behind the head, so that the space left in
+    // the head is still used.
+    if (head != NULL && block_size > ARENA_BLOCK_SIZE) {
+        block->next = head->next;
+        head->next = block;
+    } else {
+        block->next = head;
+        arena->head = block;
+    }
+    arena->size += block_size;
+    return block->data;
+}
@@ -0,0 +1,44 @@
+/**
+ * arena.h
+ *
+ * Arena is a bump allocator for data that lives as long as a compilation
+ * stage, such as interned names. Allocations are carved out of large
+ * blocks and are only released all at once by `free_arena()`.
+ *
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// ArenaBlock is a block of memory of the arena, in a list from the newest.
+typedef struct ArenaBlock {
+    struct ArenaBlock* next;
+    size_t size;
+    size_t used;
+    _Alignas(16) char data[];
+} ArenaBlock;
+
+typedef struct Arena {
+    // The block allocations are carved out of.
+    ArenaBlock* head;
+    // The total number of bytes of the blocks.
+    size_t size;
+} Arena;
+
+// ARENA_BLOCK_SIZE is the size of the blocks of an arena. Larger
+// allocations get a block of their own.
+#define ARENA_BLOCK_SIZE (64 << 10)
+
+// init_arena initializes an empty arena.
+void init_arena(Arena* arena);
+
+// free_arena releases all the memory allocated from the arena.
+void free_arena(Arena* arena);
+
+// arena_alloc returns `size` bytes aligned to `align`, a power of two up
+// to 16, or NULL if the memory can't be allocated.
+void* arena_alloc(Arena* arena, size_t size, size_t align);
+
+#endif
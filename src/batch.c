@@ -0,0 +1,337 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "batch.h"
+#include "scan.h"
+
+// A range of file indices [lo, hi) is packed in a single word, so that the
+// owner and the thieves can update it with one compare-and-swap.
+#define RANGE(lo, hi) (((uint64_t)(hi) << 32) | (uint32_t)(lo))
+#define RANGE_LO(r)   ((size_t)(uint32_t)(r))
+#define RANGE_HI(r)   ((size_t)((r) >> 32))
+
+// Worker is the state of one thread of the pool.
+typedef struct Worker {
+    // The range of files left to this worker, on its own cache line.
+    _Alignas(64) _Atomic uint64_t range;
+    struct Batch* batch;
+    size_t id;
+    LexerState state;
+    TokenBuf tokens;
+} Worker;
+
+// Batch is the shared state of a call to `lex_batch()`.
+typedef struct Batch {
+    const char* const* paths;
+    BatchResult* results;
+    BatchVisitor visit;
+    void* ctx;
+    Worker* workers;
+    size_t nworkers;
+} Batch;
+
+// run_threads calls `fn` on each of the `n` items of `size` bytes at
+// `items`, each on its own thread but the first, which runs on the calling
+// thread. The items whose thread can't start run on the calling thread
+// once the others are done.
+static void run_threads(void* (*fn)(void*), void* items, size_t size, size_t n) {
+    char* item = items;
+    pthread_t* threads = malloc(n * sizeof(pthread_t));
+    size_t started = 1;
+    while (threads != NULL && started < n &&
+           pthread_create(&threads[started], NULL, fn, item + started * size) == 0) {
+        started++;
+    }
+    fn(item);
+    for (size_t i = 1; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    for (size_t i = started; i < n; i++) {
+        fn(item + i * size);
+    }
+    free(threads);
+}
+
+// take_file takes the next file from the front of the worker's range.
+static bool take_file(Worker* worker, size_t* index) {
+    uint64_t r = atomic_load(&worker->range);
+    while (RANGE_LO(r) < RANGE_HI(r)) {
+        if (atomic_compare_exchange_weak(&worker->range, &r, RANGE(RANGE_LO(r) + 1, RANGE_HI(r)))) {
+            *index = RANGE_LO(r);
+            return true;
+        }
+    }
+    return false;
+}
+
+// steal_files moves the back half of the range of another worker to the
+// worker, whose range is empty, and takes the first file of it.
+static bool steal_files(Worker* worker, size_t* index) {
+    Batch* batch = worker->batch;
+    for (size_t i = 1; i < batch->nworkers; i++) {
+        Worker* victim = &batch->workers[(worker->id + i) % batch->nworkers];
+        uint64_t r = atomic_load(&victim->range);
+        while (RANGE_LO(r) < RANGE_HI(r)) {
+            size_t lo = RANGE_LO(r), hi = RANGE_HI(r);
+            size_t mid = hi - (hi - lo + 1) / 2;
+            if (atomic_compare_exchange_weak(&victim->range, &r, RANGE(lo, mid))) {
+                atomic_store(&worker->range, RANGE(mid + 1, hi));
+                *index = mid;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// lex_file lexes one file of the batch with the worker's lexer.
+static void lex_file(Worker* worker, size_t index) {
+    Batch* batch = worker->batch;
+    BatchResult* result = &batch->results[index];
+    memset(result, 0, sizeof(*result));
+    result->kind = TOKEN_ERROR;
+
+    Source src;
+    result->err = open_source(&src, batch->paths[index]);
+    if (result->err != 0) {
+        return;
+    }
+    LexerState* state = &worker->state;
+    TokenBuf* tokens = &worker->tokens;
+    tokens->len = 0;
+    init_lexer_slice(state, src.text, src.len);
+    result->kind = lex_all(state, tokens);
+    result->error = state->error;
+    result->bytes = src.len;
+    result->tokens = tokens->len;
+    if (result->kind == TOKEN_ERROR && tokens->len > 0) {
+        locate_tokens(state, &tokens->buf[tokens->len - 1], 1);
+        result->token = tokens->buf[tokens->len - 1];
+    }
+    if (batch->visit != NULL) {
+        batch->visit(batch->ctx, index, &src, tokens);
+    }
+    free_lexer_state(state);
+    close_source(&src);
+}
+
+// run_worker lexes files until there are none left to take or steal.
+static void* run_worker(void* arg) {
+    Worker* worker = arg;
+    size_t index;
+    while (take_file(worker, &index) || steal_files(worker, &index)) {
+        lex_file(worker, index);
+    }
+    return NULL;
+}
+
+int lex_batch(const char* const* paths, size_t len, int threads,
+              BatchVisitor visit, void* ctx, BatchResult* results) {
+    if (len > UINT32_MAX) {
+        return EINVAL;
+    }
+    size_t nworkers = threads > 0 ? (size_t)threads : (size_t)sysconf(_SC_NPROCESSORS_ONLN);
+    if (nworkers > len) {
+        nworkers = len;
+    }
+    if (nworkers == 0) {
+        return 0;
+    }
+    Worker* workers = aligned_alloc(_Alignof(Worker), nworkers * sizeof(Worker));
+    if (workers == NULL) {
+        return ENOMEM;
+    }
+    Batch batch = { paths, results, visit, ctx, workers, nworkers };
+
+    // Start with contiguous ranges of the list, so that workers only
+    // contend once some of them run out of files.
+    for (size_t i = 0; i < nworkers; i++) {
+        Worker* worker = &workers[i];
+        memset(worker, 0, sizeof(*worker));
+        atomic_init(&worker->range, RANGE(len * i / nworkers, len * (i + 1) / nworkers));
+        worker->batch = &batch;
+        worker->id = i;
+        init_token_buf(&worker->tokens);
+    }
+
+    // The files of a worker that can't start are stolen by the others.
+    run_threads(run_worker, workers, sizeof(Worker), nworkers);
+    for (size_t i = 0; i < nworkers; i++) {
+        free_token_buf(&workers[i].tokens);
+    }
+    free(workers);
+    return 0;
+}
+
+// SPLIT_MIN_CHUNK is the least number of bytes per worker when
+// `lex_split()` chooses the number of workers.
+#define SPLIT_MIN_CHUNK (1 << 20)
+
+// Split is a chunk of the source lexed by one worker of `lex_split()`.
+typedef struct Split {
+    // The lexer of the chunk, from the speculative start of the chunk
+    // to the end of the source.
+    _Alignas(64) LexerState state;
+    TokenBuf tokens;
+    // The byte offsets of the start of the chunk and of the next one.
+    size_t from;
+    size_t limit;
+    // The tokens of the chunk kept by the stitch, and where they go.
+    size_t first;
+    size_t count;
+    Token* out;
+} Split;
+
+// lex_chunk lexes the tokens that start in the chunk. The token that ends
+// the chunk may run past it, and the first token starting after it is
+// left in the lexer state.
+static void* lex_chunk(void* arg) {
+    Split* split = arg;
+    split->state.current = split->state.source + split->from;
+    lex_until(&split->state, &split->tokens, split->limit);
+    return NULL;
+}
+
+// copy_chunk copies the tokens kept from the chunk to the output.
+static void* copy_chunk(void* arg) {
+    Split* split = arg;
+    memcpy(split->out, split->tokens.buf + split->first, split->count * sizeof(Token));
+    return NULL;
+}
+
+// find_token returns the index of the token starting at `offset`, or the
+// number of tokens if there is none.
+static size_t find_token(const TokenBuf* tokens, size_t offset) {
+    size_t lo = 0, hi = tokens->len;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (tokens->buf[mid].start < offset) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo < tokens->len && tokens->buf[lo].start == offset ? lo : tokens->len;
+}
+
+// stitch_chunks picks the tokens of each chunk that continue the tokens
+// of the chunks before it, and returns the chunk that ends the source.
+//
+// A chunk is lexed from the start of a line, which is almost always
+// between two tokens. It is confirmed once the previous chunks reach a
+// token that it starts too, and the tokens before that one are dropped.
+// Otherwise the chunk is lexed again from where the previous ones stop.
+static Split* stitch_chunks(Split* splits, size_t n) {
+    Split* last = &splits[0];
+    splits[0].count = splits[0].tokens.len;
+    for (size_t k = 1; k < n; k++) {
+        LexerState* prev = &last->state;
+        if (prev->token.start < last->limit || prev->error == LEXER_ENOMEM) {
+            // The source ended in the previous chunk.
+            break;
+        }
+        // The previous chunks stop at a token that starts here, or later.
+        Split* split = &splits[k];
+        size_t next = prev->token.start;
+        if (next >= split->limit) {
+            continue;
+        }
+        split->first = find_token(&split->tokens, next);
+        if (split->first == split->tokens.len) {
+            split->tokens.len = 0;
+            split->first = 0;
+            split->from = next;
+            bool utf8_valid = split->state.utf8_valid;
+            init_lexer_slice(&split->state, prev->source, prev->end - prev->source);
+            split->state.utf8_valid = utf8_valid;
+            lex_chunk(split);
+        }
+        split->count = split->tokens.len - split->first;
+        last = split;
+    }
+    return last;
+}
+
+TokenKind lex_split(LexerState* state, TokenBuf* tokens, int threads) {
+    size_t from = state->current - state->source;
+    size_t len = state->end - state->source;
+    size_t n = threads > 0 ? (size_t)threads : (size_t)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads <= 0 && n > (len - from) / SPLIT_MIN_CHUNK) {
+        n = (len - from) / SPLIT_MIN_CHUNK;
+    }
+    if (n <= 1) {
+        return lex_all(state, tokens);
+    }
+    Split* splits = aligned_alloc(_Alignof(Split), n * sizeof(Split));
+    if (splits == NULL) {
+        state->error = LEXER_ENOMEM;
+        return TOKEN_ERROR;
+    }
+
+    // Start the chunks at the lines closest after equal shares.
+    memset(splits, 0, n * sizeof(Split));
+    for (size_t k = 0; k < n; k++) {
+        Split* split = &splits[k];
+        init_lexer_slice(&split->state, state->source, len);
+        split->state.utf8_valid = state->utf8_valid;
+        init_token_buf(&split->tokens);
+        if (k > 0) {
+            const char* p = state->source + from + (len - from) * k / n;
+            const char* eol = scanner.find_eol(p, state->end);
+            split->from = eol < state->end ? (size_t)(eol + 1 - state->source) : len;
+            if (split->from < splits[k - 1].from) {
+                split->from = splits[k - 1].from;
+            }
+            splits[k - 1].limit = split->from;
+        } else {
+            split->from = from;
+        }
+    }
+    splits[n - 1].limit = SIZE_MAX;
+    run_threads(lex_chunk, splits, sizeof(Split), n);
+
+    Split* last = stitch_chunks(splits, n);
+    size_t total = 0;
+    for (Split* split = splits; split <= last; split++) {
+        total += split->count;
+    }
+    TokenKind kind;
+    if (reserve_token_buf(tokens, tokens->len + total)) {
+        for (Split* split = splits; split <= last; split++) {
+            split->out = tokens->buf + tokens->len;
+            tokens->len += split->count;
+        }
+        run_threads(copy_chunk, splits, sizeof(Split), last - splits + 1);
+        state->current = last->state.current;
+        state->error = last->state.error;
+        state->token = last->state.token;
+        kind = state->token.kind;
+        // The pool and the arena can't be shared by the workers, so the
+        // symbols are interned and the strings decoded once the tokens are
+        // in order.
+        Token* out = tokens->buf + tokens->len - total;
+        if (state->intern != NULL && !intern_tokens(state, out, total)) {
+            state->error = LEXER_ENOMEM;
+        }
+        if (state->strings != NULL && !decode_tokens(state, out, total)) {
+            state->error = LEXER_ENOMEM;
+        }
+    } else {
+        state->error = LEXER_ENOMEM;
+        kind = TOKEN_ERROR;
+    }
+    if (state->error == LEXER_ENOMEM) {
+        kind = TOKEN_ERROR;
+    }
+
+    for (size_t k = 0; k < n; k++) {
+        free_lexer_state(&splits[k].state);
+        free_token_buf(&splits[k].tokens);
+    }
+    free(splits);
+    return kind;
+}
@@ -0,0 +1,58 @@
+/**
+ * batch.h
+ *
+ * Batch lexes a list of source files, or a single large source, on a pool
+ * of threads.
+ *
+ * Each worker owns a range of the file list, takes files from the front of
+ * it, and steals half of the range of another worker once its own is empty.
+ * Every worker has its own lexer state and token buffer, reused from file
+ * to file. The results are stored by input index, so they don't depend on
+ * the scheduling.
+ *
+ * A single source is split into chunks at line starts, which are lexed
+ * speculatively in parallel and stitched together in order.
+ *
+ */
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stddef.h>
+#include "lexer.h"
+#include "source.h"
+
+// BatchResult is the outcome of lexing one file of a batch.
+typedef struct BatchResult {
+    // 0 on success, or the errno value of loading the file.
+    int err;
+    // TOKEN_EOF if the file was lexed, TOKEN_ERROR otherwise.
+    TokenKind kind;
+    // The lexer error, and the located token that failed.
+    LexerError error;
+    Token token;
+    // The size of the file and the number of tokens, with TOKEN_EOF.
+    size_t bytes;
+    size_t tokens;
+} BatchResult;
+
+// BatchVisitor is called by a worker for every file that was loaded, with
+// the index of the file in the list, its source and its tokens. They are
+// only valid during the call, and the calls happen in any order and on
+// any thread.
+typedef void (*BatchVisitor)(void* ctx, size_t index, const Source* src, const TokenBuf* tokens);
+
+// lex_batch lexes the `len` files at `paths` with `threads` workers, or one
+// per online processor if `threads` is 0, and stores the outcome of each
+// file at the same index in `results`. `visit` may be NULL.
+// It returns 0 on success, or an errno value if the batch can't be set up.
+int lex_batch(const char* const* paths, size_t len, int threads,
+              BatchVisitor visit, void* ctx, BatchResult* results);
+
+// lex_split tokenizes the rest of the source code like `lex_all()`, with
+// the source split into `threads` chunks lexed in parallel, or one chunk
+// per online processor and MB of source if `threads` is 0. The tokens
+// and the lexer state are the same as after `lex_all()`.
+TokenKind lex_split(LexerState* state, TokenBuf* tokens, int threads);
+
+#endif
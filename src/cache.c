@@ -0,0 +1,349 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "cache.h"
+
+// The header of a token file: the magic, the version, the length and the
+// hash of the source, the number of tokens, the number of names and the
+// error, in little endian.
+#define CACHE_MAGIC       "LXTK"
+#define CACHE_VERSION     1
+#define CACHE_HEADER_SIZE 40
+
+// CACHE_MAX_VARINT is the longest varint of a 64-bit value.
+#define CACHE_MAX_VARINT 10
+
+// has_name returns whether tokens of the kind have a name in the table.
+static inline bool has_name(TokenKind kind) {
+    return kind == TOKEN_IDENTIFIER || (kind >= TOKEN_CHAR_LITERAL && kind <= TOKEN_FLOAT_LITERAL);
+}
+
+uint64_t hash_source(const char* text, size_t len) {
+    uint64_t hash = 0x9e3779b97f4a7c15ull ^ len;
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t word;
+        memcpy(&word, text + i, 8);
+        hash = (hash ^ word) * 0xff51afd7ed558ccdull;
+        hash ^= hash >> 32;
+    }
+    for (; i < len; i++) {
+        hash = (hash ^ (uint8_t)text[i]) * 0xc4ceb9fe1a85ec53ull;
+    }
+    hash ^= hash >> 29;
+    return hash;
+}
+
+// Bytes is the growable buffer a token file is written to.
+typedef struct Bytes {
+    uint8_t* buf;
+    size_t len;
+    size_t cap;
+} Bytes;
+
+// reserve_bytes makes room for `size` more bytes.
+static bool reserve_bytes(Bytes* bytes, size_t size) {
+    if (bytes->cap - bytes->len >= size) {
+        return true;
+    }
+    size_t cap = bytes->cap == 0 ? 4096 : bytes->cap;
+    while (cap - bytes->len < size) {
+        cap <<= 1;
+    }
+    uint8_t* buf = realloc(bytes->buf, cap);
+    if (buf == NULL) {
+        return false;
+    }
+    bytes->buf = buf;
+    bytes->cap = cap;
+    return true;
+}
+
+// put_le writes the `size` low bytes of `value` in little endian. The room
+// must be reserved.
+static inline void put_le(Bytes* bytes, uint64_t value, int size) {
+    for (int i = 0; i < size; i++) {
+        bytes->buf[bytes->len++] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+// put_varint writes `value` 7 bits at a time, from the lowest, with the
+// high bit set on all bytes but the last. The room must be reserved.
+static inline void put_varint(Bytes* bytes, uint64_t value) {
+    while (value >= 0x80) {
+        bytes->buf[bytes->len++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    bytes->buf[bytes->len++] = (uint8_t)value;
+}
+
+// encode_tokens encodes the token file in `bytes`.
+static bool encode_tokens(Bytes* bytes, const LexerState* state, const TokenBuf* tokens) {
+    // Number the names in the order they first appear.
+    InternPool names;
+    init_intern_pool(&names);
+    Symbol* syms = malloc((tokens->len + 1) * sizeof(Symbol));
+    bool ok = syms != NULL;
+    for (size_t i = 0; ok && i < tokens->len; i++) {
+        const Token* token = &tokens->buf[i];
+        syms[i] = SYMBOL_NONE;
+        if (has_name(token->kind)) {
+            syms[i] = intern(&names, state->source + token->start, token->len);
+            ok = syms[i] != SYMBOL_NONE;
+        }
+    }
+
+    size_t len = state->end - state->source;
+    ok = ok && reserve_bytes(bytes, CACHE_HEADER_SIZE);
+    if (ok) {
+        memcpy(bytes->buf, CACHE_MAGIC, 4);
+        bytes->len = 4;
+        put_le(bytes, CACHE_VERSION, 4);
+        put_le(bytes, len, 8);
+        put_le(bytes, hash_source(state->source, len), 8);
+        put_le(bytes, tokens->len, 8);
+        put_le(bytes, names.len, 4);
+        put_le(bytes, state->error, 4);
+    }
+    for (size_t sym = 1; ok && sym <= names.len; sym++) {
+        const InternName* name = symbol_name(&names, (Symbol)sym);
+        ok = reserve_bytes(bytes, CACHE_MAX_VARINT + name->len);
+        if (ok) {
+            put_varint(bytes, name->len);
+            memcpy(bytes->buf + bytes->len, name->text, name->len);
+            bytes->len += name->len;
+        }
+    }
+
+    size_t end = 0;
+    for (size_t i = 0; ok && i < tokens->len; i++) {
+        const Token* token = &tokens->buf[i];
+        ok = reserve_bytes(bytes, 1 + 4 * CACHE_MAX_VARINT);
+        if (!ok) {
+            break;
+        }
+        bytes->buf[bytes->len++] = (uint8_t)token->kind;
+        put_varint(bytes, token->start - end);
+        put_varint(bytes, token->len);
+        end = token->start + token->len;
+        if (has_name(token->kind)) {
+            put_varint(bytes, syms[i]);
+        }
+        switch (token->kind) {
+            case TOKEN_CHAR_LITERAL:
+            case TOKEN_INT_LITERAL:
+                put_varint(bytes, token->value.i);
+                break;
+            case TOKEN_FLOAT_LITERAL:
+                put_le(bytes, token->value.i, 8);
+                break;
+            default:
+                break;
+        }
+    }
+    free(syms);
+    free_intern_pool(&names);
+    return ok;
+}
+
+// write_file writes the bytes to a temporary file renamed to `path`, so
+// that readers never see a partial file.
+static int write_file(const char* path, const Bytes* bytes) {
+    size_t len = strlen(path);
+    char* tmp = malloc(len + 5);
+    if (tmp == NULL) {
+        return ENOMEM;
+    }
+    memcpy(tmp, path, len);
+    memcpy(tmp + len, ".tmp", 5);
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        int err = errno;
+        free(tmp);
+        return err;
+    }
+    int err = 0;
+    for (size_t done = 0; done < bytes->len;) {
+        ssize_t n = write(fd, bytes->buf + done, bytes->len - done);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            err = errno;
+            break;
+        }
+        done += n;
+    }
+    if (close(fd) != 0 && err == 0) {
+        err = errno;
+    }
+    if (err == 0 && rename(tmp, path) != 0) {
+        err = errno;
+    }
+    if (err != 0) {
+        unlink(tmp);
+    }
+    free(tmp);
+    return err;
+}
+
+int save_tokens(const char* path, const LexerState* state, const TokenBuf* tokens) {
+    Bytes bytes = {0};
+    int err = encode_tokens(&bytes, state, tokens) ? write_file(path, &bytes) : ENOMEM;
+    free(bytes.buf);
+    return err;
+}
+
+// get_le reads `size` bytes in little endian.
+static inline uint64_t get_le(const uint8_t* p, int size) {
+    uint64_t value = 0;
+    for (int i = 0; i < size; i++) {
+        value |= (uint64_t)p[i] << (8 * i);
+    }
+    return value;
+}
+
+// get_varint reads a varint, or returns false if it overruns `end`.
+static inline bool get_varint(const uint8_t** p, const uint8_t* end, uint64_t* value) {
+    const uint8_t* q = *p;
+    // Most values fit in a byte.
+    if (q < end && *q < 0x80) {
+        *value = *q;
+        *p = q + 1;
+        return true;
+    }
+    uint64_t v = 0;
+    for (int shift = 0; shift < 7 * CACHE_MAX_VARINT && q < end; shift += 7) {
+        uint8_t byte = *q++;
+        v |= (uint64_t)(byte & 0x7f) << shift;
+        if (byte < 0x80) {
+            *value = v;
+            *p = q;
+            return true;
+        }
+    }
+    return false;
+}
+
+int open_token_cache(TokenCache* cache, const char* path, InternPool* pool) {
+    memset(cache, 0, sizeof(*cache));
+    int err = open_source(&cache->file, path);
+    if (err != 0) {
+        return err;
+    }
+    const uint8_t* p = (const uint8_t*)cache->file.text;
+    const uint8_t* end = p + cache->file.len;
+    if (cache->file.len < CACHE_HEADER_SIZE || memcmp(p, CACHE_MAGIC, 4) != 0 ||
+        get_le(p + 4, 4) != CACHE_VERSION || get_le(p + 36, 4) > LEXER_EDECCHR) {
+        close_token_cache(cache);
+        return EINVAL;
+    }
+    cache->source_len = get_le(p + 8, 8);
+    cache->source_hash = get_le(p + 16, 8);
+    cache->len = get_le(p + 24, 8);
+    cache->syms_len = get_le(p + 32, 4);
+    cache->error = get_le(p + 36, 4);
+    p += CACHE_HEADER_SIZE;
+
+    // Each name takes at least a byte.
+    if (cache->syms_len > (size_t)(end - p)) {
+        close_token_cache(cache);
+        return EINVAL;
+    }
+    cache->syms = malloc((cache->syms_len + 1) * sizeof(Symbol));
+    if (cache->syms == NULL) {
+        close_token_cache(cache);
+        return ENOMEM;
+    }
+    cache->syms[0] = SYMBOL_NONE;
+    for (size_t i = 1; i <= cache->syms_len; i++) {
+        uint64_t len;
+        if (!get_varint(&p, end, &len) || len > (uint64_t)(end - p)) {
+            close_token_cache(cache);
+            return EINVAL;
+        }
+        cache->syms[i] = SYMBOL_NONE;
+        if (pool != NULL) {
+            cache->syms[i] = intern(pool, (const char*)p, len);
+            if (cache->syms[i] == SYMBOL_NONE) {
+                close_token_cache(cache);
+                return ENOMEM;
+            }
+        }
+        p += len;
+    }
+    cache->tokens = p;
+    cache->end = end;
+    return 0;
+}
+
+void close_token_cache(TokenCache* cache) {
+    if (cache->file.base != NULL) {
+        close_source(&cache->file);
+    }
+    free(cache->syms);
+    memset(cache, 0, sizeof(*cache));
+}
+
+bool is_cache_fresh(const TokenCache* cache, const char* text, size_t len) {
+    return cache->source_len == len && cache->source_hash == hash_source(text, len);
+}
+
+int load_tokens(const TokenCache* cache, TokenBuf* tokens) {
+    // Each token takes at least 3 bytes.
+    if (cache->len > (size_t)(cache->end - cache->tokens) / 3) {
+        return EINVAL;
+    }
+    if (!reserve_token_buf(tokens, tokens->len + cache->len)) {
+        return ENOMEM;
+    }
+    const uint8_t* p = cache->tokens;
+    const uint8_t* end = cache->end;
+    Token* out = tokens->buf + tokens->len;
+    uint64_t offset = 0;
+    for (size_t i = 0; i < cache->len; i++) {
+        Token* token = &out[i];
+        memset(token, 0, sizeof(*token));
+        if (p == end || *p == TOKEN_NEED_INPUT || *p > TOKEN_WHILE) {
+            return EINVAL;
+        }
+        token->kind = *p++;
+        uint64_t gap, len;
+        if (!get_varint(&p, end, &gap) || !get_varint(&p, end, &len) ||
+            gap > cache->source_len - offset || len > cache->source_len - offset - gap) {
+            return EINVAL;
+        }
+        token->start = offset + gap;
+        token->len = len;
+        offset = token->start + len;
+        if (has_name(token->kind)) {
+            uint64_t sym;
+            if (!get_varint(&p, end, &sym) || sym > cache->syms_len) {
+                return EINVAL;
+            }
+            token->sym = cache->syms[sym];
+        }
+        switch (token->kind) {
+            case TOKEN_CHAR_LITERAL:
+            case TOKEN_INT_LITERAL:
+                if (!get_varint(&p, end, &token->value.i)) {
+                    return EINVAL;
+                }
+                break;
+            case TOKEN_FLOAT_LITERAL:
+                if (end - p < 8) {
+                    return EINVAL;
+                }
+                token->value.i = get_le(p, 8);
+                p += 8;
+                break;
+            default:
+                break;
+        }
+    }
+    tokens->len += cache->len;
+    return 0;
+}
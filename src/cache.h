@@ -0,0 +1,75 @@
+/**
+ * cache.h
+ *
+ * Cache saves the tokens of a source to a compact file, so that a later
+ * build step can load them instead of lexing the source again.
+ *
+ * The file starts with a header, which identifies the source by its length
+ * and hash, followed by the table of the names of the identifiers and the
+ * literals, each stored once, and by the tokens. Each token is its kind in
+ * one byte, then varints of the offset from the end of the previous token,
+ * of its length, of its index in the table, and of the value of an int or
+ * a char literal. A float literal is followed by the 8 bytes of its value.
+ * String literals are left to `decode_tokens()`.
+ *
+ * The file is mapped by the reader, which only interns the names of the
+ * table to its pool and decodes the tokens from the mapping.
+ *
+ */
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "intern.h"
+#include "lexer.h"
+#include "source.h"
+
+// TokenCache is a token file opened for reading.
+typedef struct TokenCache {
+    // The mapped file.
+    Source file;
+    // The length and the hash of the source the tokens were lexed from.
+    uint64_t source_len;
+    uint64_t source_hash;
+    // The error the lexer stopped at, if the last token is TOKEN_ERROR.
+    LexerError error;
+    // The number of tokens.
+    size_t len;
+    // The symbols of the names of the table in the pool of the reader, by
+    // index from 1.
+    Symbol* syms;
+    size_t syms_len;
+    // The encoded tokens.
+    const uint8_t* tokens;
+    const uint8_t* end;
+} TokenCache;
+
+// hash_source returns the hash a token file identifies its source by.
+uint64_t hash_source(const char* text, size_t len);
+
+// save_tokens writes the tokens lexed by `lex_all()` from the source of
+// the state to the file at the given path.
+// It returns 0 on success, or an errno value on failure.
+int save_tokens(const char* path, const LexerState* state, const TokenBuf* tokens);
+
+// open_token_cache maps the token file at the given path and interns the
+// names of its table to the pool, if any.
+// It returns 0 on success, EINVAL if the file is not a valid token file,
+// or another errno value on failure.
+int open_token_cache(TokenCache* cache, const char* path, InternPool* pool);
+
+// close_token_cache releases the file opened by `open_token_cache()`.
+void close_token_cache(TokenCache* cache);
+
+// is_cache_fresh returns whether the tokens were lexed from the given source.
+bool is_cache_fresh(const TokenCache* cache, const char* text, size_t len);
+
+// load_tokens appends the tokens of the file to the buffer, with the
+// symbols of the pool it was opened with.
+// It returns 0 on success, EINVAL if the tokens are corrupt, or ENOMEM.
+int load_tokens(const TokenCache* cache, TokenBuf* tokens);
+
+#endif
@@ -0,0 +1,94 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "intern.h"
+
+// INTERN_MIN_CAP is the number of slots of the hash table when it's first
+// allocated.
+#define INTERN_MIN_CAP 1024
+
+void init_intern_pool(InternPool* pool) {
+    memset(pool, 0, sizeof(*pool));
+    init_arena(&pool->arena);
+}
+
+void free_intern_pool(InternPool* pool) {
+    free(pool->slots);
+    free(pool->names);
+    free_arena(&pool->arena);
+    init_intern_pool(pool);
+}
+
+// grow_slots doubles the hash table and moves the symbols to their new slots.
+static bool grow_slots(InternPool* pool) {
+    size_t cap = pool->cap == 0 ? INTERN_MIN_CAP : pool->cap * 2;
+    InternSlot* slots = calloc(cap, sizeof(InternSlot));
+    if (slots == NULL) {
+        return false;
+    }
+    for (size_t i = 0; i < pool->cap; i++) {
+        InternSlot slot = pool->slots[i];
+        if (slot.sym != SYMBOL_NONE) {
+            size_t j = slot.hash & (cap - 1);
+            while (slots[j].sym != SYMBOL_NONE) {
+                j = (j + 1) & (cap - 1);
+            }
+            slots[j] = slot;
+        }
+    }
+    free(pool->slots);
+    pool->slots = slots;
+    pool->cap = cap;
+    return true;
+}
+
+// add_name copies the name to the arena and returns its new symbol.
+static Symbol add_name(InternPool* pool, const char* text, size_t len, uint32_t hash) {
+    if (len > UINT32_MAX || pool->len >= UINT32_MAX - 1) {
+        return SYMBOL_NONE;
+    }
+    if (pool->len + 1 >= pool->names_cap) {
+        size_t cap = pool->names_cap == 0 ? 256 : pool->names_cap * 2;
+        InternName* names = realloc(pool->names, cap * sizeof(InternName));
+        if (names == NULL) {
+            return SYMBOL_NONE;
+        }
+        pool->names = names;
+        pool->names_cap = cap;
+    }
+    char* copy = arena_alloc(&pool->arena, len + 1, 1);
+    if (copy == NULL) {
+        return SYMBOL_NONE;
+    }
+    memcpy(copy, text, len);
+    copy[len] = '\0';
+    Symbol sym = (Symbol)++pool->len;
+    pool->names[sym] = (InternName){ copy, (uint32_t)len, hash };
+    return sym;
+}
+
+Symbol intern_hashed(InternPool* pool, const char* text, size_t len, uint32_t hash) {
+    if ((pool->len + 1) * 2 > pool->cap && !grow_slots(pool)) {
+        return SYMBOL_NONE;
+    }
+    size_t mask = pool->cap - 1;
+    size_t i = hash & mask;
+    while (true) {
+        InternSlot* slot = &pool->slots[i];
+        if (slot->sym == SYMBOL_NONE) {
+            Symbol sym = add_name(pool, text, len, hash);
+            if (sym != SYMBOL_NONE) {
+                slot->hash = hash;
+                slot->sym = sym;
+            }
+            return sym;
+        }
+        if (slot->hash == hash) {
+            const InternName* name = &pool->names[slot->sym];
+            if (name->len == len && memcmp(name->text, text, len) == 0) {
+                return slot->sym;
+            }
+        }
+        i = (i + 1) & mask;
+    }
+}
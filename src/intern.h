@@ -0,0 +1,85 @@
+/**
+ * intern.h
+ *
+ * InternPool stores each distinct name once and identifies it with a
+ * 32-bit symbol, so that names compare as integers.
+ *
+ * The pool is an open-addressing hash table with linear probing over the
+ * symbols, and the names are copied to an arena. The hash is the FNV-1a
+ * hash of the bytes, which the lexer computes while it scans a word.
+ *
+ */
+
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "arena.h"
+
+// Symbol identifies an interned name. SYMBOL_NONE is never interned.
+typedef uint32_t Symbol;
+
+#define SYMBOL_NONE 0
+
+// INTERN_HASH_INIT and INTERN_HASH_STEP compute the hash of a name one
+// byte at a time.
+#define INTERN_HASH_INIT 2166136261u
+#define INTERN_HASH_STEP(hash, c) (((hash) ^ (uint8_t)(c)) * 16777619u)
+
+// InternSlot is a slot of the hash table, empty if its symbol is none.
+typedef struct InternSlot {
+    uint32_t hash;
+    Symbol sym;
+} InternSlot;
+
+// InternName is an interned name, followed by a '\0' in the arena.
+typedef struct InternName {
+    const char* text;
+    uint32_t len;
+    uint32_t hash;
+} InternName;
+
+typedef struct InternPool {
+    // The hash table, a power of two of slots at most half full.
+    InternSlot* slots;
+    size_t cap;
+    // The names by symbol, from 1 to `len`.
+    InternName* names;
+    size_t len;
+    size_t names_cap;
+    // The text of the names.
+    Arena arena;
+} InternPool;
+
+// init_intern_pool initializes an empty pool.
+void init_intern_pool(InternPool* pool);
+
+// free_intern_pool releases the memory held by the pool.
+void free_intern_pool(InternPool* pool);
+
+// intern_hash returns the hash of the `len` bytes at `text`.
+static inline uint32_t intern_hash(const char* text, size_t len) {
+    uint32_t hash = INTERN_HASH_INIT;
+    for (size_t i = 0; i < len; i++) {
+        hash = INTERN_HASH_STEP(hash, text[i]);
+    }
+    return hash;
+}
+
+// intern_hashed returns the symbol of the `len` bytes at `text`, whose
+// hash is `hash`, and interns them on their first occurrence.
+// It returns SYMBOL_NONE if the memory can't be allocated.
+Symbol intern_hashed(InternPool* pool, const char* text, size_t len, uint32_t hash);
+
+// intern returns the symbol of the `len` bytes at `text`.
+static inline Symbol intern(InternPool* pool, const char* text, size_t len) {
+    return intern_hashed(pool, text, len, intern_hash(text, len));
+}
+
+// symbol_name returns the name of a symbol of the pool.
+static inline const InternName* symbol_name(const InternPool* pool, Symbol sym) {
+    return &pool->names[sym];
+}
+
+#endif
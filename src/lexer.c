@@ -2,89 +2,120 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
-#include <ctype.h>
 #include <string.h>
 #include <assert.h>
+#include <math.h>
 #include "lexer.h"
+#include "number.h"
+#include "scan.h"
 
 // to_string returns a string representation of the given parser state.
 // This is used for debugging.
 static char* to_string(LexerState* state) {
+    sync_lexer_position(state);
     char* str = malloc(100);
     memset(str, 0, 100);
     sprintf(str, "line %d, col %d", state->line, state->column);
     return str;
 }
 
-// get_chr returns the character at the given offset from the current position.
-// This function does not check for EOF.
+// peek returns the character at `p`, or '\0' at and past the end of the source.
+static inline char peek(LexerState* state, const char* p) {
+    return p < state->end ? *p : '\0';
+}
+
+// get_chr returns the character at the given offset from the current position,
+// or '\0' at and past the end of the source.
 static inline char get_chr(LexerState* state, size_t offset) {
-    return *(state->current + offset);
+    return peek(state, state->current + offset);
+}
+
+// Character classes of the lexer, as bit flags of `CharClass`.
+#define CC_IDENT_START  0x01 // [A-Za-z_]
+#define CC_IDENT        0x02 // [A-Za-z0-9_]
+#define CC_DIGIT        0x04 // [0-9]
+#define CC_HEX          0x08 // [0-9a-fA-F]
+#define CC_BLANK        0x10 // [ \t\r\n]
+#define CC_OP_START     0x20 // [!%&()*+,\-./:;<=>?[\]^{|}~]
+#define CC_CHAR         0x40 // ASCII allowed unescaped in a char literal
+
+#define Z 0
+#define C CC_CHAR
+#define B (CC_BLANK | CC_CHAR)
+#define N CC_BLANK
+#define O (CC_OP_START | CC_CHAR)
+#define D (CC_IDENT | CC_DIGIT | CC_HEX | CC_CHAR)
+#define X (CC_IDENT_START | CC_IDENT | CC_HEX | CC_CHAR)
+#define L (CC_IDENT_START | CC_IDENT | CC_CHAR)
+
+// CharClass maps every byte to its character classes, so that the
+// classifiers are a single load and mask, independent of the locale.
+static const uint8_t CharClass[256] = {
+    /* 0x00 */ Z, C, C, C, C, C, C, C, C, B, N, C, C, B, C, C,
+    /* 0x10 */ C, C, C, C, C, C, C, C, C, C, C, C, C, C, C, C,
+    /* 0x20 */ B, O, C, C, C, O, O, Z, O, O, O, O, O, O, O, O,
+    /* 0x30 */ D, D, D, D, D, D, D, D, D, D, O, O, O, O, O, O,
+    /* 0x40 */ C, X, X, X, X, X, X, L, L, L, L, L, L, L, L, L,
+    /* 0x50 */ L, L, L, L, L, L, L, L, L, L, L, O, Z, O, O, L,
+    /* 0x60 */ C, X, X, X, X, X, X, L, L, L, L, L, L, L, L, L,
+    /* 0x70 */ L, L, L, L, L, L, L, L, L, L, L, O, O, O, O, C,
+    /* 0x80 */ Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z,
+    /* 0x90 */ Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z,
+    /* 0xa0 */ Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z,
+    /* 0xb0 */ Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z,
+    /* 0xc0 */ Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z,
+    /* 0xd0 */ Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z,
+    /* 0xe0 */ Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z,
+    /* 0xf0 */ Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z,
+};
+
+#undef Z
+#undef C
+#undef B
+#undef N
+#undef O
+#undef D
+#undef X
+#undef L
+
+// char_class returns the character classes of the given character.
+static inline uint8_t char_class(char c) {
+    return CharClass[(unsigned char)c];
 }
 
 // skip_line_comment skips a line comment.
 static void skip_line_comment(LexerState* state) {
-    char c;
-    do {
-        c = *state->current++;
-        state->column++;
-    } while (c != '\n' && c != '\0');
-    if (c == '\n') {
-        state->line++;
-        state->column = 1;
-    } else {
-        state->current--;
-    }
+    const char* eol = scanner.find_eol(state->current, state->end);
+    state->current = eol < state->end ? eol + 1 : eol;
 }
 
-// is_skip returns true if the given character is whitespace, tab, newline,
-static bool is_skip(LexerState* state) {
-    char c = get_chr(state, 0);
-    switch (c) {
-        case ' ':
-        case '\t':
-        case '\r':
-        case '\n':
-        case '#':
-            return true;
-        default:
-            return false;
-    }
+// skip_blanks skips a run of whitespace, tabs and newlines
+// with the vector scanners.
+static void skip_blanks(LexerState* state) {
+    state->current = scanner.skip_blanks(state->current, state->end);
 }
 
-// skip skips whitespace, tab, newlines (clrf), line comments.
-static void skip(LexerState* state) {
-    while (true) {
-        char c = get_chr(state, 0);
-        switch (c) {
-            case ' ':
-            case '\t':
-            case '\r':
-                state->current++;
-                state->column++;
-                break;
-            case '\n':
-                state->current++;
-                state->line++;
-                state->column = 1;
-                break;
-            case '#':
-                skip_line_comment(state);
-                break;
-            default:
-                return;
-        }
+// int_literal records the value of an integer literal, or fails if it
+// doesn't fit in 64 bits.
+static TokenKind int_literal(LexerState* state, uint64_t value, bool overflow) {
+    if (overflow) {
+        state->error = LEXER_ERANGE;
+        return TOKEN_ERROR;
     }
+    state->token.value.i = value;
+    return TOKEN_INT_LITERAL;
 }
 
 // next_bin returns the next binary number.
 static TokenKind next_bin_int(LexerState* state) {
     char c = get_chr(state, 0);
+    uint64_t value;
+    bool overflow = false;
 
     // [01]
     if (c == '0' || c == '1') {
+        value = c - '0';
         state->current++;
-        state->column++;
     } else {
         state->error = LEXER_EBINCHR;
         return TOKEN_ERROR;
@@ -95,12 +126,12 @@ static TokenKind next_bin_int(LexerState* state) {
         c = get_chr(state, 0);
         if (c == '_') {
             state->current++;
-            state->column++;
             c = get_chr(state, 0);
         }
         if (c == '0' || c == '1') {
+            overflow |= value >> 63;
+            value = value << 1 | (c - '0');
             state->current++;
-            state->column++;
         } else {
             break;
         }
@@ -113,17 +144,19 @@ static TokenKind next_bin_int(LexerState* state) {
         return TOKEN_ERROR;
     }
 
-    return TOKEN_INT_LITERAL;
+    return int_literal(state, value, overflow);
 }
 
 // next_oct returns the next octal number.
 static TokenKind next_oct_int(LexerState* state) {
     char c = get_chr(state, 0);
+    uint64_t value;
+    bool overflow = false;
 
     // [0-7]
-    if (c >= '0' || c <= '7') {
+    if (c >= '0' && c <= '7') {
+        value = c - '0';
         state->current++;
-        state->column++;
     } else {
         state->error = LEXER_EOCTCHR;
         return TOKEN_ERROR;
@@ -134,12 +167,12 @@ static TokenKind next_oct_int(LexerState* state) {
         c = get_chr(state, 0);
         if (c == '_') {
             state->current++;
-            state->column++;
             c = get_chr(state, 0);
         }
         if (c >= '0' && c <= '7') {
+            overflow |= value >> 61;
+            value = value << 3 | (c - '0');
             state->current++;
-            state->column++;
         } else {
             break;
         }
@@ -152,17 +185,24 @@ static TokenKind next_oct_int(LexerState* state) {
         return TOKEN_ERROR;
     }
 
-    return TOKEN_INT_LITERAL;
+    return int_literal(state, value, overflow);
+}
+
+// hex_value returns the value of a hex digit.
+static inline unsigned hex_value(char c) {
+    return c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10;
 }
 
 // next_hex_int returns the next hex integer.
 static TokenKind next_hex_int(LexerState* state) {
     char c = get_chr(state, 0);
+    uint64_t value;
+    bool overflow = false;
 
     // [0-9a-fA-F]
-    if (c >= '0' || c <= '9' || c >= 'a' || c <= 'f' || c >= 'A' || c <= 'F') {
+    if (char_class(c) & CC_HEX) {
+        value = hex_value(c);
         state->current++;
-        state->column++;
     } else {
         state->error = LEXER_EHEXCHR;
         return TOKEN_ERROR;
@@ -173,12 +213,75 @@ static TokenKind next_hex_int(LexerState* state) {
         c = get_chr(state, 0);
         if (c == '_') {
             state->current++;
-            state->column++;
             c = get_chr(state, 0);
         }
-        if (c >= '0' && c <= '9' || c >= 'a' && c <= 'f' || c >= 'A' && c <= 'F') {
+        if (char_class(c) & CC_HEX) {
+            overflow |= value >> 60;
+            value = value << 4 | hex_value(c);
+            state->current++;
+        } else {
+            break;
+        }
+    }
+
+    return int_literal(state, value, overflow);
+}
+
+// Decimal is a decimal number as it is scanned: the value of its integer
+// part, and its first DECIMAL_DIGITS significant digits with the power of
+// ten they are scaled by.
+typedef struct Decimal {
+    uint64_t value;
+    bool overflow;
+    uint64_t mantissa;
+    int digits;
+    int64_t exp10;
+    // Whether nonzero digits were left out of the mantissa.
+    bool truncated;
+} Decimal;
+
+// push_digit adds a digit of the integer part, or of the fraction if
+// `frac` is set, to the decimal.
+static inline void push_digit(Decimal* dec, unsigned digit, bool frac) {
+    if (!frac) {
+        dec->overflow |= dec->value > (UINT64_MAX - digit) / 10;
+        dec->value = dec->value * 10 + digit;
+    }
+    if (dec->digits < DECIMAL_DIGITS) {
+        if (dec->digits > 0 || digit != 0) {
+            dec->mantissa = dec->mantissa * 10 + digit;
+            dec->digits++;
+        }
+        dec->exp10 -= frac;
+    } else {
+        dec->exp10 += !frac;
+        dec->truncated |= digit != 0;
+    }
+}
+
+// next_dec_int returns the next decimal integer, whose digits are added to
+// the decimal.
+static TokenKind next_dec_int(LexerState* state, Decimal* dec, bool frac) {
+    char c = get_chr(state, 0);
+
+    // [0-9]
+    if (char_class(c) & CC_DIGIT) {
+        push_digit(dec, c - '0', frac);
+        state->current++;
+    } else {
+        return TOKEN_ERROR;
+    }
+
+    // ('_'? [0-9])*
+    while (true) {
+        c = get_chr(state, 0);
+        if (c == '_') {
+            state->current++;
+            c = get_chr(state, 0);
+        }
+        if (char_class(c) & CC_DIGIT) {
+            push_digit(dec, c - '0', frac);
             state->current++;
-            state->column++;
         } else {
             break;
         }
@@ -187,14 +290,18 @@ static TokenKind next_hex_int(LexerState* state) {
     return TOKEN_INT_LITERAL;
 }
 
-// next_dec_int returns the next decimal integer.
-static TokenKind next_dec_int(LexerState* state) {
+// EXP10_LIMIT bounds the exponents of float literals, far past the
+// exponents where doubles overflow or underflow.
+#define EXP10_LIMIT 100000
+
+// next_exp returns the next exponent of a float literal.
+static TokenKind next_exp(LexerState* state, int64_t* exp) {
     char c = get_chr(state, 0);
 
     // [0-9]
-    if (c >= '0' || c <= '9') {
+    if (char_class(c) & CC_DIGIT) {
+        *exp = c - '0';
         state->current++;
-        state->column++;
     } else {
         return TOKEN_ERROR;
     }
@@ -204,12 +311,13 @@ static TokenKind next_dec_int(LexerState* state) {
         c = get_chr(state, 0);
         if (c == '_') {
             state->current++;
-            state->column++;
             c = get_chr(state, 0);
         }
-        if (c >= '0' && c <= '9') {
+        if (char_class(c) & CC_DIGIT) {
+            if (*exp < EXP10_LIMIT) {
+                *exp = *exp * 10 + (c - '0');
+            }
             state->current++;
-            state->column++;
         } else {
             break;
         }
@@ -218,25 +326,47 @@ static TokenKind next_dec_int(LexerState* state) {
     return TOKEN_INT_LITERAL;
 }
 
-// next_dec returns the next decimal number.
+// float_literal records the value of the float literal from `start`, or
+// fails if it overflows a double.
+static TokenKind float_literal(LexerState* state, const Decimal* dec, int64_t exp, const char* start) {
+    int64_t q = dec->exp10 + exp;
+    double value = decimal_to_double(dec->mantissa, q);
+    // The digits left out can only round the value up to that of the next
+    // mantissa. If it is the same, they don't matter.
+    if (dec->truncated && value != decimal_to_double(dec->mantissa + 1, q)) {
+        value = parse_double(start, state->current - start);
+    }
+    if (isinf(value)) {
+        state->error = LEXER_ERANGE;
+        return TOKEN_ERROR;
+    }
+    state->token.value.f = value;
+    return TOKEN_FLOAT_LITERAL;
+}
+
+// next_dec returns the next decimal number. A dot or an exponent must be
+// followed by a digit, so `1.`, `1.e5` and `3e+` are LEXER_EDECCHR.
 static TokenKind next_dec(LexerState* state) {
-    TokenKind token = next_dec_int(state);
+    const char* start = state->current;
+    Decimal dec = {0};
+    TokenKind token = next_dec_int(state, &dec, false);
     if (token != TOKEN_INT_LITERAL) {
         return token;
     }
 
     bool dot = false;
     bool sci_note = false;
+    int64_t exp = 0;
 
     char c = get_chr(state, 0);
 
     if (c == '.') {
         dot = true;
         state->current++;
-        state->column++;
 
-        token = next_dec_int(state);
+        token = next_dec_int(state, &dec, true);
         if (token != TOKEN_INT_LITERAL) {
+            state->error = LEXER_EDECCHR;
             return token;
         }
     }
@@ -246,67 +376,58 @@ static TokenKind next_dec(LexerState* state) {
     if (c == 'e' || c == 'E') {
         sci_note = true;
         state->current++;
-        state->column++;
 
+        bool negative = false;
         c = get_chr(state, 0);
         if (c == '+' || c == '-') {
+            negative = c == '-';
             state->current++;
-            state->column++;
         }
 
-        token = next_dec_int(state);
+        token = next_exp(state, &exp);
         if (token != TOKEN_INT_LITERAL) {
+            state->error = LEXER_EDECCHR;
             return token;
         }
+        if (negative) {
+            exp = -exp;
+        }
     }
 
-    return dot || sci_note ? TOKEN_FLOAT_LITERAL : TOKEN_INT_LITERAL;
+    if (dot || sci_note) {
+        return float_literal(state, &dec, exp, start);
+    }
+    return int_literal(state, dec.value, dec.overflow);
 }
 
-
-
 // next_num returns the next int or float token in the given parser state.
 static TokenKind next_num(LexerState* state) {
     char c0 = get_chr(state, 0);
     char c1 = get_chr(state, 1);
-    TokenKind token;
     if (c0 == '0') {
         switch (c1) {
             case 'b':
             case 'B':
                 state->current += 2;
-                state->column += 2;
-                token = next_bin_int(state);
-                skip(state);
-                return token;
+                return next_bin_int(state);
             case 'o':
             case 'O':
                 state->current += 2;
-                state->column += 2;
-                token = next_oct_int(state);
-                skip(state);
-                return token;
+                return next_oct_int(state);
             case 'x':
             case 'X':
                 state->current += 2;
-                state->column += 2;
-                token = next_hex_int(state);
-                skip(state);
-                return token;
+                return next_hex_int(state);
             default:
-                token = next_dec(state);
-                skip(state);
-                return token;
+                return next_dec(state);
         }
     } else {
-        token = next_dec(state);
-        skip(state);
-        return token;
+        return next_dec(state);
     }
 }
 
 static bool is_hex(char c) {
-    return c >= '0' && c <= '9' || c >= 'a' && c <= 'f' || c >= 'A' && c <= 'F';
+    return char_class(c) & CC_HEX;
 }
 
 typedef uint32_t        ucs4_t;
@@ -316,153 +437,247 @@ typedef uint32_t        ucs4_t;
     (0 == ((ucs4_t)0xfffff800 & (ch)) ? 2 : \
     (0 == ((ucs4_t)0xffff0000 & (ch)) ? 3 : 4)))
 
+// is_ascii_char returns true if the given character can appear unescaped
+// in a char literal on its own, that is ASCII except newline, quote and backslash.
 static bool is_ascii_char(char c) {
-    return (
-        c >= 0x0 && c <= 0x9
-        // ignore c == 0xa (new line \n)
-        || c >= 0xb && c <= 0x38
-        // ignore c == 0x39 (quote ')
-        || c >= 0x3a && c <= 0x46
-        // ignore c == 0x47 (backslash \)
-        || c >= 0x48 && c <= 0x7f
-    );
+    return char_class(c) & CC_CHAR;
 }
 
-size_t _next_utf8_char(char* s, ucs4_t* c) {
+// _next_utf8_char decodes the code point at `s`, of which `avail` bytes are
+// available. It returns the length of the code point, or 0 if it is invalid.
+size_t _next_utf8_char(const char* s, size_t avail, ucs4_t* c) {
     *c = 0;
 
-    if ((s[0] & 128) == 0) { /* 1 byte code point, ASCII, s[0] & 0b10000000 */
-        *c = (s[0] & 127);
-        return 1;
-    } else if ((s[0] & 224) == 192) { /* 2 byte code point, s[0] & 0b11100000 == 0b11000000 */
-        if (s[0] == 0) return 0;
-        *c = (s[0] & 31) << 6 | (s[1] & 63);
-        return 2;
-    } else if ((s[0] & 240) == 224) { /* 3 byte code point */
-        if (s[1] == 0) return 0;
-        *c = (s[0] & 15) << 12 | (s[1] & 63) << 6 | (s[2] & 63);
-        return 3;
-    } else if ((s[0] & 248) == 240) { /* 4 byte code point */
-        if (s[2] == 0) return 0;
-        *c = (s[0] & 7) << 18 | (s[1] & 63) << 12 | (s[2] & 63) << 6 | (s[3] & 63);
-        return 4;
-    } else {
-        *c = 0;
-        return 0;
+    size_t len = utf8_char_len(s, s + avail);
+    switch (len) {
+        case 1: /* ASCII */
+            *c = s[0];
+            break;
+        case 2: /* 110xxxxx 10xxxxxx */
+            *c = (s[0] & 31) << 6 | (s[1] & 63);
+            break;
+        case 3: /* 1110xxxx 10xxxxxx 10xxxxxx */
+            *c = (s[0] & 15) << 12 | (s[1] & 63) << 6 | (s[2] & 63);
+            break;
+        case 4: /* 11110xxx 10xxxxxx 10xxxxxx 10xxxxxx */
+            *c = (s[0] & 7) << 18 | (s[1] & 63) << 12 | (s[2] & 63) << 6 | (s[3] & 63);
+            break;
     }
+    return len;
 }
 
-TokenKind next_utf8_char(LexerState* state) {
-    ucs4_t c;
-    size_t len = _next_utf8_char(state->current, &c);
+TokenKind next_utf8_char(LexerState* state, ucs4_t* c) {
+    size_t len = _next_utf8_char(state->current, state->end - state->current, c);
     if (len == 0) {
         state->error = LEXER_EUTF8CHR;
         return TOKEN_ERROR;
     }
     state->current += len;
-    state->column += len;
     return TOKEN_CHAR_LITERAL;
 }
 
-TokenKind next_escape_char(LexerState* state) {
-    char c = get_chr(state, 0);
-    if (c != '\\') {
-        return TOKEN_ERROR;
-    }
-    state->current++;
-    state->column++;
-    c = get_chr(state, 0);
+// simple_escape returns the byte of the one letter escape `\c`, or 0 if
+// there is none.
+static inline char simple_escape(char c) {
     switch (c) {
-        case 'a':
-        case 'b':
-        case 'f':
-        case 'n':
-        case 'r':
-        case 't':
-        case 'v':
+        case 'a': return '\a';
+        case 'b': return '\b';
+        case 'f': return '\f';
+        case 'n': return '\n';
+        case 'r': return '\r';
+        case 't': return '\t';
+        case 'v': return '\v';
         case '\\':
         case '\'':
         case '"':
-            state->current++;
-            state->column++;
-            break;
+            return c;
+        default:
+            return 0;
+    }
+}
+
+// next_hex_digits reads `n` hex digits into `c`.
+static bool next_hex_digits(LexerState* state, int n, ucs4_t* c) {
+    *c = 0;
+    for (int i = 0; i < n; i++) {
+        char d = get_chr(state, 0);
+        if (!is_hex(d)) {
+            return false;
+        }
+        *c = *c << 4 | hex_value(d);
+        state->current++;
+    }
+    return true;
+}
+
+// is_scalar_value returns whether the code point can be encoded in UTF-8,
+// that is it is neither a surrogate nor past U+10FFFF.
+static inline bool is_scalar_value(ucs4_t c) {
+    return c <= 0x10ffff && (c < 0xd800 || c > 0xdfff);
+}
+
+// next_escape_char reads an escape sequence and decodes it to `c`, a byte
+// for `\xHH` and a code point otherwise.
+TokenKind next_escape_char(LexerState* state, ucs4_t* c) {
+    char e = get_chr(state, 0);
+    if (e != '\\') {
+        return TOKEN_ERROR;
+    }
+    state->current++;
+    e = get_chr(state, 0);
+    state->current++;
+    switch (e) {
         case 'x':
-            state->current++;
-            state->column++;
-            if (!is_hex(get_chr(state, 0))) {
+            if (!next_hex_digits(state, 2, c)) {
                 return TOKEN_ERROR;
             }
-            state->current++;
-            state->column++;
-            if (!is_hex(get_chr(state, 0))) {
-                return TOKEN_ERROR;
-            }
-            state->current++;
-            state->column++;
             break;
         case 'u':
-            state->current++;
-            state->column++;
-            for (int i = 0; i < 4; i++) {
-                if (!is_hex(get_chr(state, 0))) {
-                    state->error = LEXER_EUTF8UNDER4;
-                    return TOKEN_ERROR;
-                }
-                state->current++;
-                state->column++;
+            if (!next_hex_digits(state, 4, c)) {
+                state->error = LEXER_EUTF8UNDER4;
+                return TOKEN_ERROR;
+            }
+            if (!is_scalar_value(*c)) {
+                state->error = LEXER_EESCAPE;
+                return TOKEN_ERROR;
             }
             break;
         case 'U':
-            state->current++;
-            state->column++;
-            for (int i = 0; i < 8; i++) {
-                if (!is_hex(get_chr(state, 0))) {
-                    state->error = LEXER_EUTF8UNDER8;
-                    return TOKEN_ERROR;
-                }
-                state->current++;
-                state->column++;
+            if (!next_hex_digits(state, 8, c)) {
+                state->error = LEXER_EUTF8UNDER8;
+                return TOKEN_ERROR;
+            }
+            if (!is_scalar_value(*c)) {
+                state->error = LEXER_EESCAPE;
+                return TOKEN_ERROR;
             }
             break;
         default:
-            return TOKEN_ERROR;
+            *c = (unsigned char)simple_escape(e);
+            if (*c == 0) {
+                state->current--;
+                return TOKEN_ERROR;
+            }
+            break;
     }
     return TOKEN_CHAR_LITERAL;
 }
 
+// encode_utf8 writes the UTF-8 encoding of a code point to `out` and
+// returns its length.
+static size_t encode_utf8(ucs4_t c, char* out) {
+    if (c < 0x80) {
+        out[0] = c;
+        return 1;
+    } else if (c < 0x800) {
+        out[0] = 0xc0 | c >> 6;
+        out[1] = 0x80 | (c & 63);
+        return 2;
+    } else if (c < 0x10000) {
+        out[0] = 0xe0 | c >> 12;
+        out[1] = 0x80 | (c >> 6 & 63);
+        out[2] = 0x80 | (c & 63);
+        return 3;
+    } else {
+        out[0] = 0xf0 | c >> 18;
+        out[1] = 0x80 | (c >> 12 & 63);
+        out[2] = 0x80 | (c >> 6 & 63);
+        out[3] = 0x80 | (c & 63);
+        return 4;
+    }
+}
+
+// decode_str sets the value of a string literal to its body, from `body`
+// to the closing quote at `end`. Bodies without escapes are used in place.
+// The others are decoded to the arena, which never takes more bytes than
+// the body: the runs between escapes are copied as they are, and each
+// escape is at least as long as its encoding.
+static bool decode_str(LexerState* state, const char* body, const char* end, bool escaped, TokenValue* value) {
+    if (!escaped) {
+        value->str.text = body;
+        value->str.len = end - body;
+        return true;
+    }
+    char* out = arena_alloc(state->strings, end - body, 1);
+    if (out == NULL) {
+        return false;
+    }
+    value->str.text = out;
+    // The escapes were checked by the scan, decode them again from a copy
+    // of the state.
+    LexerState decoder = *state;
+    decoder.current = body;
+    decoder.end = end;
+    const char* p = body;
+    while (p < end) {
+        const char* escape = memchr(p, '\\', end - p);
+        if (escape == NULL) {
+            escape = end;
+        }
+        memcpy(out, p, escape - p);
+        out += escape - p;
+        if (escape == end) {
+            break;
+        }
+        bool byte = escape[1] == 'x';
+        ucs4_t c;
+        decoder.current = escape;
+        next_escape_char(&decoder, &c);
+        if (byte) {
+            *out++ = c;
+        } else {
+            out += encode_utf8(c, out);
+        }
+        p = decoder.current;
+    }
+    value->str.len = out - value->str.text;
+    return true;
+}
+
 TokenKind next_char(LexerState* state) {
     TokenKind token = TOKEN_ERROR;
+    ucs4_t value = 0;
     char c = get_chr(state, 0);
     if (c != '\'') {
         return TOKEN_ERROR;
     }
     state->current++;
-    state->column++;
     c = get_chr(state, 0);
     switch (c) {
         case '\\':
-            token = next_escape_char(state);
+            token = next_escape_char(state, &value);
+            // An unknown escape or a bad `\xHH` leaves no error.
+            if (token == TOKEN_ERROR && state->error == LEXER_EOK) {
+                state->error = LEXER_EESCAPE;
+            }
             break;
         case '\'':
             state->error = LEXER_EEMPTYCHR;
             return TOKEN_ERROR;
         default:
             if (is_ascii_char(c)) {
+                value = c;
                 state->current++;
-                state->column++;
                 token = TOKEN_CHAR_LITERAL;
+            } else if ((unsigned char)c >= 0x80) {
+                token = next_utf8_char(state, &value);
             } else {
-                token = next_utf8_char(state);
+                state->error = LEXER_EASCIICHR;
+                return TOKEN_ERROR;
             }
             break;
     }
+    // Keep the error of a truncated code point or escape.
+    if (token == TOKEN_ERROR && state->error != LEXER_EOK) {
+        return token;
+    }
     c = get_chr(state, 0);
     if (c != '\'') {
         state->error = LEXER_ECHREND;
         return TOKEN_ERROR;
     }
     state->current++;
-    state->column++;
+    state->token.value.i = value;
     return token;
 }
 
@@ -476,448 +691,157 @@ static TokenKind next_str(LexerState* state) {
     }
 
     state->current++;
-    state->column++;
+    const char* body = state->current;
+    bool escaped = false;
 
     // str_char* '"'
+    // Plain characters are skipped by the vector scanner, only escapes,
+    // the closing quote and the invalid characters stop it.
     while (true) {
-        c = get_chr(state, 0);
-        switch (c) {
-            case '\\':
-                token = next_escape_char(state);
+        state->current = scanner.find_str_special(state->current, state->end);
+        switch (get_chr(state, 0)) {
+            case '\\': {
+                ucs4_t c;
+                token = next_escape_char(state, &c);
                 if (token != TOKEN_CHAR_LITERAL) {
+                    // An unknown escape or a bad `\xHH` leaves no error.
+                    if (state->error == LEXER_EOK) {
+                        state->error = LEXER_EESCAPE;
+                    }
                     goto done;
                 }
+                escaped = true;
                 break;
+            }
             case '"':
+                if (!state->utf8_valid) {
+                    // Escapes are ASCII, the whole body is checked at once.
+                    const char* invalid = scanner.validate_utf8(body, state->current);
+                    if (invalid != state->current) {
+                        state->current = invalid;
+                        token = TOKEN_ERROR;
+                        state->error = LEXER_EUTF8CHR;
+                        goto done;
+                    }
+                }
+                if (state->strings != NULL &&
+                    !decode_str(state, body, state->current, escaped, &state->token.value)) {
+                    token = TOKEN_ERROR;
+                    state->error = LEXER_ENOMEM;
+                    goto done;
+                }
                 state->current++;
-                state->column++;
                 state->error = LEXER_EOK;
                 token = TOKEN_STR_LITERAL;
-                skip(state);
                 goto done;
             case '\n':
                 token = TOKEN_ERROR;
                 state->error = LEXER_EMULTILINESTR;
                 goto done;
             default:
-                state->current++;
-                state->column++;
-                break;
+                token = TOKEN_ERROR;
+                state->error = LEXER_ESTREND;
+                goto done;
         }
     }
 done:
     return token;
 }
 
-static bool is_end_of_word(char c) {
-    return !(
-        (c >= 'a' && c <= 'z') ||
-        (c >= 'A' && c <= 'Z') ||
-        (c >= '0' && c <= '9') ||
-        c == '_'
-    );
-}
+// KEYWORD_HASH is a perfect hash of the reserved keywords. It only looks at
+// the first two characters, the last character and the length of a word.
+#define KEYWORD_HASH(c0, c1, cn, len) \
+    (((unsigned)(c0) + (unsigned)(c1) + ((unsigned)(cn) << 1) + (unsigned)(len)) & 63)
 
-// next_keyword returns the next keyword token in the given parser state.
-// TODO: we can move state forward here on an error.
-static TokenKind next_keyword(LexerState* state) {
-#define NOT_KEYWORD return TOKEN_ERROR;
-
-    switch (get_chr(state, 0)) {
-        case 'a':
-            switch (get_chr(state, 1)) {
-                case 'n':
-                    switch (get_chr(state, 2)) {
-                        case 'd':
-                            if (is_end_of_word(get_chr(state, 3))) {
-                                state->current += 3;
-                                state->column += 3;
-                                return TOKEN_AND;
-                            } else NOT_KEYWORD;
-                        default: NOT_KEYWORD;
-                    }
-                default: NOT_KEYWORD;
-            }
-        case 'b':
-            switch (get_chr(state, 1)) {
-                case 'r':
-                    switch (get_chr(state, 2)) {
-                        case 'e':
-                            switch (get_chr(state, 3)) {
-                                case 'a':
-                                    switch (get_chr(state, 4)) {
-                                        case 'k':
-                                            if (is_end_of_word(get_chr(state, 5))) {
-                                                state->current += 5;
-                                                state->column += 5;
-                                                return TOKEN_BREAK;
-                                            } else NOT_KEYWORD;
-                                        default: NOT_KEYWORD;
-                                    }
-                                default: NOT_KEYWORD;
-                            }
-                        default: NOT_KEYWORD;
-                    }
-                default: NOT_KEYWORD;
-            }
-        case 'c':
-            switch (get_chr(state, 1)) {
-                case 'a':
-                    switch (get_chr(state, 2)) {
-                        case 's':
-                            switch (get_chr(state, 3)) {
-                                case 'e':
-                                    if (is_end_of_word(get_chr(state, 4))) {
-                                        state->current += 4;
-                                        state->column += 4;
-                                        return TOKEN_CASE;
-                                    } else NOT_KEYWORD;
-                                default: NOT_KEYWORD;
-                            }
-                        case 't':
-                            switch (get_chr(state, 3)) {
-                                case 'c':
-                                    switch (get_chr(state, 4)) {
-                                        case 'h':
-                                            if (is_end_of_word(get_chr(state, 5))) {
-                                                state->current += 5;
-                                                state->column += 5;
-                                                return TOKEN_CATCH;
-                                            } else NOT_KEYWORD;
-                                        default: NOT_KEYWORD;
-                                    }
-                                default: NOT_KEYWORD;
-                            }
-                        default: NOT_KEYWORD;
-                    }
-                case 'o':
-                    switch (get_chr(state, 2)) {
-                        case 'n':
-                            switch (get_chr(state, 3)) {
-                                case 's':
-                                    switch (get_chr(state, 4)) {
-                                        case 't':
-                                            if (is_end_of_word(get_chr(state, 5))) {
-                                                state->current += 5;
-                                                state->column += 5;
-                                                return TOKEN_CONST;
-                                            } else NOT_KEYWORD;
-                                        default: NOT_KEYWORD;
-                                    }
-                                case 't':
-                                    switch (get_chr(state, 4)) {
-                                        case 'i':
-                                            switch (get_chr(state, 5)) {
-                                                case 'n':
-                                                    switch (get_chr(state, 6)) {
-                                                        case 'u':
-                                                            switch (get_chr(state, 7)) {
-                                                                case 'e':
-                                                                    if (is_end_of_word(get_chr(state, 8))) {
-                                                                        state->current += 8;
-                                                                        state->column += 8;
-                                                                        return TOKEN_CONTINUE;
-                                                                    } else NOT_KEYWORD;
-                                                                default: NOT_KEYWORD;
-                                                            }
-                                                        default: NOT_KEYWORD;
-                                                    }
-                                                default: NOT_KEYWORD;
-                                            }
-                                        default: NOT_KEYWORD;
-                                    }
-                                default: NOT_KEYWORD;
-                            }
-                        default: NOT_KEYWORD;
-                    }
-                default: NOT_KEYWORD;
-            }
-        case 'd':
-            switch (get_chr(state, 1)) {
-                case 'e':
-                    switch (get_chr(state, 2)) {
-                        case 'f':
-                            switch (get_chr(state, 3)) {
-                                case 'e':
-                                    switch (get_chr(state, 4)) {
-                                        case 'r':
-                                            if (is_end_of_word(get_chr(state, 5))) {
-                                                state->current += 5;
-                                                state->column += 5;
-                                                return TOKEN_DEFER;
-                                            } else NOT_KEYWORD;
-                                        default: NOT_KEYWORD;
-                                    }
-                                default:
-                                    if (is_end_of_word(get_chr(state, 3))) {
-                                        state->current += 3;
-                                        state->column += 3;
-                                        return TOKEN_DEF;
-                                    } else NOT_KEYWORD;
-                            }
-                        default: NOT_KEYWORD;
-                    }
-                default: NOT_KEYWORD;
-            }
-        case 'e':
-            switch (get_chr(state, 1)) {
-                case 'l':
-                    switch (get_chr(state, 2)) {
-                        case 's':
-                            switch (get_chr(state, 3)) {
-                                case 'e':
-                                    if (is_end_of_word(get_chr(state, 4))) {
-                                        state->current += 4;
-                                        state->column += 4;
-                                        return TOKEN_ELSE;
-                                    } else NOT_KEYWORD;
-                                default: NOT_KEYWORD;
-                            }
-                        case 'i':
-                            switch (get_chr(state, 3)) {
-                                case 'f':
-                                    if (is_end_of_word(get_chr(state, 4))) {
-                                        state->current += 4;
-                                        state->column += 4;
-                                        return TOKEN_ELIF;
-                                    } else NOT_KEYWORD;
-                                default: NOT_KEYWORD;
-                            }
-                        default: NOT_KEYWORD;
-                    }
-                case 'n':
-                    switch (get_chr(state, 2)) {
-                        case 'u':
-                            switch (get_chr(state, 3)) {
-                                case 'm':
-                                    if (is_end_of_word(get_chr(state, 4))) {
-                                        state->current += 4;
-                                        state->column += 4;
-                                        return TOKEN_ENUM;
-                                    } else NOT_KEYWORD;
-                                default: NOT_KEYWORD;
-                            }
-                        default: NOT_KEYWORD;
-                    }
-                default: NOT_KEYWORD;
-            }
-        case 'f':
-            switch (get_chr(state, 1)) {
-                case 'o':
-                    switch (get_chr(state, 2)) {
-                        case 'r':
-                            if (is_end_of_word(get_chr(state, 3))) {
-                                state->current += 3;
-                                state->column += 3;
-                                return TOKEN_FOR;
-                            } else NOT_KEYWORD;
-                        default: NOT_KEYWORD;
-                    }
-                default: NOT_KEYWORD;
-            }
-        case 'i':
-            switch (get_chr(state, 1)) {
-                case 'f':
-                    if (is_end_of_word(get_chr(state, 2))) {
-                        state->current += 2;
-                        state->column += 2;
-                        return TOKEN_IF;
-                    } else NOT_KEYWORD;
-                case 'm':
-                    switch (get_chr(state, 2)) {
-                        case 'p':
-                            switch (get_chr(state, 3)) {
-                                case 'o':
-                                    switch (get_chr(state, 4)) {
-                                        case 'r':
-                                            switch (get_chr(state, 5)) {
-                                                case 't':
-                                                    if (is_end_of_word(get_chr(state, 6))) {
-                                                        state->current += 6;
-                                                        state->column += 6;
-                                                        return TOKEN_IMPORT;
-                                                    } else NOT_KEYWORD;
-                                                default: NOT_KEYWORD;
-                                            }
-                                        default: NOT_KEYWORD;
-                                    }
-                                default: NOT_KEYWORD;
-                            }
-                        default: NOT_KEYWORD;
-                    }
-                default: NOT_KEYWORD;
-            }
-        case 'o':
-            switch (get_chr(state, 1)) {
-                case 'r':
-                    if (is_end_of_word(get_chr(state, 2))) {
-                        state->current += 2;
-                        state->column += 2;
-                        return TOKEN_OR;
-                    } else NOT_KEYWORD;
-                default: NOT_KEYWORD;
-            }
-        case 'r':
-            switch (get_chr(state, 1)) {
-                case 'e':
-                    switch (get_chr(state, 2)) {
-                        case 't':
-                            switch (get_chr(state, 3)) {
-                                case 'u':
-                                    switch (get_chr(state, 4)) {
-                                        case 'r':
-                                            switch (get_chr(state, 5)) {
-                                                case 'n':
-                                                    if (is_end_of_word(get_chr(state, 6))) {
-                                                        state->current += 6;
-                                                        state->column += 6;
-                                                        return TOKEN_RETURN;
-                                                    } else NOT_KEYWORD;
-                                                default: NOT_KEYWORD;
-                                            }
-                                        default: NOT_KEYWORD;
-                                    }
-                                default: NOT_KEYWORD;
-                            }
-                        default: NOT_KEYWORD;
-                    }
-                default: NOT_KEYWORD;
-            }
-        case 's':
-            switch (get_chr(state, 1)) {
-                case 't':
-                    switch (get_chr(state, 2)) {
-                        case 'r':
-                            switch (get_chr(state, 3)) {
-                                case 'u':
-                                    switch (get_chr(state, 4)) {
-                                        case 'c':
-                                            switch (get_chr(state, 5)) {
-                                                case 't':
-                                                    if (is_end_of_word(get_chr(state, 6))) {
-                                                        state->current += 6;
-                                                        state->column += 6;
-                                                        return TOKEN_STRUCT;
-                                                    } else NOT_KEYWORD;
-                                                default: NOT_KEYWORD;
-                                            }
-                                        default: NOT_KEYWORD;
-                                    }
-                                default: NOT_KEYWORD;
-                            }
-                        default: NOT_KEYWORD;
-                    }
-                case 'w':
-                    switch (get_chr(state, 2)) {
-                        case 'i':
-                            switch (get_chr(state, 3)) {
-                                case 't':
-                                    switch (get_chr(state, 4)) {
-                                        case 'c':
-                                            switch (get_chr(state, 5)) {
-                                                case 'h':
-                                                    if (is_end_of_word(get_chr(state, 6))) {
-                                                        state->current += 6;
-                                                        state->column += 6;
-                                                        return TOKEN_SWITCH;
-                                                    } else NOT_KEYWORD;
-                                                default: NOT_KEYWORD;
-                                            }
-                                        default: NOT_KEYWORD;
-                                    }
-                                default: NOT_KEYWORD;
-                            }
-                        default: NOT_KEYWORD;
-                    }
-                default: NOT_KEYWORD;
-            }
-        case 't':
-            switch (get_chr(state, 1)) {
-                case 'e':
-                    switch (get_chr(state, 2)) {
-                        case 's':
-                            switch (get_chr(state, 3)) {
-                                case 't':
-                                    if (is_end_of_word(get_chr(state, 4))) {
-                                        state->current += 4;
-                                        state->column += 4;
-                                        return TOKEN_TEST;
-                                    } else NOT_KEYWORD;
-                                default: NOT_KEYWORD;
-                            }
-                        default: NOT_KEYWORD;
-                    }
-                case 'r':
-                    switch (get_chr(state, 2)) {
-                        case 'y':
-                            if (is_end_of_word(get_chr(state, 3))) {
-                                state->current += 3;
-                                state->column += 3;
-                                return TOKEN_TRY;
-                            } else NOT_KEYWORD;
-                        default: NOT_KEYWORD;
-                    }
-                default: NOT_KEYWORD;
-            }
-        case 'v':
-            switch (get_chr(state, 1)) {
-                case 'a':
-                    switch (get_chr(state, 2)) {
-                        case 'r':
-                            if (is_end_of_word(get_chr(state, 3))) {
-                                state->current += 3;
-                                state->column += 3;
-                                return TOKEN_VAR;
-                            } else NOT_KEYWORD;
-                        default: NOT_KEYWORD;
-                    }
-                default: NOT_KEYWORD;
-            }
-        case 'w':
-            switch (get_chr(state, 1)) {
-                case 'h':
-                    switch (get_chr(state, 2)) {
-                        case 'i':
-                            switch (get_chr(state, 3)) {
-                                case 'l':
-                                    switch (get_chr(state, 4)) {
-                                        case 'e':
-                                            if (is_end_of_word(get_chr(state, 5))) {
-                                                state->current += 5;
-                                                state->column += 5;
-                                                return TOKEN_WHILE;
-                                            } else NOT_KEYWORD;
-                                        default: NOT_KEYWORD;
-                                    }
-                                default: NOT_KEYWORD;
-                            }
-                        default: NOT_KEYWORD;
-                    }
-                default: NOT_KEYWORD;
-            }
-        default: NOT_KEYWORD;
+#define KEYWORD_MIN_LEN 2
+#define KEYWORD_MAX_LEN 8
+
+#define KEYWORD(word, c0, c1, cn, kind) \
+    [KEYWORD_HASH(c0, c1, cn, sizeof(word) - 1)] = { word, sizeof(word) - 1, kind }
+
+// Keywords is the perfect hash table of the reserved keywords, indexed by
+// KEYWORD_HASH. The indexes are computed by the compiler, the test suite
+// checks that no two keywords collide.
+static const struct {
+    const char word[KEYWORD_MAX_LEN];
+    unsigned char len;
+    TokenKind kind;
+} Keywords[64] = {
+    KEYWORD("and", 'a', 'n', 'd', TOKEN_AND),
+    KEYWORD("break", 'b', 'r', 'k', TOKEN_BREAK),
+    KEYWORD("case", 'c', 'a', 'e', TOKEN_CASE),
+    KEYWORD("catch", 'c', 'a', 'h', TOKEN_CATCH),
+    KEYWORD("const", 'c', 'o', 't', TOKEN_CONST),
+    KEYWORD("continue", 'c', 'o', 'e', TOKEN_CONTINUE),
+    KEYWORD("def", 'd', 'e', 'f', TOKEN_DEF),
+    KEYWORD("defer", 'd', 'e', 'r', TOKEN_DEFER),
+    KEYWORD("elif", 'e', 'l', 'f', TOKEN_ELIF),
+    KEYWORD("else", 'e', 'l', 'e', TOKEN_ELSE),
+    KEYWORD("enum", 'e', 'n', 'm', TOKEN_ENUM),
+    KEYWORD("for", 'f', 'o', 'r', TOKEN_FOR),
+    KEYWORD("if", 'i', 'f', 'f', TOKEN_IF),
+    KEYWORD("import", 'i', 'm', 't', TOKEN_IMPORT),
+    KEYWORD("or", 'o', 'r', 'r', TOKEN_OR),
+    KEYWORD("return", 'r', 'e', 'n', TOKEN_RETURN),
+    KEYWORD("struct", 's', 't', 't', TOKEN_STRUCT),
+    KEYWORD("switch", 's', 'w', 'h', TOKEN_SWITCH),
+    KEYWORD("test", 't', 'e', 't', TOKEN_TEST),
+    KEYWORD("try", 't', 'r', 'y', TOKEN_TRY),
+    KEYWORD("var", 'v', 'a', 'r', TOKEN_VAR),
+    KEYWORD("while", 'w', 'h', 'e', TOKEN_WHILE),
+};
+
+#undef KEYWORD
+
+TokenKind lookup_keyword(const char* word, size_t len) {
+    if (len < KEYWORD_MIN_LEN || len > KEYWORD_MAX_LEN) {
+        return TOKEN_IDENTIFIER;
+    }
+    unsigned h = KEYWORD_HASH(word[0], word[1], word[len - 1], len);
+    if (Keywords[h].len == len && memcmp(Keywords[h].word, word, len) == 0) {
+        return Keywords[h].kind;
     }
+    return TOKEN_IDENTIFIER;
 }
 
-// next_identifier returns the next identifier in the source code.
+// next_identifier returns the next identifier or keyword in the source code.
+// The word is scanned once and then classified by `lookup_keyword()`.
 static TokenKind next_identifier(LexerState* state) {
-    // [A-Za-z_][A-Za-z0-9_]* skip 
-    char c = get_chr(state, 0);
+    // [A-Za-z_][A-Za-z0-9_]* skip
+    const char* start = state->current;
+    const char* p = start;
+    char c = peek(state, p);
 
-    if (isalpha(c) || c == '_') {
-        state->current++;
-        state->column++;
-        while (isalnum(c = get_chr(state, 0)) || c == '_') {
-            state->current++;
-            state->column++;
+    if (char_class(c) & CC_IDENT_START) {
+        p++;
+        if (state->intern == NULL) {
+            while (char_class(peek(state, p)) & CC_IDENT) {
+                p++;
+            }
+            state->current = p;
+            return lookup_keyword(start, p - start);
         }
-        skip(state);
-        return TOKEN_IDENTIFIER;
+        // Hash the word while it is scanned, for the intern pool.
+        uint32_t hash = INTERN_HASH_STEP(INTERN_HASH_INIT, c);
+        while (char_class(c = peek(state, p)) & CC_IDENT) {
+            hash = INTERN_HASH_STEP(hash, c);
+            p++;
+        }
+        size_t len = p - start;
+        state->current = p;
+        TokenKind kind = lookup_keyword(start, len);
+        if (kind == TOKEN_IDENTIFIER) {
+            state->token.sym = intern_hashed(state->intern, start, len, hash);
+            if (state->token.sym == SYMBOL_NONE) {
+                state->error = LEXER_ENOMEM;
+                return TOKEN_ERROR;
+            }
+        }
+        return kind;
     } else {
         state->error = LEXER_EINVALIDIDENT;
         return TOKEN_ERROR;
     }
-
 }
 
 // next_operator returns the next operator in the source code.
@@ -933,12 +857,10 @@ static TokenKind next_operator(LexerState* state) {
             switch (c1) {
                 case '=':
                     state->current += 2;
-                    state->column += 2;
                     token = TOKEN_AMPERSANDEQUAL;
                     goto done;
                 default:
                     state->current++;
-                    state->column++;
                     token = TOKEN_AMPERSAND;
                     goto done;
             }
@@ -946,17 +868,14 @@ static TokenKind next_operator(LexerState* state) {
             switch (c1) {
                 case '*':
                     state->current += 2;
-                    state->column += 2;
                     token = TOKEN_ASTERISK2;
                     goto done;
                 case '=':
                     state->current += 2;
-                    state->column += 2;
                     token = TOKEN_ASTERISKEQUAL;
                     goto done;
                 default:
                     state->current++;
-                    state->column++;
                     token = TOKEN_ASTERISK;
                     goto done;
             }
@@ -964,23 +883,19 @@ static TokenKind next_operator(LexerState* state) {
             switch (c1) {
                 case '=':
                     state->current += 2;
-                    state->column += 2;
                     token = TOKEN_CARETEQUAL;
                     goto done;
                 default:
                     state->current++;
-                    state->column++;
                     token = TOKEN_CARET;
                     goto done;
             }
         case ':':
             state->current++;
-            state->column++;
             token = TOKEN_COLON;
             goto done;
         case ',':
             state->current++;
-            state->column++;
             token = TOKEN_COMMA;
             goto done;
         case '.':
@@ -989,28 +904,23 @@ static TokenKind next_operator(LexerState* state) {
                     switch (c2) {
                         case '.':
                             state->current += 3;
-                            state->column += 3;
                             token = TOKEN_DOT3;
                             goto done;
                         default:
                             state->current += 2;
-                            state->column += 2;
                             token = TOKEN_DOT2;
                             goto done;
                     }
                 case '*':
                     state->current += 2;
-                    state->column += 2;
                     token = TOKEN_DOTASTERISK;
                     goto done;
                 case '?':
                     state->current += 2;
-                    state->column += 2;
                     token = TOKEN_DOTQUESTION;
                     goto done;
                 default:
                     state->current++;
-                    state->column++;
                     token = TOKEN_DOT;
                     goto done;
             }
@@ -1018,17 +928,14 @@ static TokenKind next_operator(LexerState* state) {
             switch (c1) {
                 case '=':
                     state->current += 2;
-                    state->column += 2;
                     token = TOKEN_EQUAL2;
                     goto done;
                 case '>':
                     state->current += 2;
-                    state->column += 2;
                     token = TOKEN_EQUALRARROW;
                     goto done;
                 default:
                     state->current++;
-                    state->column++;
                     token = TOKEN_EQUAL;
                     goto done;
             }
@@ -1036,12 +943,10 @@ static TokenKind next_operator(LexerState* state) {
             switch (c1) {
                 case '=':
                     state->current += 2;
-                    state->column += 2;
                     token = TOKEN_EXCLAMEQUAL;
                     goto done;
                 default:
                     state->current++;
-                    state->column++;
                     token = TOKEN_EXCLAM;
                     goto done;
             }
@@ -1051,56 +956,46 @@ static TokenKind next_operator(LexerState* state) {
                     switch (c2) {
                         case '=':
                             state->current += 3;
-                            state->column += 3;
                             token = TOKEN_LARROW2EQUAL;
                             goto done;
                         default:
                             state->current += 2;
-                            state->column += 2;
                             token = TOKEN_LARROW2;
                             goto done;
                     }
                 case '=':
                     state->current += 2;
-                    state->column += 2;
                     token = TOKEN_LARROWEQUAL;
                     goto done;
                 default:
                     state->current++;
-                    state->column++;
                     token = TOKEN_LARROW;
                     goto done;
             }
         case '{':
             state->current++;
-            state->column++;
             token = TOKEN_LBRACE;
             goto done;
         case '[':
             state->current++;
-            state->column++;
             token = TOKEN_LBRACKET;
             goto done;
         case '(':
             state->current++;
-            state->column++;
             token = TOKEN_LPAREN;
             goto done;
         case '-':
             switch (c1) {
                 case '=':
                     state->current += 2;
-                    state->column += 2;
                     token = TOKEN_MINUSEQUAL;
                     goto done;
                 case '>':
                     state->current += 2;
-                    state->column += 2;
                     token = TOKEN_MINUSRARROW;
                     goto done;
                 default:
                     state->current++;
-                    state->column++;
                     token = TOKEN_MINUS;
                     goto done;
             }
@@ -1108,12 +1003,10 @@ static TokenKind next_operator(LexerState* state) {
             switch (c1) {
                 case '=':
                     state->current += 2;
-                    state->column += 2;
                     token = TOKEN_PERCENTEQUAL;
                     goto done;
                 default:
                     state->current++;
-                    state->column++;
                     token = TOKEN_PERCENT;
                     goto done;
             }
@@ -1121,12 +1014,10 @@ static TokenKind next_operator(LexerState* state) {
             switch (c1) {
                 case '=':
                     state->current += 2;
-                    state->column += 2;
                     token = TOKEN_PIPEEQUAL;
                     goto done;
                 default:
                     state->current++;
-                    state->column++;
                     token = TOKEN_PIPE;
                     goto done;
             }
@@ -1134,23 +1025,19 @@ static TokenKind next_operator(LexerState* state) {
             switch (c1) {
                 case '=':
                     state->current += 2;
-                    state->column += 2;
                     token = TOKEN_PLUSEQUAL;
                     goto done;
                 case '+':
                     state->current += 2;
-                    state->column += 2;
                     token = TOKEN_PLUS2;
                     goto done;
                 default:
                     state->current++;
-                    state->column++;
                     token = TOKEN_PLUS;
                     goto done;
             }
         case '?':
             state->current++;
-            state->column++;
             token = TOKEN_QUESTION;
             goto done;
         case '>':
@@ -1159,113 +1046,522 @@ static TokenKind next_operator(LexerState* state) {
                     switch (c2) {
                         case '=':
                             state->current += 3;
-                            state->column += 3;
                             token = TOKEN_RARROW2EQUAL;
                             goto done;
                         default:
                             state->current += 2;
-                            state->column += 2;
                             token = TOKEN_RARROW2;
                             goto done;
                     }
                 case '=':
                     state->current += 2;
-                    state->column += 2;
                     token = TOKEN_RARROWEQUAL;
                     goto done;
                 default:
                     state->current++;
-                    state->column++;
                     token = TOKEN_RARROW;
                     goto done;
             }
         case '}':
             state->current++;
-            state->column++;
             token = TOKEN_RBRACE;
             goto done;
         case ']':
             state->current++;
-            state->column++;
             token = TOKEN_RBRACKET;
             goto done;
         case ')':
             state->current++;
-            state->column++;
             token = TOKEN_RPAREN;
             goto done;
         case ';':
             state->current++;
-            state->column++;
             token = TOKEN_SEMICOLON;
             goto done;
         case '/':
             switch (c1) {
                 case '=':
                     state->current += 2;
-                    state->column += 2;
                     token = TOKEN_SLASHEQUAL;
                     goto done;
                 default:
                     state->current++;
-                    state->column++;
                     token = TOKEN_SLASH;
                     goto done;
             }
         case '~':
             state->current++;
-            state->column++;
             token = TOKEN_TILDE;
             goto done;
         default: return TOKEN_ERROR;
     }
 done:
-    skip(state);
     return token;
 }
 
 void init_lexer_state(LexerState* state, const char* source) {
+    init_lexer_slice(state, source, strlen(source));
+}
+
+void init_lexer_slice(LexerState* state, const char* source, size_t len) {
     state->source = source;
     state->current = source;
+    state->end = source + len;
     state->line = 1;
     state->column = 1;
     state->error = LEXER_EOK;
+    memset(&state->token, 0, sizeof(state->token));
+    memset(&state->lines, 0, sizeof(state->lines));
+    state->intern = NULL;
+    state->strings = NULL;
+    state->utf8_valid = false;
+}
+
+bool validate_lexer_source(LexerState* state) {
+    const char* invalid = scanner.validate_utf8(state->source, state->end);
+    if (invalid != state->end) {
+        state->current = invalid;
+        state->error = LEXER_EUTF8CHR;
+        return false;
+    }
+    state->utf8_valid = true;
+    return true;
+}
+
+void free_lexer_state(LexerState* state) {
+    free(state->lines.buf);
+    memset(&state->lines, 0, sizeof(state->lines));
+}
+
+// build_line_index indexes the newlines of the whole source code
+// the first time a position is asked for.
+static bool build_line_index(LexerState* state) {
+    LineIndex* lines = &state->lines;
+    if (lines->built) {
+        return true;
+    }
+    lines->len = 0;
+    const char* end = state->end;
+    for (const char* eol = scanner.find_eol(state->source, end); eol < end; eol = scanner.find_eol(eol + 1, end)) {
+        if (lines->len == lines->cap) {
+            size_t cap = lines->cap == 0 ? 256 : lines->cap * 2;
+            size_t* buf = realloc(lines->buf, cap * sizeof(size_t));
+            if (buf == NULL) {
+                return false;
+            }
+            lines->buf = buf;
+            lines->cap = cap;
+        }
+        lines->buf[lines->len++] = eol - state->source;
+    }
+    lines->built = true;
+    return true;
+}
+
+void locate_offset(LexerState* state, size_t offset, int* line, int* column) {
+    if (!build_line_index(state)) {
+        *line = *column = 0;
+        return;
+    }
+    // Count the newlines before the offset.
+    const LineIndex* lines = &state->lines;
+    size_t lo = 0, hi = lines->len;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (lines->buf[mid] < offset) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    size_t line_start = lo == 0 ? 0 : lines->buf[lo - 1] + 1;
+    *line = (int)lo + 1;
+    *column = (int)(offset - line_start) + 1;
+}
+
+void sync_lexer_position(LexerState* state) {
+    locate_offset(state, state->current - state->source, &state->line, &state->column);
+}
+
+void locate_tokens(LexerState* state, Token* tokens, size_t len) {
+    if (!build_line_index(state)) {
+        return;
+    }
+    // The tokens are sorted, so walk them along the newlines.
+    const LineIndex* lines = &state->lines;
+    size_t nl = 0;
+    for (size_t i = 0; i < len; i++) {
+        while (nl < lines->len && lines->buf[nl] < tokens[i].start) {
+            nl++;
+        }
+        size_t line_start = nl == 0 ? 0 : lines->buf[nl - 1] + 1;
+        tokens[i].line = (int)nl + 1;
+        tokens[i].col = (int)(tokens[i].start - line_start) + 1;
+    }
+}
+
+// Actions of the `next_token()` state machine.
+enum {
+    ACT_INVALID,
+    ACT_EOF,
+    ACT_SPACE,
+    ACT_COMMENT,
+    ACT_WORD,
+    ACT_NUM,
+    ACT_OP,
+    ACT_CHAR,
+    ACT_STR,
+};
+
+#define I ACT_INVALID
+#define E ACT_EOF
+#define S ACT_SPACE
+#define H ACT_COMMENT
+#define W ACT_WORD
+#define D ACT_NUM
+#define O ACT_OP
+#define Q ACT_CHAR
+#define U ACT_STR
+
+// CharAction maps every byte to the action taken by `next_token()`
+// when it is the first byte of a token.
+static const uint8_t CharAction[256] = {
+    /* 0x00 */ E, I, I, I, I, I, I, I, I, S, S, I, I, S, I, I,
+    /* 0x10 */ I, I, I, I, I, I, I, I, I, I, I, I, I, I, I, I,
+    /* 0x20 */ S, O, U, H, I, O, O, Q, O, O, O, O, O, O, O, O,
+    /* 0x30 */ D, D, D, D, D, D, D, D, D, D, O, O, O, O, O, O,
+    /* 0x40 */ I, W, W, W, W, W, W, W, W, W, W, W, W, W, W, W,
+    /* 0x50 */ W, W, W, W, W, W, W, W, W, W, W, O, I, O, O, W,
+    /* 0x60 */ I, W, W, W, W, W, W, W, W, W, W, W, W, W, W, W,
+    /* 0x70 */ W, W, W, W, W, W, W, W, W, W, W, O, O, O, O, I,
+    /* 0x80 */ I, I, I, I, I, I, I, I, I, I, I, I, I, I, I, I,
+    /* 0x90 */ I, I, I, I, I, I, I, I, I, I, I, I, I, I, I, I,
+    /* 0xa0 */ I, I, I, I, I, I, I, I, I, I, I, I, I, I, I, I,
+    /* 0xb0 */ I, I, I, I, I, I, I, I, I, I, I, I, I, I, I, I,
+    /* 0xc0 */ I, I, I, I, I, I, I, I, I, I, I, I, I, I, I, I,
+    /* 0xd0 */ I, I, I, I, I, I, I, I, I, I, I, I, I, I, I, I,
+    /* 0xe0 */ I, I, I, I, I, I, I, I, I, I, I, I, I, I, I, I,
+    /* 0xf0 */ I, I, I, I, I, I, I, I, I, I, I, I, I, I, I, I,
+};
+
+#undef I
+#undef E
+#undef S
+#undef H
+#undef W
+#undef D
+#undef O
+#undef Q
+#undef U
+
+// is_literal returns whether the token kind is a literal.
+static inline bool is_literal(TokenKind kind) {
+    return kind >= TOKEN_CHAR_LITERAL && kind <= TOKEN_FLOAT_LITERAL;
+}
+
+// begin_token records the start of a token at the current position.
+static inline void begin_token(LexerState* state) {
+    Token* token = &state->token;
+    token->start = state->current - state->source;
+    token->sym = SYMBOL_NONE;
+    token->value.str.text = NULL;
+    token->value.str.len = 0;
+    token->line = 0;
+    token->col = 0;
 }
 
 // next_token returns the next token in the stream.
+// The span of the token is recorded in `state->token`, the trailing
+// whitespace and comments are skipped on success.
+//
+// It is a single state machine dispatching on the current byte through
+// a jump table. Blanks and comments before and after the token go through
+// the same states; once a token is matched, the next non-blank byte ends
+// the call instead of starting another token.
 TokenKind next_token(LexerState* state) {
-    char c = get_chr(state, 0);
-    TokenKind token = TOKEN_ERROR;
-    switch (c) {
-        case '\0': return TOKEN_EOF;
-        case ' ': case '\t': case '\r': case '\n': case '#': skip(state); return next_token(state);
-        case 'a': case 'b': case 'c': case 'd': case 'e': case 'f': case 'g':
-        case 'h': case 'i': case 'j': case 'k': case 'l': case 'm': case 'n':
-        case 'o': case 'p': case 'q': case 'r': case 's': case 't': case 'u':
-        case 'v': case 'w': case 'x': case 'y': case 'z':
-        case 'A': case 'B': case 'C': case 'D': case 'E': case 'F': case 'G':
-        case 'H': case 'I': case 'J': case 'K': case 'L': case 'M': case 'N':
-        case 'O': case 'P': case 'Q': case 'R': case 'S': case 'T': case 'U':
-        case 'V': case 'W': case 'X': case 'Y': case 'Z':
-        case '_':
-            token = next_keyword(state);
-            if (token == TOKEN_ERROR)
-                token = next_identifier(state);
-            return token;
-        case '0': case '1': case '2': case '3': case '4': case '5': case '6':
-        case '7': case '8': case '9':
-            return next_num(state);
-        case '&': case '*': case '^': case ':': case ',': case '.': case '=':
-        case '!': case '<': case '{': case '[': case '(': case '-': case '%':
-        case '|': case '+': case '?': case '>': case '}': case ']': case ')':
-        case ';': case '/': case '~':
-            return next_operator(state);
-        case '\'':
-            return next_char(state);
-        case '"':
-            return next_str(state);
-        default:
-            state->error = LEXER_EINVALIDCHAR;
+#if defined(__GNUC__)
+    static const void* const actions[] = {
+        [ACT_INVALID] = &&act_invalid,
+        [ACT_EOF] = &&act_eof,
+        [ACT_SPACE] = &&act_space,
+        [ACT_COMMENT] = &&act_comment,
+        [ACT_WORD] = &&act_word,
+        [ACT_NUM] = &&act_num,
+        [ACT_OP] = &&act_op,
+        [ACT_CHAR] = &&act_char,
+        [ACT_STR] = &&act_str,
+    };
+#define DISPATCH() goto *actions[CharAction[(unsigned char)get_chr(state, 0)]]
+#else
+#define DISPATCH() \
+    switch (CharAction[(unsigned char)get_chr(state, 0)]) { \
+        case ACT_INVALID: goto act_invalid; \
+        case ACT_EOF: goto act_eof; \
+        case ACT_SPACE: goto act_space; \
+        case ACT_COMMENT: goto act_comment; \
+        case ACT_WORD: goto act_word; \
+        case ACT_NUM: goto act_num; \
+        case ACT_OP: goto act_op; \
+        case ACT_CHAR: goto act_char; \
+        default: goto act_str; \
+    }
+#endif
+
+// TOKEN_STATE starts a token, or ends the call after a matched token.
+#define TOKEN_STATE() \
+    if (matched) { \
+        return token->kind; \
+    } \
+    begin_token(state)
+
+    Token* token = &state->token;
+    bool matched = false;
+    DISPATCH();
+
+act_space:
+    // Most tokens are separated by a single space or newline.
+    if (!(char_class(get_chr(state, 1)) & CC_BLANK)) {
+        state->current++;
+        DISPATCH();
+    }
+    skip_blanks(state);
+    DISPATCH();
+act_comment:
+    skip_line_comment(state);
+    DISPATCH();
+act_word:
+    TOKEN_STATE();
+    token->kind = next_identifier(state);
+    goto act_matched;
+act_num:
+    TOKEN_STATE();
+    token->kind = next_num(state);
+    goto act_matched;
+act_op:
+    TOKEN_STATE();
+    token->kind = next_operator(state);
+    goto act_matched;
+act_char:
+    TOKEN_STATE();
+    token->kind = next_char(state);
+    goto act_matched;
+act_str:
+    TOKEN_STATE();
+    token->kind = next_str(state);
+    goto act_matched;
+act_eof:
+    // A '\0' inside a slice is an invalid character.
+    if (state->current < state->end) {
+        goto act_invalid;
+    }
+    TOKEN_STATE();
+    token->kind = TOKEN_EOF;
+    token->len = 0;
+    return TOKEN_EOF;
+act_invalid:
+    TOKEN_STATE();
+    state->error = LEXER_EINVALIDCHAR;
+    token->kind = TOKEN_ERROR;
+    token->len = 0;
+    return TOKEN_ERROR;
+act_matched:
+    token->len = state->current - state->source - token->start;
+    if (token->kind == TOKEN_ERROR) {
+        return TOKEN_ERROR;
+    }
+    if (state->intern != NULL && is_literal(token->kind)) {
+        token->sym = intern(state->intern, state->source + token->start, token->len);
+        if (token->sym == SYMBOL_NONE) {
+            state->error = LEXER_ENOMEM;
+            token->kind = TOKEN_ERROR;
             return TOKEN_ERROR;
+        }
+    }
+    matched = true;
+    DISPATCH();
+
+#undef TOKEN_STATE
+#undef DISPATCH
+}
+
+bool intern_tokens(LexerState* state, Token* tokens, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        Token* token = &tokens[i];
+        if (token->sym == SYMBOL_NONE && (token->kind == TOKEN_IDENTIFIER || is_literal(token->kind))) {
+            token->sym = intern(state->intern, state->source + token->start, token->len);
+            if (token->sym == SYMBOL_NONE) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool decode_tokens(LexerState* state, Token* tokens, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        Token* token = &tokens[i];
+        if (token->kind == TOKEN_STR_LITERAL && token->value.str.text == NULL) {
+            const char* body = state->source + token->start + 1;
+            const char* end = state->source + token->start + token->len - 1;
+            bool escaped = memchr(body, '\\', end - body) != NULL;
+            if (!decode_str(state, body, end, escaped, &token->value)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void init_token_buf(TokenBuf* tokens) {
+    tokens->cap = 0;
+    tokens->len = 0;
+    tokens->buf = NULL;
+}
+
+void free_token_buf(TokenBuf* tokens) {
+    free(tokens->buf);
+    init_token_buf(tokens);
+}
+
+bool reserve_token_buf(TokenBuf* tokens, size_t size) {
+    if (tokens->cap >= size) {
+        return true;
+    }
+    size_t cap = tokens->cap == 0 ? 256 : tokens->cap;
+    while (cap < size && cap != 0) {
+        cap <<= 1;
+    }
+    if (cap == 0) { /* overflow */
+        cap = size;
+    }
+    Token* buf = realloc(tokens->buf, cap * sizeof(Token));
+    if (buf == NULL) {
+        return false;
+    }
+    tokens->buf = buf;
+    tokens->cap = cap;
+    return true;
+}
+
+TokenKind lex_all(LexerState* state, TokenBuf* tokens) {
+    return lex_until(state, tokens, SIZE_MAX);
+}
+
+// LEX_RESERVE_MAX caps the tokens `lex_until()` reserves before lexing.
+#define LEX_RESERVE_MAX (1u << 20)
+
+TokenKind lex_until(LexerState* state, TokenBuf* tokens, size_t limit) {
+    // Guess low, one token per 16 bytes and at most LEX_RESERVE_MAX tokens,
+    // so that comment-heavy or large sources don't reserve memory they never
+    // use. The buffer doubles past the guess.
+    size_t size = state->end - state->current;
+    size_t offset = state->current - state->source;
+    if (limit < SIZE_MAX) {
+        size = limit > offset ? limit - offset : 0;
+    }
+    size = size / 16 + 1;
+    if (size > LEX_RESERVE_MAX) {
+        size = LEX_RESERVE_MAX;
+    }
+    if (!reserve_token_buf(tokens, tokens->len + size)) {
+        state->error = LEXER_ENOMEM;
+        return TOKEN_ERROR;
+    }
+    while (true) {
+        TokenKind kind = next_token(state);
+        if (state->token.start >= limit) {
+            return kind;
+        }
+        if (tokens->len == tokens->cap && !reserve_token_buf(tokens, tokens->len + 1)) {
+            state->error = LEXER_ENOMEM;
+            return TOKEN_ERROR;
+        }
+        tokens->buf[tokens->len++] = state->token;
+        if (kind == TOKEN_EOF || kind == TOKEN_ERROR) {
+            return kind;
+        }
+    }
+}
+
+void init_error_buf(ErrorBuf* errors) {
+    errors->cap = 0;
+    errors->len = 0;
+    errors->buf = NULL;
+}
+
+void free_error_buf(ErrorBuf* errors) {
+    free(errors->buf);
+    init_error_buf(errors);
+}
+
+// push_error appends an error to the buffer.
+static bool push_error(ErrorBuf* errors, LexerError error, size_t start, size_t len) {
+    if (errors->len == errors->cap) {
+        size_t cap = errors->cap == 0 ? 16 : errors->cap * 2;
+        ErrorSpan* buf = realloc(errors->buf, cap * sizeof(ErrorSpan));
+        if (buf == NULL) {
+            return false;
+        }
+        errors->buf = buf;
+        errors->cap = cap;
+    }
+    errors->buf[errors->len++] = (ErrorSpan){ error, start, len };
+    return true;
+}
+
+// resync returns where lexing resumes after the failed token in
+// `state->token`, always past its start.
+static const char* resync(LexerState* state) {
+    const char* start = state->source + state->token.start;
+    const char* end = state->end;
+    const char* p = start + 1;
+    char quote = *start;
+    if (quote == '"' || quote == '\'') {
+        // Skip the rest of the literal, up to the closing quote on its line.
+        while (p < end && *p != quote && *p != '\n') {
+            p += *p == '\\' && p + 1 < end && p[1] != '\n' ? 2 : 1;
+        }
+        return p < end && *p == quote ? p + 1 : p;
+    }
+    if (state->error == LEXER_EINVALIDCHAR) {
+        // Skip the run of invalid characters, '\0' included inside a slice.
+        while (p < end && CharAction[(unsigned char)*p] <= ACT_EOF) {
+            p++;
+        }
+        return p;
+    }
+    // Skip the rest of a malformed number, up to the next blank, operator,
+    // quote or comment.
+    if (state->current > p) {
+        p = state->current;
+    }
+    while (p < end && (CharAction[(unsigned char)*p] == ACT_WORD || CharAction[(unsigned char)*p] == ACT_NUM)) {
+        p++;
+    }
+    return p;
+}
+
+TokenKind lex_recover(LexerState* state, TokenBuf* tokens, ErrorBuf* errors) {
+    size_t first = errors->len;
+    LexerError last = LEXER_EOK;
+    while (true) {
+        TokenKind kind = lex_all(state, tokens);
+        if (kind == TOKEN_EOF) {
+            state->error = last;
+            return errors->len == first ? TOKEN_EOF : TOKEN_ERROR;
+        }
+        if (state->error == LEXER_ENOMEM) {
+            return TOKEN_ERROR;
+        }
+        // The failed token is the last one appended.
+        Token* token = &tokens->buf[tokens->len - 1];
+        state->current = resync(state);
+        token->len = state->current - state->source - token->start;
+        if (!push_error(errors, state->error, token->start, token->len)) {
+            state->error = LEXER_ENOMEM;
+            return TOKEN_ERROR;
+        }
+        last = state->error;
+        state->error = LEXER_EOK;
     }
 }
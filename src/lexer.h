@@ -27,6 +27,11 @@
 #ifndef LEXER_H
 #define LEXER_H
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "intern.h"
+
 // Token is an enum of all the tokens that can be returned
 // by `next_token()`.
 typedef enum TokenKind {
@@ -36,6 +41,10 @@ typedef enum TokenKind {
     // from the input. It is returned by `next_token()` when
     // it reaches the end of the file.
     TOKEN_EOF,
+    // This is a special one that indicates the input fed so far
+    // is exhausted before the end of the stream. It is returned
+    // by `next_stream_token()` until more input is fed.
+    TOKEN_NEED_INPUT,
 
     // 'a', '你', '\n'
     TOKEN_CHAR_LITERAL,
@@ -158,40 +167,231 @@ typedef enum LexerError {
     LEXER_ECHREND,
     LEXER_EESCAPE,
     LEXER_EMULTILINESTR,
+    LEXER_ESTREND,
+    LEXER_ENOMEM,
+    LEXER_ERANGE,
+    LEXER_EDECCHR,
 } LexerError;
 
+// TokenStr is the decoded value of a string literal. It is a slice of the
+// source code if the literal has no escapes, and a copy in the arena of
+// the lexer otherwise. It may contain '\0' bytes and isn't terminated.
+typedef struct TokenStr {
+    const char* text;
+    size_t len;
+} TokenStr;
+
+// TokenValue is the value of a literal, decoded by the lexer.
+typedef union TokenValue {
+    // The value of a TOKEN_INT_LITERAL, or the code point of
+    // a TOKEN_CHAR_LITERAL (the byte of a `\xHH` escape).
+    uint64_t i;
+    // The value of a TOKEN_FLOAT_LITERAL.
+    double f;
+    // The value of a TOKEN_STR_LITERAL, if the lexer has a string arena.
+    TokenStr str;
+} TokenValue;
+
+// Token is a token record with its kind and its span in the source code.
+// Consumers can recover the token text from `source + start` and `len`
+// without consulting the lexer state.
+typedef struct Token {
+    // The kind of the token.
+    TokenKind kind;
+    // The interned text of an identifier or a literal, or SYMBOL_NONE
+    // if the lexer has no intern pool.
+    Symbol sym;
+    // The byte offset of the token from the start of the source code.
+    size_t start;
+    // The length of the token in bytes.
+    size_t len;
+    // The line of the token (1-based), 0 until located by `locate_tokens()`.
+    int line;
+    // The column of the token (1-based), 0 until located by `locate_tokens()`.
+    int col;
+    // The value of a literal.
+    TokenValue value;
+} Token;
+
+// TokenBuf is a contiguous, growable array of tokens.
+typedef struct TokenBuf {
+    size_t cap;
+    size_t len;
+    Token* buf;
+} TokenBuf;
+
+// ErrorSpan is an error recovered from by `lex_recover()`, with the span of
+// the source skipped to recover from it.
+typedef struct ErrorSpan {
+    LexerError error;
+    // The byte offset of the failed token from the start of the source code.
+    size_t start;
+    // The length of the skipped span in bytes.
+    size_t len;
+} ErrorSpan;
+
+// ErrorBuf is a contiguous, growable array of errors.
+typedef struct ErrorBuf {
+    size_t cap;
+    size_t len;
+    ErrorSpan* buf;
+} ErrorBuf;
+
+// LineIndex is the sorted byte offsets of the newlines in the source code.
+// The lexer only tracks byte offsets, the index turns them into lines and
+// columns when they are asked for.
+typedef struct LineIndex {
+    size_t cap;
+    size_t len;
+    size_t* buf;
+    // Whether the index covers the whole source code.
+    bool built;
+} LineIndex;
+
 // LexerState is the state of the tokenizer.
 // It contains the state of the source code and
 // the current position in the source code.
-// It can also be used to keep track of the current line
-// and column.
+// The current line and column are computed on demand
+// by `sync_lexer_position()`.
 // The tokenizer state avoids having global variables.
 typedef struct LexerState {
     // The source code.
     const char*  source;
     // The current position in the source code.
     const char*  current;
-    // The current line (1-based).
+    // The end of the source code.
+    const char*  end;
+    // The current line (1-based), as of the last `sync_lexer_position()`.
     int    line;
-    // The current column (1-based).
+    // The current column (1-based), as of the last `sync_lexer_position()`.
     int    column;
     // The error.
     LexerError error;
+    // The last token returned by `next_token()`.
+    Token token;
+    // The newline index, built on the first position lookup.
+    LineIndex lines;
+    // The pool identifiers and literals are interned to, or NULL.
+    // It is set by the caller after the state is initialized.
+    InternPool* intern;
+    // The arena the values of string literals with escapes are decoded to,
+    // or NULL to leave them undecoded. It is set by the caller after the
+    // state is initialized.
+    Arena* strings;
+    // Whether the whole source is known to be valid UTF-8, so that string
+    // literals are not validated again. Set by `validate_lexer_source()`.
+    bool utf8_valid;
 } LexerState;
 
-// init_lexer_state initializes the lexer state.
+// LEXER_PADDING is the padding the lexer may read past the end of a slice.
+// The vector scanners read whole LEXER_PADDING-aligned blocks, so they may
+// touch up to LEXER_PADDING - 1 bytes past the end, but never across an
+// aligned boundary and thus never across a page. Any readable slice
+// qualifies, and the content past the end is never interpreted.
+#define LEXER_PADDING 32
+
+// LEXER_LOOKAHEAD is the furthest the lexer reads past the end of a token
+// or an error, for the longest UTF-8 character. A token only depends on
+// the source up to as many bytes past its end.
+#define LEXER_LOOKAHEAD 4
+
+// init_lexer_state initializes the lexer state for a NUL-terminated source.
 void init_lexer_state(LexerState* state, const char* source);
 
+// init_lexer_slice initializes the lexer state for the `len` bytes at
+// `source`, which don't need to be NUL-terminated. The lexer stops at the
+// end of the slice as if it was followed by a '\0', and a '\0' inside the
+// slice is an invalid character. This lets slices of larger buffers be
+// lexed in place.
+void init_lexer_slice(LexerState* state, const char* source, size_t len);
+
+// validate_lexer_source checks that the whole source is valid UTF-8 in one
+// vectorized pass, after which string literals are not checked one by one.
+// On an invalid sequence it returns false with LEXER_EUTF8CHR and
+// `state->current` at the sequence.
+bool validate_lexer_source(LexerState* state);
+
+// free_lexer_state releases the memory held by the lexer state.
+void free_lexer_state(LexerState* state);
+
+// locate_offset returns the line and the column (1-based) of the given
+// byte offset. The newline index is built on the first call.
+void locate_offset(LexerState* state, size_t offset, int* line, int* column);
+
+// sync_lexer_position updates `state->line` and `state->column` to the
+// current position.
+void sync_lexer_position(LexerState* state);
+
+// locate_tokens fills the lines and the columns of the given tokens,
+// which must be sorted by offset as returned by the lexer.
+void locate_tokens(LexerState* state, Token* tokens, size_t len);
+
 // next_token returns the next token in the stream.
+// The span of the token is kept in `state->token`.
 TokenKind next_token(LexerState* state);
 
+// lookup_keyword returns the keyword token of the given word, or
+// TOKEN_IDENTIFIER if the word is not a reserved keyword.
+TokenKind lookup_keyword(const char* word, size_t len);
+
+// intern_tokens interns the identifiers and the literals of the given
+// tokens that have no symbol yet, such as tokens lexed without a pool.
+// It returns false if the memory can't be allocated.
+bool intern_tokens(LexerState* state, Token* tokens, size_t len);
+
+// decode_tokens decodes the values of the string literals of the given
+// tokens that have none yet, such as tokens lexed without an arena.
+// It returns false if the memory can't be allocated.
+bool decode_tokens(LexerState* state, Token* tokens, size_t len);
+
+// init_token_buf initializes an empty token buffer.
+void init_token_buf(TokenBuf* tokens);
+
+// free_token_buf releases the memory held by the token buffer.
+void free_token_buf(TokenBuf* tokens);
+
+// reserve_token_buf makes room for at least `size` tokens.
+// It returns false if the memory can't be allocated.
+bool reserve_token_buf(TokenBuf* tokens, size_t size);
+
+// lex_all tokenizes the rest of the source code in a single pass and
+// appends the tokens to `tokens`, ending with the TOKEN_EOF token.
+// On failure, the failed token is appended as TOKEN_ERROR and the error
+// is kept in `state->error`.
+// It returns TOKEN_EOF on success and TOKEN_ERROR on failure.
+TokenKind lex_all(LexerState* state, TokenBuf* tokens);
+
+// lex_until is `lex_all()` stopping at the first token that starts at the
+// byte offset `limit` or later. That token is left in `state->token` but
+// not appended. It returns the kind of the last token lexed.
+TokenKind lex_until(LexerState* state, TokenBuf* tokens, size_t limit);
+
+// init_error_buf initializes an empty error buffer.
+void init_error_buf(ErrorBuf* errors);
+
+// free_error_buf releases the memory held by the error buffer.
+void free_error_buf(ErrorBuf* errors);
+
+// lex_recover is `lex_all()` recovering from errors instead of stopping at
+// the first one. Each error is appended to `errors`, and to `tokens` as
+// a TOKEN_ERROR spanning the skipped source, then lexing resumes at the
+// next plausible token boundary: after the closing quote of a literal on
+// the same line, or else at its end of line; after a run of invalid
+// characters; or at the next blank, operator or quote after a malformed
+// number. The tokens always end with the TOKEN_EOF token.
+// It returns TOKEN_EOF if the source has no errors. Otherwise it returns
+// TOKEN_ERROR with the last error kept in `state->error`, or LEXER_ENOMEM
+// if the memory for the tokens can't be allocated, which stops it.
+TokenKind lex_recover(LexerState* state, TokenBuf* tokens, ErrorBuf* errors);
+
 // get_tok_name returns the name of the given token.
-static const char* get_tok_name(TokenKind token) {
+static inline const char* get_tok_name(TokenKind token) {
     // TokenName is a string representation of each token
     // kind. It is used for debugging.
     static const char* TokenName[] = {
     "TOKEN_ERROR",
     "TOKEN_EOF",
+    "TOKEN_NEED_INPUT",
 
     "TOKEN_CHAR_LITERAL",
     "TOKEN_STR_LITERAL",
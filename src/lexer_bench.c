@@ -0,0 +1,1362 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <errno.h>
+#include <sched.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "batch.h"
+#include "cache.h"
+#include "intern.h"
+#include "lexer.h"
+#include "relex.h"
+#include "scan.h"
+
+#define BENCH_ROUNDS 5
+
+// BENCH_FULL_LIMIT is the largest corpus the whole suite runs on. The
+// token buffers of larger corpora don't fit in memory, so only the core
+// benchmarks, which don't keep the tokens, run on them.
+#define BENCH_FULL_LIMIT ((size_t)256 << 20)
+
+// BENCH_MAX_CORE_RESULTS bounds the core results recorded in a run.
+#define BENCH_MAX_CORE_RESULTS 64
+
+// The number of rounds each benchmark keeps the best of.
+static int bench_rounds = BENCH_ROUNDS;
+
+static const char* level_names[] = {
+    [SCAN_SCALAR] = "scalar",
+    [SCAN_SSE2] = "sse2",
+    [SCAN_AVX2] = "avx2",
+};
+
+// now returns a monotonic timestamp in seconds.
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// gen_str_heavy generates about `size` bytes of constant declarations
+// bound to long string literals with occasional escapes.
+static char* gen_str_heavy(size_t size) {
+    static const char* words[] = {
+        "SELECT", "name,", "value", "FROM", "settings", "WHERE", "id", "=", "?",
+        "AND", "<div class='row'>", "{{ item.title }}", "</div>", "\\n", "\\t",
+        "\\\"quoted\\\"", "\\u00e9", "héllo", "wörld", "你好世界", "日本語のテキスト", "Ελληνικά",
+        "😀🚀",
+    };
+    char* text = malloc(size + 1024);
+    size_t len = 0;
+    unsigned seed = 1;
+    while (len < size) {
+        len += sprintf(text + len, "const s%zu = \"", len);
+        for (int i = 0; i < 24; i++) {
+            seed = seed * 1103515245 + 12345;
+            len += sprintf(text + len, "%s ", words[(seed >> 16) % (sizeof(words) / sizeof(words[0]))]);
+        }
+        len += sprintf(text + len, "\"\n");
+    }
+    text[len] = '\0';
+    return text;
+}
+
+static inline char get_chr(LexerState* state, size_t offset) {
+    return *(state->current + offset);
+}
+
+static bool is_end_of_word(char c) {
+    return !(
+        (c >= 'a' && c <= 'z') ||
+        (c >= 'A' && c <= 'Z') ||
+        (c >= '0' && c <= '9') ||
+        c == '_'
+    );
+}
+
+// trie_keyword is the nested switch trie that recognized keywords before
+// the perfect hash. It is kept here as the baseline of the keyword benchmark.
+static TokenKind trie_keyword(LexerState* state) {
+#define NOT_KEYWORD return TOKEN_ERROR;
+
+    switch (get_chr(state, 0)) {
+        case 'a':
+            switch (get_chr(state, 1)) {
+                case 'n':
+                    switch (get_chr(state, 2)) {
+                        case 'd':
+                            if (is_end_of_word(get_chr(state, 3))) {
+                                state->current += 3;
+                                state->column += 3;
+                                return TOKEN_AND;
+                            } else NOT_KEYWORD;
+                        default: NOT_KEYWORD;
+                    }
+                default: NOT_KEYWORD;
+            }
+        case 'b':
+            switch (get_chr(state, 1)) {
+                case 'r':
+                    switch (get_chr(state, 2)) {
+                        case 'e':
+                            switch (get_chr(state, 3)) {
+                                case 'a':
+                                    switch (get_chr(state, 4)) {
+                                        case 'k':
+                                            if (is_end_of_word(get_chr(state, 5))) {
+                                                state->current += 5;
+                                                state->column += 5;
+                                                return TOKEN_BREAK;
+                                            } else NOT_KEYWORD;
+                                        default: NOT_KEYWORD;
+                                    }
+                                default: NOT_KEYWORD;
+                            }
+                        default: NOT_KEYWORD;
+                    }
+                default: NOT_KEYWORD;
+            }
+        case 'c':
+            switch (get_chr(state, 1)) {
+                case 'a':
+                    switch (get_chr(state, 2)) {
+                        case 's':
+                            switch (get_chr(state, 3)) {
+                                case 'e':
+                                    if (is_end_of_word(get_chr(state, 4))) {
+                                        state->current += 4;
+                                        state->column += 4;
+                                        return TOKEN_CASE;
+                                    } else NOT_KEYWORD;
+                                default: NOT_KEYWORD;
+                            }
+                        case 't':
+                            switch (get_chr(state, 3)) {
+                                case 'c':
+                                    switch (get_chr(state, 4)) {
+                                        case 'h':
+                                            if (is_end_of_word(get_chr(state, 5))) {
+                                                state->current += 5;
+                                                state->column += 5;
+                                                return TOKEN_CATCH;
+                                            } else NOT_KEYWORD;
+                                        default: NOT_KEYWORD;
+                                    }
+                                default: NOT_KEYWORD;
+                            }
+                        default: NOT_KEYWORD;
+                    }
+                case 'o':
+                    switch (get_chr(state, 2)) {
+                        case 'n':
+                            switch (get_chr(state, 3)) {
+                                case 's':
+                                    switch (get_chr(state, 4)) {
+                                        case 't':
+                                            if (is_end_of_word(get_chr(state, 5))) {
+                                                state->current += 5;
+                                                state->column += 5;
+                                                return TOKEN_CONST;
+                                            } else NOT_KEYWORD;
+                                        default: NOT_KEYWORD;
+                                    }
+                                case 't':
+                                    switch (get_chr(state, 4)) {
+                                        case 'i':
+                                            switch (get_chr(state, 5)) {
+                                                case 'n':
+                                                    switch (get_chr(state, 6)) {
+                                                        case 'u':
+                                                            switch (get_chr(state, 7)) {
+                                                                case 'e':
+                                                                    if (is_end_of_word(get_chr(state, 8))) {
+                                                                        state->current += 8;
+                                                                        state->column += 8;
+                                                                        return TOKEN_CONTINUE;
+                                                                    } else NOT_KEYWORD;
+                                                                default: NOT_KEYWORD;
+                                                            }
+                                                        default: NOT_KEYWORD;
+                                                    }
+                                                default: NOT_KEYWORD;
+                                            }
+                                        default: NOT_KEYWORD;
+                                    }
+                                default: NOT_KEYWORD;
+                            }
+                        default: NOT_KEYWORD;
+                    }
+                default: NOT_KEYWORD;
+            }
+        case 'd':
+            switch (get_chr(state, 1)) {
+                case 'e':
+                    switch (get_chr(state, 2)) {
+                        case 'f':
+                            switch (get_chr(state, 3)) {
+                                case 'e':
+                                    switch (get_chr(state, 4)) {
+                                        case 'r':
+                                            if (is_end_of_word(get_chr(state, 5))) {
+                                                state->current += 5;
+                                                state->column += 5;
+                                                return TOKEN_DEFER;
+                                            } else NOT_KEYWORD;
+                                        default: NOT_KEYWORD;
+                                    }
+                                default:
+                                    if (is_end_of_word(get_chr(state, 3))) {
+                                        state->current += 3;
+                                        state->column += 3;
+                                        return TOKEN_DEF;
+                                    } else NOT_KEYWORD;
+                            }
+                        default: NOT_KEYWORD;
+                    }
+                default: NOT_KEYWORD;
+            }
+        case 'e':
+            switch (get_chr(state, 1)) {
+                case 'l':
+                    switch (get_chr(state, 2)) {
+                        case 's':
+                            switch (get_chr(state, 3)) {
+                                case 'e':
+                                    if (is_end_of_word(get_chr(state, 4))) {
+                                        state->current += 4;
+                                        state->column += 4;
+                                        return TOKEN_ELSE;
+                                    } else NOT_KEYWORD;
+                                default: NOT_KEYWORD;
+                            }
+                        case 'i':
+                            switch (get_chr(state, 3)) {
+                                case 'f':
+                                    if (is_end_of_word(get_chr(state, 4))) {
+                                        state->current += 4;
+                                        state->column += 4;
+                                        return TOKEN_ELIF;
+                                    } else NOT_KEYWORD;
+                                default: NOT_KEYWORD;
+                            }
+                        default: NOT_KEYWORD;
+                    }
+                case 'n':
+                    switch (get_chr(state, 2)) {
+                        case 'u':
+                            switch (get_chr(state, 3)) {
+                                case 'm':
+                                    if (is_end_of_word(get_chr(state, 4))) {
+                                        state->current += 4;
+                                        state->column += 4;
+                                        return TOKEN_ENUM;
+                                    } else NOT_KEYWORD;
+                                default: NOT_KEYWORD;
+                            }
+                        default: NOT_KEYWORD;
+                    }
+                default: NOT_KEYWORD;
+            }
+        case 'f':
+            switch (get_chr(state, 1)) {
+                case 'o':
+                    switch (get_chr(state, 2)) {
+                        case 'r':
+                            if (is_end_of_word(get_chr(state, 3))) {
+                                state->current += 3;
+                                state->column += 3;
+                                return TOKEN_FOR;
+                            } else NOT_KEYWORD;
+                        default: NOT_KEYWORD;
+                    }
+                default: NOT_KEYWORD;
+            }
+        case 'i':
+            switch (get_chr(state, 1)) {
+                case 'f':
+                    if (is_end_of_word(get_chr(state, 2))) {
+                        state->current += 2;
+                        state->column += 2;
+                        return TOKEN_IF;
+                    } else NOT_KEYWORD;
+                case 'm':
+                    switch (get_chr(state, 2)) {
+                        case 'p':
+                            switch (get_chr(state, 3)) {
+                                case 'o':
+                                    switch (get_chr(state, 4)) {
+                                        case 'r':
+                                            switch (get_chr(state, 5)) {
+                                                case 't':
+                                                    if (is_end_of_word(get_chr(state, 6))) {
+                                                        state->current += 6;
+                                                        state->column += 6;
+                                                        return TOKEN_IMPORT;
+                                                    } else NOT_KEYWORD;
+                                                default: NOT_KEYWORD;
+                                            }
+                                        default: NOT_KEYWORD;
+                                    }
+                                default: NOT_KEYWORD;
+                            }
+                        default: NOT_KEYWORD;
+                    }
+                default: NOT_KEYWORD;
+            }
+        case 'o':
+            switch (get_chr(state, 1)) {
+                case 'r':
+                    if (is_end_of_word(get_chr(state, 2))) {
+                        state->current += 2;
+                        state->column += 2;
+                        return TOKEN_OR;
+                    } else NOT_KEYWORD;
+                default: NOT_KEYWORD;
+            }
+        case 'r':
+            switch (get_chr(state, 1)) {
+                case 'e':
+                    switch (get_chr(state, 2)) {
+                        case 't':
+                            switch (get_chr(state, 3)) {
+                                case 'u':
+                                    switch (get_chr(state, 4)) {
+                                        case 'r':
+                                            switch (get_chr(state, 5)) {
+                                                case 'n':
+                                                    if (is_end_of_word(get_chr(state, 6))) {
+                                                        state->current += 6;
+                                                        state->column += 6;
+                                                        return TOKEN_RETURN;
+                                                    } else NOT_KEYWORD;
+                                                default: NOT_KEYWORD;
+                                            }
+                                        default: NOT_KEYWORD;
+                                    }
+                                default: NOT_KEYWORD;
+                            }
+                        default: NOT_KEYWORD;
+                    }
+                default: NOT_KEYWORD;
+            }
+        case 's':
+            switch (get_chr(state, 1)) {
+                case 't':
+                    switch (get_chr(state, 2)) {
+                        case 'r':
+                            switch (get_chr(state, 3)) {
+                                case 'u':
+                                    switch (get_chr(state, 4)) {
+                                        case 'c':
+                                            switch (get_chr(state, 5)) {
+                                                case 't':
+                                                    if (is_end_of_word(get_chr(state, 6))) {
+                                                        state->current += 6;
+                                                        state->column += 6;
+                                                        return TOKEN_STRUCT;
+                                                    } else NOT_KEYWORD;
+                                                default: NOT_KEYWORD;
+                                            }
+                                        default: NOT_KEYWORD;
+                                    }
+                                default: NOT_KEYWORD;
+                            }
+                        default: NOT_KEYWORD;
+                    }
+                case 'w':
+                    switch (get_chr(state, 2)) {
+                        case 'i':
+                            switch (get_chr(state, 3)) {
+                                case 't':
+                                    switch (get_chr(state, 4)) {
+                                        case 'c':
+                                            switch (get_chr(state, 5)) {
+                                                case 'h':
+                                                    if (is_end_of_word(get_chr(state, 6))) {
+                                                        state->current += 6;
+                                                        state->column += 6;
+                                                        return TOKEN_SWITCH;
+                                                    } else NOT_KEYWORD;
+                                                default: NOT_KEYWORD;
+                                            }
+                                        default: NOT_KEYWORD;
+                                    }
+                                default: NOT_KEYWORD;
+                            }
+                        default: NOT_KEYWORD;
+                    }
+                default: NOT_KEYWORD;
+            }
+        case 't':
+            switch (get_chr(state, 1)) {
+                case 'e':
+                    switch (get_chr(state, 2)) {
+                        case 's':
+                            switch (get_chr(state, 3)) {
+                                case 't':
+                                    if (is_end_of_word(get_chr(state, 4))) {
+                                        state->current += 4;
+                                        state->column += 4;
+                                        return TOKEN_TEST;
+                                    } else NOT_KEYWORD;
+                                default: NOT_KEYWORD;
+                            }
+                        default: NOT_KEYWORD;
+                    }
+                case 'r':
+                    switch (get_chr(state, 2)) {
+                        case 'y':
+                            if (is_end_of_word(get_chr(state, 3))) {
+                                state->current += 3;
+                                state->column += 3;
+                                return TOKEN_TRY;
+                            } else NOT_KEYWORD;
+                        default: NOT_KEYWORD;
+                    }
+                default: NOT_KEYWORD;
+            }
+        case 'v':
+            switch (get_chr(state, 1)) {
+                case 'a':
+                    switch (get_chr(state, 2)) {
+                        case 'r':
+                            if (is_end_of_word(get_chr(state, 3))) {
+                                state->current += 3;
+                                state->column += 3;
+                                return TOKEN_VAR;
+                            } else NOT_KEYWORD;
+                        default: NOT_KEYWORD;
+                    }
+                default: NOT_KEYWORD;
+            }
+        case 'w':
+            switch (get_chr(state, 1)) {
+                case 'h':
+                    switch (get_chr(state, 2)) {
+                        case 'i':
+                            switch (get_chr(state, 3)) {
+                                case 'l':
+                                    switch (get_chr(state, 4)) {
+                                        case 'e':
+                                            if (is_end_of_word(get_chr(state, 5))) {
+                                                state->current += 5;
+                                                state->column += 5;
+                                                return TOKEN_WHILE;
+                                            } else NOT_KEYWORD;
+                                        default: NOT_KEYWORD;
+                                    }
+                                default: NOT_KEYWORD;
+                            }
+                        default: NOT_KEYWORD;
+                    }
+                default: NOT_KEYWORD;
+            }
+        default: NOT_KEYWORD;
+    }
+}
+
+// scan_word returns the end of the identifier starting at `p`.
+static inline const char* scan_word(const char* p) {
+    while (isalnum(*p) || *p == '_') {
+        p++;
+    }
+    return p;
+}
+
+// gen_num_heavy generates about `size` bytes of tables of integer, hex
+// and float literals.
+static char* gen_num_heavy(size_t size) {
+    char* text = malloc(size + 256);
+    size_t len = 0;
+    unsigned seed = 1;
+    while (len < size) {
+        len += sprintf(text + len, "const t%zu = [", len);
+        for (int i = 0; i < 8; i++) {
+            seed = seed * 1103515245 + 12345;
+            unsigned r = seed >> 8;
+            switch (r % 4) {
+                case 0:
+                    len += sprintf(text + len, "%u, ", r % 100000);
+                    break;
+                case 1:
+                    len += sprintf(text + len, "0x%08x, ", seed);
+                    break;
+                case 2:
+                    len += sprintf(text + len, "%u.%03u, ", r % 1000, seed % 1000);
+                    break;
+                default:
+                    len += sprintf(text + len, "%u.%07ue%d, ", r % 10, seed % 10000000, (int)(r % 64) - 32);
+                    break;
+            }
+        }
+        len += sprintf(text + len, "]\n");
+    }
+    text[len] = '\0';
+    return text;
+}
+
+// gen_ident_heavy generates about `size` bytes of space separated
+// identifiers and keywords, the way they appear in declarations.
+static char* gen_ident_heavy(size_t size) {
+    static const char* words[] = {
+        "const", "def", "return", "if", "else", "for", "var", "struct", "while",
+        "x", "i", "foo", "bar", "config_value", "item_count", "returned", "iff",
+        "defer_list", "constant", "_tmp", "Handler", "buffer_size", "elif_count",
+    };
+    char* text = malloc(size + 64);
+    size_t len = 0;
+    unsigned seed = 1;
+    while (len < size) {
+        seed = seed * 1103515245 + 12345;
+        len += sprintf(text + len, "%s%c", words[(seed >> 16) % (sizeof(words) / sizeof(words[0]))],
+                       (seed >> 8) % 8 == 0 ? '\n' : ' ');
+    }
+    text[len] = '\0';
+    return text;
+}
+
+// gen_mixed generates about `size` bytes of code mixing declarations,
+// control flow, calls, operators, literals and comments.
+static char* gen_mixed(size_t size) {
+    static const char* lines[] = {
+        "def area(w int, h int) int {\n",
+        "    var total = w * h + (w << 2) - 0x1F\n",
+        "    if total >= 42 and not_done { return total } # early exit\n",
+        "    for i in range(0, 10) { items[i] += foo.bar(i, 'c', \"str\") }\n",
+        "    while x != y { x = x ** 2 / 3.14e-2 }\n",
+        "}\n",
+        "\n",
+        "# a comment line describing the next declaration\n",
+        "const limit = 1_000_000\n",
+        "struct Point { x float, y float }\n",
+    };
+    char* text = malloc(size + 256);
+    size_t len = 0;
+    unsigned seed = 1;
+    while (len < size) {
+        seed = seed * 1103515245 + 12345;
+        len += sprintf(text + len, "%s", lines[(seed >> 16) % (sizeof(lines) / sizeof(lines[0]))]);
+    }
+    text[len] = '\0';
+    return text;
+}
+
+// gen_comment_heavy generates about `size` bytes of documented code, where
+// most lines are comments, some of them trailing a statement.
+static char* gen_comment_heavy(size_t size) {
+    static const char* lines[] = {
+        "# Returns the number of items in the list, or -1 if the list is empty.\n",
+        "# The caller owns the returned buffer and must release it.\n",
+        "#\n",
+        "##################################################################\n",
+        "    # An indented comment in a block, with 'quotes' and \"strings\".\n",
+        "# Non-ASCII comments are skipped too: ça dépend, 注释, Kommentar.\n",
+        "x = y # a trailing comment after a statement\n",
+        "def f() {} # an empty body\n",
+        "\n",
+    };
+    char* text = malloc(size + 256);
+    size_t len = 0;
+    unsigned seed = 1;
+    while (len < size) {
+        seed = seed * 1103515245 + 12345;
+        len += sprintf(text + len, "%s", lines[(seed >> 16) % (sizeof(lines) / sizeof(lines[0]))]);
+    }
+    text[len] = '\0';
+    return text;
+}
+
+// gen_op_dense generates about `size` bytes of expressions packed with
+// operators, mostly without blanks between the tokens.
+static char* gen_op_dense(size_t size) {
+    static const char* ops[] = {
+        "+", "-", "*", "/", "%", "**", "<<", ">>", "&", "|", "^", "==", "!=", "<=", ">=", "<",
+        ">", "=", "+=", "-=", "*=", "/=", "%=", "&=", "|=", "^=", "<<=", ">>=", "=>", "->", ".",
+        "..", "...", ".*", ".?", ",", ":", ";", "++", "!", "~", "?",
+    };
+    char* text = malloc(size + 256);
+    size_t len = 0;
+    unsigned seed = 1;
+    while (len < size) {
+        for (int i = 0; i < 16; i++) {
+            seed = seed * 1103515245 + 12345;
+            unsigned r = seed >> 8;
+            if (r % 8 == 0) {
+                text[len++] = "([{"[r % 3];
+            }
+            text[len++] = 'a' + r % 26;
+            if (r % 8 == 1) {
+                text[len++] = ")]}"[r % 3];
+            }
+            len += sprintf(text + len, "%s", ops[(seed >> 16) % (sizeof(ops) / sizeof(ops[0]))]);
+            if (r % 16 == 2) {
+                text[len++] = ' ';
+            }
+        }
+        text[len++] = 'z';
+        text[len++] = '\n';
+    }
+    text[len] = '\0';
+    return text;
+}
+
+// parse_size parses a size in bytes with an optional K, M or G suffix.
+static size_t parse_size(const char* arg) {
+    char* end;
+    size_t size = strtoull(arg, &end, 10);
+    switch (*end) {
+        case 'K': case 'k': return size << 10;
+        case 'M': case 'm': return size << 20;
+        case 'G': case 'g': return size << 30;
+        default: return size;
+    }
+}
+
+// The CPU the core benchmarks are pinned to, or -1, and the CPUs the
+// process could run on before.
+static int bench_cpu = -1;
+static cpu_set_t bench_cpus;
+
+// pin_cpu pins the calling thread to `bench_cpu`, if any.
+static void pin_cpu(void) {
+    if (bench_cpu < 0) {
+        return;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(bench_cpu, &set);
+    if (sched_getaffinity(0, sizeof(bench_cpus), &bench_cpus) != 0 ||
+        sched_setaffinity(0, sizeof(set), &set) != 0) {
+        fprintf(stderr, "can't pin to CPU %d: %s\n", bench_cpu, strerror(errno));
+        exit(1);
+    }
+}
+
+// unpin_cpu lets the calling thread, and the threads it starts, run on
+// the CPUs it ran on before `pin_cpu()`.
+static void unpin_cpu(void) {
+    if (bench_cpu >= 0) {
+        sched_setaffinity(0, sizeof(bench_cpus), &bench_cpus);
+    }
+}
+
+// The perf event counting the core cycles of the calling thread, or -1.
+static int cycles_fd = -1;
+
+// init_cycles opens the cycle counter of the core benchmarks: the core
+// cycles from perf events if they are available, or else the time stamp
+// counter, which ticks at a constant rate whatever the clock of the core.
+// It returns the name of the counter, or NULL if there is none.
+static const char* init_cycles(void) {
+#ifdef __linux__
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_CPU_CYCLES;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    cycles_fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    if (cycles_fd >= 0) {
+        return "core cycles";
+    }
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+    return "tsc cycles";
+#else
+    return NULL;
+#endif
+}
+
+// read_cycles returns the count of the cycle counter, or 0 if there is none.
+static uint64_t read_cycles(void) {
+    uint64_t count;
+    if (cycles_fd >= 0 && read(cycles_fd, &count, sizeof(count)) == sizeof(count)) {
+        return count;
+    }
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+// CoreResult is the outcome of a core benchmark, as recorded in and
+// compared with a baseline file.
+typedef struct CoreResult {
+    char corpus[32];
+    char level[16];
+    double mbps;
+    double cycles_per_byte;
+} CoreResult;
+
+static CoreResult core_results[BENCH_MAX_CORE_RESULTS];
+static size_t core_results_len;
+
+// bench_core reports the throughput of `next_token()` alone over the given
+// source with every supported scanner level, without keeping the tokens,
+// and records it in `core_results`.
+static void bench_core(const char* name, const char* source) {
+    size_t len = strlen(source);
+    pin_cpu();
+    for (ScanLevel level = SCAN_SCALAR; level <= SCAN_AVX2; level++) {
+        if (set_scan_level(level) != level) {
+            continue;
+        }
+        double best = 1e9;
+        uint64_t best_cycles = 0;
+        size_t ntokens = 0;
+        for (int round = 0; round < bench_rounds; round++) {
+            LexerState state;
+            init_lexer_state(&state, source);
+            ntokens = 0;
+            double start = now();
+            uint64_t start_cycles = read_cycles();
+            TokenKind kind;
+            while ((kind = next_token(&state)) != TOKEN_EOF) {
+                if (kind == TOKEN_ERROR) {
+                    fprintf(stderr, "%s: lexer error %d at offset %zu\n", name, state.error, state.token.start);
+                    exit(1);
+                }
+                ntokens++;
+            }
+            uint64_t cycles = read_cycles() - start_cycles;
+            double elapsed = now() - start;
+            if (elapsed < best) {
+                best = elapsed;
+                best_cycles = cycles;
+            }
+        }
+        printf("%-14s %-8s %10.1f MB/s %10.1f Mtok/s %8.2f cycles/B\n", name, level_names[level],
+               len / best / 1e6, ntokens / best / 1e6, (double)best_cycles / len);
+        if (core_results_len < BENCH_MAX_CORE_RESULTS) {
+            CoreResult* result = &core_results[core_results_len++];
+            snprintf(result->corpus, sizeof(result->corpus), "%s", name);
+            snprintf(result->level, sizeof(result->level), "%s", level_names[level]);
+            result->mbps = len / best / 1e6;
+            result->cycles_per_byte = (double)best_cycles / len;
+        }
+    }
+    set_scan_level(SCAN_AVX2);
+    unpin_cpu();
+}
+
+// record_baseline writes the core results to the file at `path`.
+static void record_baseline(const char* path, size_t size, const char* counter) {
+    FILE* f = fopen(path, "w");
+    if (f == NULL) {
+        perror(path);
+        exit(1);
+    }
+    fprintf(f, "# lexer_bench baseline: %zu bytes per corpus, %s\n", size, counter != NULL ? counter : "no cycles");
+    for (size_t i = 0; i < core_results_len; i++) {
+        const CoreResult* result = &core_results[i];
+        fprintf(f, "%s %s %.1f %.3f\n", result->corpus, result->level, result->mbps, result->cycles_per_byte);
+    }
+    fclose(f);
+}
+
+// compare_baseline compares the core results with the ones recorded in
+// the file at `path`, and returns the number of benchmarks more than
+// `tolerance` percent slower than their baseline.
+static int compare_baseline(const char* path, double tolerance) {
+    FILE* f = fopen(path, "r");
+    if (f == NULL) {
+        perror(path);
+        exit(1);
+    }
+    printf("\n%-14s %-8s %10s %10s %8s   (baseline %s)\n", "corpus", "level", "base MB/s", "MB/s", "delta", path);
+    int regressions = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), f) != NULL) {
+        CoreResult base;
+        if (line[0] == '#' ||
+            sscanf(line, "%31s %15s %lf %lf", base.corpus, base.level, &base.mbps, &base.cycles_per_byte) != 4) {
+            continue;
+        }
+        for (size_t i = 0; i < core_results_len; i++) {
+            const CoreResult* result = &core_results[i];
+            if (strcmp(result->corpus, base.corpus) != 0 || strcmp(result->level, base.level) != 0) {
+                continue;
+            }
+            double delta = (result->mbps - base.mbps) / base.mbps * 100;
+            bool regressed = delta < -tolerance;
+            regressions += regressed;
+            printf("%-14s %-8s %10.1f %10.1f %+7.1f%%%s\n", base.corpus, base.level, base.mbps, result->mbps,
+                   delta, regressed ? "   REGRESSION" : "");
+        }
+    }
+    fclose(f);
+    return regressions;
+}
+
+// bench_keywords compares the old keyword trie, which rescans the word
+// on a miss, with the single-pass scan and perfect hash lookup.
+static void bench_keywords(const char* source) {
+    double best_trie = 1e9, best_hash = 1e9;
+    size_t words = 0, keywords_trie = 0, keywords_hash = 0;
+    for (int round = 0; round < bench_rounds; round++) {
+        LexerState state;
+        init_lexer_state(&state, source);
+        double start = now();
+        words = keywords_trie = 0;
+        for (const char* p = source; *p; p++) {
+            state.current = p;
+            if (trie_keyword(&state) != TOKEN_ERROR) {
+                keywords_trie++;
+            } else {
+                state.current = scan_word(p);
+            }
+            p = state.current;
+            words++;
+        }
+        double elapsed = now() - start;
+        if (elapsed < best_trie) {
+            best_trie = elapsed;
+        }
+
+        start = now();
+        keywords_hash = 0;
+        for (const char* p = source; *p; p++) {
+            const char* end = scan_word(p);
+            if (lookup_keyword(p, end - p) != TOKEN_IDENTIFIER) {
+                keywords_hash++;
+            }
+            p = end;
+        }
+        elapsed = now() - start;
+        if (elapsed < best_hash) {
+            best_hash = elapsed;
+        }
+    }
+    if (keywords_trie != keywords_hash) {
+        fprintf(stderr, "keywords: trie found %zu keywords, hash found %zu\n", keywords_trie, keywords_hash);
+        exit(1);
+    }
+    printf("%-14s %-8s %10.1f Mword/s\n", "keywords", "trie", words / best_trie / 1e6);
+    printf("%-14s %-8s %10.1f Mword/s\n", "keywords", "hash", words / best_hash / 1e6);
+}
+
+// bench_lex reports the throughput of `lex_all()` over the given source
+// with every supported scanner level.
+static void bench_lex(const char* name, const char* source) {
+    size_t len = strlen(source);
+    TokenBuf tokens;
+    init_token_buf(&tokens);
+    for (ScanLevel level = SCAN_SCALAR; level <= SCAN_AVX2; level++) {
+        if (set_scan_level(level) != level) {
+            continue;
+        }
+        double best = 1e9;
+        for (int round = 0; round < bench_rounds; round++) {
+            LexerState state;
+            init_lexer_state(&state, source);
+            tokens.len = 0;
+            double start = now();
+            if (lex_all(&state, &tokens) != TOKEN_EOF) {
+                fprintf(stderr, "%s: lexer error %d at offset %zu\n",
+                        name, state.error, state.token.start);
+                exit(1);
+            }
+            double elapsed = now() - start;
+            if (elapsed < best) {
+                best = elapsed;
+            }
+        }
+        printf("%-14s %-8s %10.1f MB/s %10.1f Mtok/s\n", name, level_names[level],
+               len / best / 1e6, tokens.len / best / 1e6);
+    }
+    free_token_buf(&tokens);
+    set_scan_level(SCAN_AVX2);
+}
+
+// bench_utf8 reports the throughput of the UTF-8 validator of each level
+// over the given source.
+static void bench_utf8(const char* name, const char* source) {
+    size_t len = strlen(source);
+    for (ScanLevel level = SCAN_SCALAR; level <= SCAN_AVX2; level++) {
+        if (set_scan_level(level) != level) {
+            continue;
+        }
+        double best = 1e9;
+        for (int round = 0; round < bench_rounds; round++) {
+            double start = now();
+            if (scanner.validate_utf8(source, source + len) != source + len) {
+                fprintf(stderr, "%s: invalid UTF-8\n", name);
+                exit(1);
+            }
+            double elapsed = now() - start;
+            if (elapsed < best) {
+                best = elapsed;
+            }
+        }
+        printf("%-14s %-8s %10.1f MB/s (utf8)\n", name, level_names[level], len / best / 1e6);
+    }
+    set_scan_level(SCAN_AVX2);
+}
+
+// bench_intern reports the throughput of `lex_all()` over the given source
+// with identifiers and literals interned to a pool.
+static void bench_intern(const char* name, const char* source) {
+    size_t len = strlen(source);
+    TokenBuf tokens;
+    init_token_buf(&tokens);
+    double best = 1e9;
+    size_t symbols = 0;
+    for (int round = 0; round < bench_rounds; round++) {
+        InternPool pool;
+        init_intern_pool(&pool);
+        LexerState state;
+        init_lexer_state(&state, source);
+        state.intern = &pool;
+        tokens.len = 0;
+        double start = now();
+        if (lex_all(&state, &tokens) != TOKEN_EOF) {
+            fprintf(stderr, "%s: lexer error %d at offset %zu\n", name, state.error, state.token.start);
+            exit(1);
+        }
+        double elapsed = now() - start;
+        if (elapsed < best) {
+            best = elapsed;
+        }
+        symbols = pool.len;
+        free_intern_pool(&pool);
+    }
+    printf("%-14s %-8s %10.1f MB/s %10.1f Mtok/s (%zu symbols)\n", name, "intern",
+           len / best / 1e6, tokens.len / best / 1e6, symbols);
+    free_token_buf(&tokens);
+}
+
+// bench_strings reports the throughput of `lex_all()` over the given
+// source with the string literals decoded to an arena.
+static void bench_strings(const char* name, const char* source) {
+    size_t len = strlen(source);
+    TokenBuf tokens;
+    init_token_buf(&tokens);
+    double best = 1e9;
+    size_t copied = 0;
+    for (int round = 0; round < bench_rounds; round++) {
+        Arena strings;
+        init_arena(&strings);
+        LexerState state;
+        init_lexer_state(&state, source);
+        state.strings = &strings;
+        tokens.len = 0;
+        double start = now();
+        if (lex_all(&state, &tokens) != TOKEN_EOF) {
+            fprintf(stderr, "%s: lexer error %d at offset %zu\n", name, state.error, state.token.start);
+            exit(1);
+        }
+        double elapsed = now() - start;
+        if (elapsed < best) {
+            best = elapsed;
+        }
+        copied = strings.size;
+        free_arena(&strings);
+    }
+    printf("%-14s %-8s %10.1f MB/s %10.1f Mtok/s (%zu KB copied)\n", name, "strings",
+           len / best / 1e6, tokens.len / best / 1e6, copied >> 10);
+    free_token_buf(&tokens);
+}
+
+// BENCH_ERROR_GAP is the distance between the errors of `bench_recover()`.
+#define BENCH_ERROR_GAP 4096
+
+// bench_recover reports the throughput of `lex_recover()` on a copy of the
+// source with an invalid character every BENCH_ERROR_GAP bytes.
+static void bench_recover(const char* name, const char* source) {
+    size_t len = strlen(source);
+    char* broken = malloc(len + 1);
+    memcpy(broken, source, len + 1);
+    for (size_t i = BENCH_ERROR_GAP; i < len; i += BENCH_ERROR_GAP) {
+        broken[i] = '@';
+    }
+    TokenBuf tokens;
+    ErrorBuf errors;
+    init_token_buf(&tokens);
+    init_error_buf(&errors);
+    double best = 1e9;
+    for (int round = 0; round < bench_rounds; round++) {
+        LexerState state;
+        init_lexer_state(&state, broken);
+        tokens.len = 0;
+        errors.len = 0;
+        double start = now();
+        lex_recover(&state, &tokens, &errors);
+        double elapsed = now() - start;
+        if (state.error == LEXER_ENOMEM) {
+            fprintf(stderr, "%s: out of memory\n", name);
+            exit(1);
+        }
+        if (elapsed < best) {
+            best = elapsed;
+        }
+    }
+    printf("%-14s %-8s %10.1f MB/s %10.1f Mtok/s (%zu errors)\n", name, "recover",
+           len / best / 1e6, tokens.len / best / 1e6, errors.len);
+    free_token_buf(&tokens);
+    free_error_buf(&errors);
+    free(broken);
+}
+
+// bench_cache reports the size of the token file of the given source and
+// the throughput of loading it, against lexing the source.
+static void bench_cache(const char* name, const char* source) {
+    char path[] = "/tmp/lexer_bench_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        perror("mkstemp");
+        exit(1);
+    }
+    close(fd);
+    size_t len = strlen(source);
+    InternPool pool;
+    init_intern_pool(&pool);
+    LexerState state;
+    init_lexer_state(&state, source);
+    state.intern = &pool;
+    TokenBuf tokens;
+    init_token_buf(&tokens);
+    lex_all(&state, &tokens);
+    double start = now();
+    int err = save_tokens(path, &state, &tokens);
+    double save = now() - start;
+    if (err != 0) {
+        fprintf(stderr, "%s: %s\n", path, strerror(err));
+        exit(1);
+    }
+    free_intern_pool(&pool);
+
+    double best = 1e9;
+    size_t size = 0;
+    for (int round = 0; round < bench_rounds; round++) {
+        init_intern_pool(&pool);
+        tokens.len = 0;
+        start = now();
+        TokenCache cache;
+        err = open_token_cache(&cache, path, &pool);
+        if (err == 0) {
+            err = load_tokens(&cache, &tokens);
+        }
+        double elapsed = now() - start;
+        if (err != 0) {
+            fprintf(stderr, "%s: %s\n", path, strerror(err));
+            exit(1);
+        }
+        if (elapsed < best) {
+            best = elapsed;
+        }
+        size = cache.file.len;
+        close_token_cache(&cache);
+        free_intern_pool(&pool);
+    }
+    printf("%-14s %-8s %10.1f MB/s %10.1f Mtok/s (%.2f file bytes/source byte, save %.1f ms)\n", name, "cache",
+           len / best / 1e6, tokens.len / best / 1e6, (double)size / len, save * 1e3);
+    free_token_buf(&tokens);
+    unlink(path);
+}
+
+// BENCH_FILE_SIZE is the largest file of the batch benchmark.
+#define BENCH_FILE_SIZE (32 << 10)
+
+// bench_batch splits the source into files of 1 to 32KB at line
+// boundaries and reports the throughput of `lex_batch()` over them with
+// up to one worker per online processor.
+static void bench_batch(const char* source) {
+    char dir[] = "/tmp/lexer_bench_XXXXXX";
+    if (mkdtemp(dir) == NULL) {
+        perror("mkdtemp");
+        exit(1);
+    }
+    size_t len = strlen(source), nfiles = 0, cap = 0;
+    char** paths = NULL;
+    unsigned seed = 7;
+    for (size_t pos = 0; pos < len; nfiles++) {
+        seed = seed * 1103515245 + 12345;
+        size_t end = pos + 1024 + (seed >> 16) % (BENCH_FILE_SIZE - 1024);
+        if (end >= len) {
+            end = len;
+        } else {
+            end = strchr(source + end, '\n') - source + 1;
+        }
+        if (nfiles == cap) {
+            cap = cap == 0 ? 256 : cap * 2;
+            paths = realloc(paths, cap * sizeof(char*));
+        }
+        paths[nfiles] = malloc(sizeof(dir) + 16);
+        sprintf(paths[nfiles], "%s/%zu.so", dir, nfiles);
+        FILE* f = fopen(paths[nfiles], "w");
+        fwrite(source + pos, 1, end - pos, f);
+        fclose(f);
+        pos = end;
+    }
+
+    BatchResult* results = malloc(nfiles * sizeof(BatchResult));
+    int ncpus = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    double base = 0;
+    for (int threads = 1; ; threads = threads * 2 < ncpus ? threads * 2 : ncpus) {
+        double best = 1e9;
+        for (int round = 0; round < bench_rounds; round++) {
+            double start = now();
+            lex_batch((const char* const*)paths, nfiles, threads, NULL, NULL, results);
+            double elapsed = now() - start;
+            if (elapsed < best) {
+                best = elapsed;
+            }
+        }
+        for (size_t i = 0; i < nfiles; i++) {
+            if (results[i].kind != TOKEN_EOF) {
+                fprintf(stderr, "batch: %s failed with error %d\n", paths[i], results[i].error);
+                exit(1);
+            }
+        }
+        if (threads == 1) {
+            base = best;
+        }
+        printf("%-14s %-8d %10.1f MB/s %10.2fx (%zu files)\n", "batch", threads,
+               len / best / 1e6, base / best, nfiles);
+        if (threads >= ncpus) {
+            break;
+        }
+    }
+
+    for (size_t i = 0; i < nfiles; i++) {
+        unlink(paths[i]);
+        free(paths[i]);
+    }
+    rmdir(dir);
+    free(paths);
+    free(results);
+}
+
+// BENCH_EDITS is the number of edits of the relex benchmark.
+#define BENCH_EDITS 10000
+
+// bench_relex reports the latency of `relex_edit()` for keystrokes at
+// random offsets of the given source, against lexing it all again.
+static void bench_relex(const char* source) {
+    size_t len = strlen(source);
+    char* text = malloc(len + BENCH_EDITS + 2);
+    memcpy(text, source, len + 1);
+    RelexBuf tokens;
+    init_relex_buf(&tokens);
+    LexerState state;
+    init_lexer_slice(&state, text, len);
+    double start = now();
+    relex_all(&state, &tokens);
+    double full = now() - start;
+
+    // Type a space and delete it again, which leaves the tokens unchanged.
+    // Moving the text is the editor's cost, it isn't timed.
+    unsigned seed = 1;
+    double elapsed = 0;
+    for (int i = 0; i < BENCH_EDITS; i++) {
+        seed = seed * 1103515245 + 12345;
+        size_t offset = (seed >> 4) % len;
+        memmove(text + offset + 1, text + offset, len - offset + 1);
+        text[offset] = ' ';
+        init_lexer_slice(&state, text, len + 1);
+        start = now();
+        relex_edit(&state, &tokens, (LexerEdit){ offset, 0, 1 });
+        elapsed += now() - start;
+        memmove(text + offset, text + offset + 1, len - offset + 1);
+        init_lexer_slice(&state, text, len);
+        start = now();
+        relex_edit(&state, &tokens, (LexerEdit){ offset, 1, 0 });
+        elapsed += now() - start;
+    }
+    double random = elapsed / (2 * BENCH_EDITS);
+
+    // Type a line of text one character at a time.
+    static const char line[] = "    total = total + compute(item, 42) # note\n";
+    size_t offset = len / 2;
+    elapsed = 0;
+    start = now();
+    for (int i = 0; i < BENCH_EDITS; i++) {
+        char c = line[i % (sizeof(line) - 1)];
+        memmove(text + offset + 1, text + offset, len - offset + 1);
+        text[offset] = c;
+        init_lexer_slice(&state, text, ++len);
+        start = now();
+        relex_edit(&state, &tokens, (LexerEdit){ offset++, 0, 1 });
+        elapsed += now() - start;
+    }
+    double typing = elapsed / BENCH_EDITS;
+    printf("%-14s %-8s %10.1f us/edit %8.1f us/keystroke %8.1f us/lex_all\n", "relex", "",
+           random * 1e6, typing * 1e6, full * 1e6);
+    free_lexer_state(&state);
+    free_relex_buf(&tokens);
+    free(text);
+}
+
+// bench_split reports the throughput of `lex_split()` over the given
+// source with up to one worker per online processor.
+static void bench_split(const char* source) {
+    size_t len = strlen(source);
+    TokenBuf tokens;
+    init_token_buf(&tokens);
+    int ncpus = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    double base = 0;
+    for (int threads = 1; ; threads = threads * 2 < ncpus ? threads * 2 : ncpus) {
+        double best = 1e9;
+        for (int round = 0; round < bench_rounds; round++) {
+            LexerState state;
+            init_lexer_state(&state, source);
+            tokens.len = 0;
+            double start = now();
+            if (lex_split(&state, &tokens, threads) != TOKEN_EOF) {
+                fprintf(stderr, "split: lexer error %d at offset %zu\n", state.error, state.token.start);
+                exit(1);
+            }
+            double elapsed = now() - start;
+            if (elapsed < best) {
+                best = elapsed;
+            }
+        }
+        if (threads == 1) {
+            base = best;
+        }
+        printf("%-14s %-8d %10.1f MB/s %10.2fx\n", "split", threads, len / best / 1e6, base / best);
+        if (threads >= ncpus) {
+            break;
+        }
+    }
+    free_token_buf(&tokens);
+}
+
+// bench_str_heavy runs the benchmarks of string literals.
+static void bench_str_heavy(const char* source) {
+    bench_lex("str-heavy", source);
+    bench_utf8("str-heavy", source);
+    bench_strings("str-heavy", source);
+}
+
+// bench_num_heavy runs the benchmarks of number literals.
+static void bench_num_heavy(const char* source) {
+    bench_lex("num-heavy", source);
+}
+
+// bench_ident_heavy runs the benchmarks of identifiers and keywords.
+static void bench_ident_heavy(const char* source) {
+    bench_keywords(source);
+    bench_lex("ident-heavy", source);
+    bench_intern("ident-heavy", source);
+}
+
+// bench_comment_heavy runs the benchmarks of comments.
+static void bench_comment_heavy(const char* source) {
+    bench_lex("comment-heavy", source);
+}
+
+// bench_op_dense runs the benchmarks of operators.
+static void bench_op_dense(const char* source) {
+    bench_lex("op-dense", source);
+}
+
+// bench_mixed runs the benchmarks of whole sources.
+static void bench_mixed(const char* source) {
+    bench_lex("mixed", source);
+    bench_utf8("mixed", source);
+    bench_intern("mixed", source);
+    bench_cache("mixed", source);
+    bench_recover("mixed", source);
+    bench_batch(source);
+    bench_split(source);
+    bench_relex(source);
+}
+
+// Corpora are the generated sources of the benchmarks, each with its core
+// benchmark and the rest of its suite.
+static const struct {
+    const char* name;
+    char* (*gen)(size_t size);
+    void (*bench)(const char* source);
+} Corpora[] = {
+    { "str-heavy", gen_str_heavy, bench_str_heavy },
+    { "num-heavy", gen_num_heavy, bench_num_heavy },
+    { "ident-heavy", gen_ident_heavy, bench_ident_heavy },
+    { "comment-heavy", gen_comment_heavy, bench_comment_heavy },
+    { "op-dense", gen_op_dense, bench_op_dense },
+    { "mixed", gen_mixed, bench_mixed },
+};
+
+static void usage(const char* name) {
+    fprintf(stderr,
+            "usage: %s [-q] [-c cpu] [-n rounds] [-r file] [-b file] [-t percent] [size]\n"
+            "\n"
+            "  size        bytes per corpus, with an optional K, M or G suffix (default 16M)\n"
+            "  -q          only run the core benchmarks of next_token()\n"
+            "  -c cpu      pin the core benchmarks to the given CPU\n"
+            "  -n rounds   keep the best of the given number of rounds (default %d)\n"
+            "  -r file     record the core results as a baseline to the file\n"
+            "  -b file     compare the core results with the baseline in the file\n"
+            "  -t percent  slowdown against the baseline reported as a regression (default 5)\n",
+            name, BENCH_ROUNDS);
+    exit(2);
+}
+
+int main(int argc, char **argv) {
+    size_t size = 16 << 20;
+    bool core_only = false;
+    const char* record = NULL;
+    const char* baseline = NULL;
+    double tolerance = 5;
+    int opt;
+    while ((opt = getopt(argc, argv, "qc:n:r:b:t:")) != -1) {
+        switch (opt) {
+            case 'q': core_only = true; break;
+            case 'c': bench_cpu = atoi(optarg); break;
+            case 'n': bench_rounds = atoi(optarg); break;
+            case 'r': record = optarg; break;
+            case 'b': baseline = optarg; break;
+            case 't': tolerance = atof(optarg); break;
+            default: usage(argv[0]);
+        }
+    }
+    if (optind < argc) {
+        size = parse_size(argv[optind]);
+    }
+    if (size == 0 || bench_rounds <= 0 || optind + 1 < argc) {
+        usage(argv[0]);
+    }
+    if (!core_only && size > BENCH_FULL_LIMIT) {
+        printf("# only the core benchmarks run on corpora over %zu MB\n", BENCH_FULL_LIMIT >> 20);
+        core_only = true;
+    }
+    const char* counter = init_cycles();
+    printf("# %zu bytes per corpus, best of %d rounds, %s", size, bench_rounds,
+           counter != NULL ? counter : "no cycle counter");
+    if (bench_cpu >= 0) {
+        printf(", pinned to CPU %d", bench_cpu);
+    }
+    printf("\n");
+
+    for (size_t i = 0; i < sizeof(Corpora) / sizeof(Corpora[0]); i++) {
+        char* source = Corpora[i].gen(size);
+        bench_core(Corpora[i].name, source);
+        if (!core_only) {
+            Corpora[i].bench(source);
+        }
+        free(source);
+    }
+
+    if (record != NULL) {
+        record_baseline(record, size, counter);
+    }
+    if (baseline != NULL && compare_baseline(baseline, tolerance) > 0) {
+        return 1;
+    }
+    return 0;
+}
@@ -1,7 +1,22 @@
 #include <string.h>
 #include <stdio.h>
 #include <assert.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "batch.h"
+#include "cache.h"
+#include "intern.h"
 #include "lexer.h"
+#include "relex.h"
+#include "scan.h"
+#include "source.h"
+#include "stream.h"
 
 #define LEXER_TEST_PASS(input, expected, expected_pos) {\
     LexerState s = {0};\
@@ -19,6 +34,1157 @@
     assert(s.current == s.source + (expected_pos));\
 }
 
+#define LEXER_TEST_SLICE_PASS(input, len, expected, expected_pos) {\
+    LexerState s = {0};\
+    init_lexer_slice(&s, (input), (len)); \
+    assert(next_token(&s) == (expected)); \
+    assert(s.current == s.source + (expected_pos));\
+}
+
+#define LEXER_TEST_SLICE_FAILED(input, len, expected_error, expected_pos) {\
+    LexerState s = {0};\
+    init_lexer_slice(&s, (input), (len)); \
+    assert(next_token(&s) == TOKEN_ERROR); \
+    assert(s.error == (expected_error)); \
+    assert(s.current == s.source + (expected_pos));\
+}
+
+#define LEXER_TEST_TOKEN(tokens, i, expected, expected_start, expected_len, expected_line, expected_col) {\
+    const Token* t = &(tokens).buf[(i)]; \
+    assert(t->kind == (expected)); \
+    assert(t->start == (expected_start)); \
+    assert(t->len == (expected_len)); \
+    assert(t->line == (expected_line)); \
+    assert(t->col == (expected_col)); \
+}
+
+static void test_lex_all() {
+    LexerState s = {0};
+    TokenBuf tokens;
+    init_token_buf(&tokens);
+    init_lexer_state(&s, "const x = 42\n  foo(\"a\") # c\n");
+    assert(lex_all(&s, &tokens) == TOKEN_EOF);
+    assert(tokens.len == 9);
+    locate_tokens(&s, tokens.buf, tokens.len);
+    LEXER_TEST_TOKEN(tokens, 0, TOKEN_CONST, 0, 5, 1, 1);
+    LEXER_TEST_TOKEN(tokens, 1, TOKEN_IDENTIFIER, 6, 1, 1, 7);
+    LEXER_TEST_TOKEN(tokens, 2, TOKEN_EQUAL, 8, 1, 1, 9);
+    LEXER_TEST_TOKEN(tokens, 3, TOKEN_INT_LITERAL, 10, 2, 1, 11);
+    LEXER_TEST_TOKEN(tokens, 4, TOKEN_IDENTIFIER, 15, 3, 2, 3);
+    LEXER_TEST_TOKEN(tokens, 5, TOKEN_LPAREN, 18, 1, 2, 6);
+    LEXER_TEST_TOKEN(tokens, 6, TOKEN_STR_LITERAL, 19, 3, 2, 7);
+    LEXER_TEST_TOKEN(tokens, 7, TOKEN_RPAREN, 22, 1, 2, 10);
+    LEXER_TEST_TOKEN(tokens, 8, TOKEN_EOF, 28, 0, 3, 1);
+
+    free_lexer_state(&s);
+
+    tokens.len = 0;
+    init_lexer_state(&s, "x @");
+    assert(lex_all(&s, &tokens) == TOKEN_ERROR);
+    assert(s.error == LEXER_EINVALIDCHAR);
+    assert(tokens.len == 2);
+    locate_tokens(&s, tokens.buf, tokens.len);
+    LEXER_TEST_TOKEN(tokens, 1, TOKEN_ERROR, 2, 0, 1, 3);
+    free_lexer_state(&s);
+    free_token_buf(&tokens);
+}
+
+// test_recover_source checks that lex_recover() resumes after every error
+// at a token boundary: each token is the one lexed from its start, and the
+// error tokens are the recorded errors.
+static void test_recover_source(const char* source, size_t len) {
+    LexerState s = {0};
+    TokenBuf tokens;
+    ErrorBuf errors;
+    init_token_buf(&tokens);
+    init_error_buf(&errors);
+    init_lexer_slice(&s, source, len);
+    TokenKind kind = lex_recover(&s, &tokens, &errors);
+    assert(kind == (errors.len == 0 ? TOKEN_EOF : TOKEN_ERROR));
+    assert(tokens.len > 0 && tokens.buf[tokens.len - 1].kind == TOKEN_EOF);
+    assert(tokens.buf[tokens.len - 1].start <= len);
+
+    size_t nerrors = 0, end = 0;
+    for (size_t i = 0; i < tokens.len; i++) {
+        const Token* token = &tokens.buf[i];
+        assert(token->start >= end);
+        end = token->start + token->len;
+        LexerState t = {0};
+        init_lexer_slice(&t, source + token->start, len - token->start);
+        TokenKind relexed = next_token(&t);
+        if (token->kind == TOKEN_ERROR) {
+            assert(relexed == TOKEN_ERROR);
+            assert(nerrors < errors.len);
+            const ErrorSpan* e = &errors.buf[nerrors++];
+            assert(e->error == t.error && e->error != LEXER_EOK);
+            assert(e->start == token->start && e->len == token->len && e->len > 0);
+        } else {
+            assert(relexed == token->kind);
+            assert(t.token.start == 0 && t.token.len == token->len);
+        }
+        free_lexer_state(&t);
+    }
+    assert(nerrors == errors.len);
+    if (errors.len > 0) {
+        assert(s.error == errors.buf[errors.len - 1].error);
+    }
+    free_lexer_state(&s);
+    free_token_buf(&tokens);
+    free_error_buf(&errors);
+}
+
+static void test_recover() {
+    const char* source =
+        "x = @@ y\n"
+        "s = \"a\\qb\" + 1\n"
+        "t = \"abc\n"
+        "u = 0b12 + 'xy' # c\n"
+        "v = \xff\xfeq 1e999)";
+    LexerState s = {0};
+    TokenBuf tokens;
+    ErrorBuf errors;
+    init_token_buf(&tokens);
+    init_error_buf(&errors);
+    init_lexer_state(&s, source);
+    assert(lex_recover(&s, &tokens, &errors) == TOKEN_ERROR);
+    assert(s.error == LEXER_ERANGE);
+    assert(tokens.len == 24);
+    locate_tokens(&s, tokens.buf, tokens.len);
+    LEXER_TEST_TOKEN(tokens, 2, TOKEN_ERROR, 4, 2, 1, 5);
+    LEXER_TEST_TOKEN(tokens, 3, TOKEN_IDENTIFIER, 7, 1, 1, 8);
+    LEXER_TEST_TOKEN(tokens, 6, TOKEN_ERROR, 13, 6, 2, 5);
+    LEXER_TEST_TOKEN(tokens, 7, TOKEN_PLUS, 20, 1, 2, 12);
+    LEXER_TEST_TOKEN(tokens, 11, TOKEN_ERROR, 28, 4, 3, 5);
+    LEXER_TEST_TOKEN(tokens, 12, TOKEN_IDENTIFIER, 33, 1, 4, 1);
+    LEXER_TEST_TOKEN(tokens, 14, TOKEN_ERROR, 37, 4, 4, 5);
+    LEXER_TEST_TOKEN(tokens, 16, TOKEN_ERROR, 44, 4, 4, 12);
+    LEXER_TEST_TOKEN(tokens, 19, TOKEN_ERROR, 57, 2, 5, 5);
+    LEXER_TEST_TOKEN(tokens, 20, TOKEN_IDENTIFIER, 59, 1, 5, 7);
+    LEXER_TEST_TOKEN(tokens, 21, TOKEN_ERROR, 61, 5, 5, 9);
+    LEXER_TEST_TOKEN(tokens, 22, TOKEN_RPAREN, 66, 1, 5, 14);
+    LEXER_TEST_TOKEN(tokens, 23, TOKEN_EOF, 67, 0, 5, 15);
+    static const LexerError expected[] = {
+        LEXER_EINVALIDCHAR, LEXER_EESCAPE, LEXER_EMULTILINESTR, LEXER_EBINCHR,
+        LEXER_ECHREND, LEXER_EINVALIDCHAR, LEXER_ERANGE,
+    };
+    assert(errors.len == sizeof(expected) / sizeof(expected[0]));
+    for (size_t i = 0; i < errors.len; i++) {
+        assert(errors.buf[i].error == expected[i]);
+    }
+    free_lexer_state(&s);
+
+    // Without errors, the tokens are the ones of lex_all().
+    TokenBuf expected_tokens;
+    init_token_buf(&expected_tokens);
+    tokens.len = 0;
+    errors.len = 0;
+    init_lexer_state(&s, "const x = 42\n  foo(\"a\") # c\n");
+    assert(lex_all(&s, &expected_tokens) == TOKEN_EOF);
+    free_lexer_state(&s);
+    init_lexer_state(&s, "const x = 42\n  foo(\"a\") # c\n");
+    assert(lex_recover(&s, &tokens, &errors) == TOKEN_EOF);
+    assert(s.error == LEXER_EOK && errors.len == 0);
+    assert(tokens.len == expected_tokens.len);
+    assert(memcmp(tokens.buf, expected_tokens.buf, tokens.len * sizeof(Token)) == 0);
+    free_lexer_state(&s);
+    free_token_buf(&expected_tokens);
+    free_token_buf(&tokens);
+    free_error_buf(&errors);
+
+    test_recover_source("\"unterminated", 13);
+    test_recover_source("'", 1);
+    test_recover_source("a\0b\0\0c", 6);
+    test_recover_source("\"a\\\nb\" c", 8);
+    test_recover_source("'\\x' '\\x4' '\\q'", 15);
+
+    // Random mixes of tokens and broken tokens.
+    static const char* pieces[] = {
+        " ", "\n", "x", "42", "0x", "0b2", "1e", "1e999", "\"s\"", "\"", "'", "'ab'", "'\\x'", "'\\q'",
+        "\\", "\\q", "@", "\xff", "\xc3\xa9", "#", "(", "=", "\0", "_",
+    };
+    char source2[512];
+    unsigned seed = 23;
+    for (int round = 0; round < 2000; round++) {
+        size_t len = 0;
+        while (len < 64) {
+            seed = seed * 1103515245 + 12345;
+            const char* piece = pieces[(seed >> 16) % (sizeof(pieces) / sizeof(pieces[0]))];
+            size_t n = *piece == '\0' ? 1 : strlen(piece);
+            memcpy(source2 + len, piece, n);
+            len += n;
+        }
+        test_recover_source(source2, len);
+    }
+}
+
+static void test_positions() {
+    LexerState s = {0};
+    int line, column;
+    init_lexer_state(&s, "ab\n\ncd # x\n  \"e\"");
+    locate_offset(&s, 0, &line, &column);
+    assert(line == 1 && column == 1);
+    locate_offset(&s, 2, &line, &column);
+    assert(line == 1 && column == 3);
+    locate_offset(&s, 3, &line, &column);
+    assert(line == 2 && column == 1);
+    locate_offset(&s, 6, &line, &column);
+    assert(line == 3 && column == 3);
+    while (next_token(&s) != TOKEN_STR_LITERAL);
+    sync_lexer_position(&s);
+    assert(s.line == 4 && s.column == 6);
+    free_lexer_state(&s);
+}
+
+// test_keywords checks that every reserved keyword has its own slot in
+// the perfect hash, and that near misses are identifiers.
+static void test_keywords() {
+    for (TokenKind kind = TOKEN_AND; kind <= TOKEN_WHILE; kind++) {
+        char word[16] = {0};
+        const char* name = get_tok_name(kind) + strlen("TOKEN_");
+        for (size_t i = 0; name[i]; i++) {
+            word[i] = tolower(name[i]);
+        }
+        assert(lookup_keyword(word, strlen(word)) == kind);
+    }
+    assert(lookup_keyword("an", 2) == TOKEN_IDENTIFIER);
+    assert(lookup_keyword("ands", 4) == TOKEN_IDENTIFIER);
+    assert(lookup_keyword("If", 2) == TOKEN_IDENTIFIER);
+    assert(lookup_keyword("continues", 9) == TOKEN_IDENTIFIER);
+    assert(lookup_keyword("x", 1) == TOKEN_IDENTIFIER);
+}
+
+// validate_utf8_naive returns the first invalid sequence in [p, end).
+static const char* validate_utf8_naive(const char* p, const char* end) {
+    while (p < end) {
+        size_t len = utf8_char_len(p, end);
+        if (len == 0) {
+            return p;
+        }
+        p += len;
+    }
+    return end;
+}
+
+// test_utf8 checks the UTF-8 validators of every level against a decoder
+// one sequence at a time.
+static void test_utf8() {
+    static const char* valid[] = {
+        "a", "z", "\xc2\x80", "\xdf\xbf", "\xe0\xa0\x80", "\xe4\xbd\xa0",
+        "\xed\x9f\xbf", "\xee\x80\x80", "\xef\xbf\xbf", "\xf0\x90\x80\x80",
+        "\xf3\xbf\xbf\xbf", "\xf4\x8f\xbf\xbf", "hello, world ",
+    };
+    static const char* invalid[] = {
+        "\x80", "\xbf", "\xc0\x80", "\xc1\xbf", "\xc2", "\xc2" "a", "\xe0\x80\x80",
+        "\xe0\x9f\xbf", "\xed\xa0\x80", "\xed\xbf\xbf", "\xe4\xbd", "\xe4\xbd" "a",
+        "\xf0\x80\x80\x80", "\xf0\x8f\xbf\xbf", "\xf4\x90\x80\x80", "\xf5\x80\x80\x80",
+        "\xf8\x88\x80\x80\x80", "\xff", "\xe4\xbd\xa0\xa0",
+    };
+    for (size_t i = 0; i < sizeof(valid) / sizeof(valid[0]); i++) {
+        size_t len = strlen(valid[i]);
+        assert(utf8_char_len(valid[i], valid[i] + len) == (valid[i][0] & 0x80 ? len : 1));
+    }
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+        const char* end = invalid[i] + strlen(invalid[i]);
+        assert(validate_utf8_naive(invalid[i], end) != end);
+    }
+
+    // Random runs of sequences, mostly ASCII, with an occasional invalid
+    // one at every alignment and near block boundaries.
+    char buf[512 + 64];
+    unsigned seed = 15;
+    for (int round = 0; round < 20000; round++) {
+        char* p = buf + round % 32;
+        char* end = p;
+        size_t size = round % 7 == 0 ? 512 : round % 100;
+        while ((size_t)(end - p) < size) {
+            seed = seed * 1103515245 + 12345;
+            unsigned r = seed >> 16;
+            const char* piece;
+            if (r % 64 == 0) {
+                piece = invalid[(r >> 6) % (sizeof(invalid) / sizeof(invalid[0]))];
+            } else if (r % 4 == 0) {
+                piece = valid[(r >> 6) % (sizeof(valid) / sizeof(valid[0]))];
+            } else {
+                piece = "abcdefgh";
+            }
+            size_t len = strlen(piece);
+            memcpy(end, piece, len);
+            end += len;
+        }
+        const char* expected = validate_utf8_naive(p, end);
+        for (ScanLevel level = SCAN_SCALAR; level <= SCAN_AVX2; level++) {
+            if (set_scan_level(level) != level) {
+                continue;
+            }
+            assert(scanner.validate_utf8(p, end) == expected);
+        }
+    }
+    set_scan_level(SCAN_AVX2);
+
+    // String and char literals.
+    LEXER_TEST_PASS("\"h\xc3\xa9llo \\n w\xc3\xb6rld\"", TOKEN_STR_LITERAL, 18);
+    LEXER_TEST_FAILED("\"ab\xff\"", LEXER_EUTF8CHR, 3);
+    LEXER_TEST_FAILED("\"\\n\xed\xa0\x80\"", LEXER_EUTF8CHR, 3);
+    LEXER_TEST_FAILED("\"\xc3\"", LEXER_EUTF8CHR, 1);
+    LEXER_TEST_FAILED("'\xc0\x80'", LEXER_EUTF8CHR, 1);
+    LEXER_TEST_FAILED("'\xf4\x90\x80\x80'", LEXER_EUTF8CHR, 1);
+    LEXER_TEST_FAILED("'\xc3\n'", LEXER_EUTF8CHR, 1);
+
+    LexerState s = {0};
+    init_lexer_state(&s, "x = \"\xe4\xbd\xa0\" # \xc3\xa9\n");
+    assert(validate_lexer_source(&s));
+    assert(s.utf8_valid);
+    init_lexer_state(&s, "x = 1 # \xe4\xbd\n");
+    assert(!validate_lexer_source(&s));
+    assert(s.error == LEXER_EUTF8CHR);
+    assert(s.current == s.source + 8);
+}
+
+// lex_number returns the token of a number literal, with its value.
+static Token lex_number(const char* input) {
+    LexerState s = {0};
+    init_lexer_state(&s, input);
+    TokenKind kind = next_token(&s);
+    assert(kind == TOKEN_ERROR || s.token.len == strlen(input));
+    return s.token;
+}
+
+static void test_number_int(const char* input, uint64_t expected) {
+    Token token = lex_number(input);
+    assert(token.kind == TOKEN_INT_LITERAL);
+    assert(token.value.i == expected);
+}
+
+static void test_number_float(const char* input) {
+    Token token = lex_number(input);
+    assert(token.kind == TOKEN_FLOAT_LITERAL);
+    // Bit for bit, and -0.0 isn't a literal.
+    double expected = strtod(input, NULL);
+    assert(memcmp(&token.value.f, &expected, sizeof(double)) == 0);
+}
+
+static void test_number_range(const char* input) {
+    LexerState s = {0};
+    init_lexer_state(&s, input);
+    assert(next_token(&s) == TOKEN_ERROR);
+    assert(s.error == LEXER_ERANGE);
+}
+
+static void test_numbers() {
+    test_number_int("0", 0);
+    test_number_int("42", 42);
+    test_number_int("1_000", 1000);
+    test_number_int("007", 7);
+    test_number_int("0b1011", 11);
+    test_number_int("0o777", 0777);
+    test_number_int("0x1F", 0x1f);
+    test_number_int("0xdead_BEEF", 0xdeadbeef);
+    test_number_int("18446744073709551615", UINT64_MAX);
+    test_number_int("0xffff_ffff_ffff_ffff", UINT64_MAX);
+    test_number_int("0o1777777777777777777777", UINT64_MAX);
+    test_number_int("0b1111111111111111111111111111111111111111111111111111111111111111", UINT64_MAX);
+    test_number_range("18446744073709551616");
+    test_number_range("99999999999999999999999");
+    test_number_range("0x1_0000_0000_0000_0000");
+    test_number_range("0o2000000000000000000000");
+    test_number_range("0b10000000000000000000000000000000000000000000000000000000000000000");
+
+    test_number_float("0.0");
+    test_number_float("1.5");
+    test_number_float("3.14159");
+    test_number_float("1e23");
+    test_number_float("1E-5");
+    test_number_float("1e+10");
+    test_number_float("0.1");
+    test_number_float("0.30000000000000004");
+    test_number_float("9007199254740993.0");
+    test_number_float("2.2250738585072013e-308");
+    test_number_float("2.2250738585072011e-308");
+    test_number_float("4.9e-324");
+    test_number_float("2.4703282292062327e-324");
+    test_number_float("2.4703282292062328e-324");
+    test_number_float("1.7976931348623157e308");
+    test_number_float("1e-400");
+    test_number_float("0.000000000000000000000000000001e30");
+    test_number_float("123456789012345678901234567890.0");
+    test_number_float("9007199254740992.000000000000000000001");
+    test_number_float("7.2057594037927933e16");
+    test_number_float("1e-99999999999");
+    test_number_range("1e400");
+    test_number_range("1.7976931348623159e308");
+    test_number_range("1e99999999999");
+
+    Token token = lex_number("1_000.000_5e1_0");
+    assert(token.kind == TOKEN_FLOAT_LITERAL);
+    assert(token.value.f == 1000.0005e10);
+
+    // Random literals of up to 25 digits over the whole range of exponents.
+    srand(14);
+    char input[64];
+    for (int i = 0; i < 100000; i++) {
+        int digits = 1 + rand() % 25;
+        int dot = rand() % digits;
+        size_t n = 0;
+        for (int j = 0; j < digits; j++) {
+            if (j == dot + 1) {
+                input[n++] = '.';
+            }
+            input[n++] = '0' + rand() % 10;
+        }
+        if (dot + 1 == digits) {
+            input[n++] = '.';
+            input[n++] = '0';
+        }
+        sprintf(input + n, "e%d", rand() % 661 - 350);
+        Token token = lex_number(input);
+        if (token.kind == TOKEN_ERROR) {
+            assert(strtod(input, NULL) == HUGE_VAL);
+        } else {
+            test_number_float(input);
+        }
+    }
+
+    // Long literals at and around the halfway point between two doubles,
+    // which need all of their digits.
+    test_number_float("9007199254740993.00000000000000000000");
+    test_number_float("9007199254740993.00000000000000000001");
+    test_number_float("9007199254740992.99999999999999999999");
+    test_number_float("1.00000000000000011102230246251565404236316680908203125");
+    test_number_float("1.00000000000000011102230246251565404236316680908203124");
+    test_number_float("1.000000000000000111022302462515654042363166809082031250000000001");
+    test_number_float("1797693134862315807937289714053034150799341327100378269361737789804e242");
+    test_number_range("1797693134862315807937289714053034150799341327100378269361737789805e242");
+    char long_input[1024] = "1.";
+    memset(long_input + 2, '0', 900);
+    strcpy(long_input + 902, "1e-5");
+    test_number_float(long_input);
+#if LDBL_MANT_DIG >= 64
+    // A long double holds the halfway point exactly, and prints it with all
+    // of its digits.
+    char halfway[1024];
+    for (int i = 0; i < 20000; i++) {
+        double d = ldexp((double)((uint64_t)rand() << 31 ^ rand()), rand() % 2100 - 1100);
+        if (d == 0 || isinf(d) || !isfinite(nextafter(d, INFINITY))) {
+            continue;
+        }
+        long double h = ((long double)d + nextafter(d, INFINITY)) / 2;
+        long double eps = (nextafter(d, INFINITY) - (long double)d) / 1024;
+        sprintf(halfway, "%.800Le", h);
+        test_number_float(halfway);
+        sprintf(halfway, "%.30Le", h - eps);
+        test_number_float(halfway);
+        sprintf(halfway, "%.30Le", h + eps);
+        test_number_float(halfway);
+    }
+#endif
+}
+
+// test_str_value checks the decoded value of a string literal.
+static void test_str_value(Arena* strings, const char* input, const char* expected, size_t len) {
+    LexerState s = {0};
+    init_lexer_state(&s, input);
+    s.strings = strings;
+    assert(next_token(&s) == TOKEN_STR_LITERAL);
+    const TokenStr* str = &s.token.value.str;
+    assert(str->len == len);
+    assert(memcmp(str->text, expected, len) == 0);
+    // Only literals with escapes are copied.
+    bool in_source = str->text == s.source + 1;
+    assert(in_source == (strchr(input, '\\') == NULL));
+
+    // Decoded again after the scan.
+    Token token = s.token;
+    token.value.str.text = NULL;
+    assert(decode_tokens(&s, &token, 1));
+    assert(token.value.str.len == len);
+    assert(memcmp(token.value.str.text, expected, len) == 0);
+}
+
+static void test_literal_values() {
+    Token token = lex_number("'a'");
+    assert(token.kind == TOKEN_CHAR_LITERAL && token.value.i == 'a');
+    token = lex_number("'\xe4\xbd\xa0'");
+    assert(token.kind == TOKEN_CHAR_LITERAL && token.value.i == 0x4f60);
+    token = lex_number("'\\n'");
+    assert(token.kind == TOKEN_CHAR_LITERAL && token.value.i == '\n');
+    token = lex_number("'\\xA0'");
+    assert(token.kind == TOKEN_CHAR_LITERAL && token.value.i == 0xa0);
+    token = lex_number("'\\U0001F600'");
+    assert(token.kind == TOKEN_CHAR_LITERAL && token.value.i == 0x1f600);
+
+    Arena strings;
+    init_arena(&strings);
+    test_str_value(&strings, "\"\"", "", 0);
+    test_str_value(&strings, "\"abc\"", "abc", 3);
+    test_str_value(&strings, "\"h\xc3\xa9llo\"", "h\xc3\xa9llo", 6);
+    test_str_value(&strings, "\"a\\nb\"", "a\nb", 3);
+    test_str_value(&strings, "\"\\\"q\\\"\\\\\"", "\"q\"\\", 4);
+    test_str_value(&strings, "\"\\a\\b\\f\\r\\t\\v\\'\"", "\a\b\f\r\t\v'", 7);
+    test_str_value(&strings, "\"\\x41\\x00\\xff\"", "A\0\xff", 3);
+    test_str_value(&strings, "\"\\u00e9\\u4f60\\U0001F600z\"", "\xc3\xa9\xe4\xbd\xa0\xf0\x9f\x98\x80z", 10);
+    test_str_value(&strings, "\"a long run of text before an escape\\n and after it\"",
+                   "a long run of text before an escape\n and after it", 49);
+    free_arena(&strings);
+
+    // Without an arena, strings are not decoded.
+    LexerState s = {0};
+    init_lexer_state(&s, "\"a\\nb\"");
+    assert(next_token(&s) == TOKEN_STR_LITERAL);
+    assert(s.token.value.str.text == NULL);
+}
+
+// test_intern checks that equal names get the same symbol, and that the
+// lexer interns identifiers and literals but not keywords.
+static void test_intern() {
+    InternPool pool;
+    init_intern_pool(&pool);
+    Symbol foo = intern(&pool, "foo", 3);
+    assert(foo != SYMBOL_NONE);
+    assert(intern(&pool, "foo", 3) == foo);
+    assert(intern(&pool, "fo", 2) != foo);
+    assert(intern(&pool, "foobar", 3) == foo);
+    assert(symbol_name(&pool, foo)->len == 3);
+    assert(strcmp(symbol_name(&pool, foo)->text, "foo") == 0);
+
+    // Enough names to grow the table a few times.
+    char name[16];
+    for (int i = 0; i < 10000; i++) {
+        sprintf(name, "name%d", i);
+        Symbol sym = intern(&pool, name, strlen(name));
+        assert(sym == (Symbol)(i + 3));
+        assert(strcmp(symbol_name(&pool, sym)->text, name) == 0);
+    }
+    for (int i = 0; i < 10000; i += 7) {
+        sprintf(name, "name%d", i);
+        assert(intern(&pool, name, strlen(name)) == (Symbol)(i + 3));
+    }
+    assert(pool.len == 10002);
+    free_intern_pool(&pool);
+
+    init_intern_pool(&pool);
+    LexerState s = {0};
+    TokenBuf tokens;
+    init_token_buf(&tokens);
+    init_lexer_state(&s, "foo bar foo if 42 42 \"foo\" \"foo\" 'c' 1.5 foo_");
+    s.intern = &pool;
+    assert(lex_all(&s, &tokens) == TOKEN_EOF);
+    assert(tokens.len == 12);
+    assert(tokens.buf[0].sym == intern(&pool, "foo", 3));
+    assert(tokens.buf[1].sym != tokens.buf[0].sym);
+    assert(tokens.buf[2].sym == tokens.buf[0].sym);
+    assert(tokens.buf[3].kind == TOKEN_IF && tokens.buf[3].sym == SYMBOL_NONE);
+    assert(tokens.buf[4].sym == tokens.buf[5].sym);
+    assert(tokens.buf[4].sym == intern(&pool, "42", 2));
+    assert(tokens.buf[6].sym == tokens.buf[7].sym);
+    assert(tokens.buf[6].sym == intern(&pool, "\"foo\"", 5));
+    assert(tokens.buf[8].sym == intern(&pool, "'c'", 3));
+    assert(tokens.buf[9].sym == intern(&pool, "1.5", 3));
+    assert(tokens.buf[10].sym == intern(&pool, "foo_", 4));
+    assert(tokens.buf[11].kind == TOKEN_EOF && tokens.buf[11].sym == SYMBOL_NONE);
+    assert(pool.len == 7);
+    free_token_buf(&tokens);
+    free_intern_pool(&pool);
+}
+
+// test_source_file writes `len` bytes to a temporary file and checks that
+// the loaded source has the same text followed by a '\0' sentinel.
+static void test_source_file(const char* text, size_t len, TokenKind last) {
+    char path[] = "/tmp/lexer_test_XXXXXX";
+    int fd = mkstemp(path);
+    assert(fd >= 0);
+    assert(write(fd, text, len) == (ssize_t)len);
+    close(fd);
+
+    Source src;
+    assert(open_source(&src, path) == 0);
+    assert(src.len == len);
+    assert(memcmp(src.text, text, len) == 0);
+    assert(src.text[len] == '\0');
+
+    LexerState s = {0};
+    TokenBuf tokens;
+    init_token_buf(&tokens);
+    init_lexer_state(&s, src.text);
+    assert(lex_all(&s, &tokens) == TOKEN_EOF);
+    assert(tokens.len >= 1);
+    if (tokens.len > 1) {
+        assert(tokens.buf[tokens.len - 2].kind == last);
+    }
+    free_token_buf(&tokens);
+    free_lexer_state(&s);
+    close_source(&src);
+    unlink(path);
+
+    assert(open_source(&src, path) != 0);
+}
+
+static void test_source() {
+    test_source_file("", 0, TOKEN_EOF);
+    test_source_file("const x = 42\n", 13, TOKEN_INT_LITERAL);
+
+    // A file filling whole pages still gets its sentinel.
+    size_t len = (size_t)sysconf(_SC_PAGESIZE) * 2;
+    char* text = malloc(len);
+    memset(text, ' ', len);
+    memcpy(text + len - 5, "x + y", 5);
+    test_source_file(text, len, TOKEN_IDENTIFIER);
+    free(text);
+}
+
+// test_slice_at_guard_page lexes inputs that end right before an
+// inaccessible page, which must not be touched.
+static void test_slice_at_guard_page() {
+    static const char* inputs[] = {
+        "foo", "42", "0x1F", "1.5e3", "\"abc", "\"abc\"", "'a", "'\\u00", "# comment",
+        "x   ", "a\n\n\n", ">>=", ".", "\xe4\xbd", "\"\\", "\"\\U0000",
+    };
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    char* pages = mmap(NULL, page * 2, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    assert(pages != MAP_FAILED);
+    assert(mprotect(pages + page, page, PROT_NONE) == 0);
+    for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); i++) {
+        size_t len = strlen(inputs[i]);
+        char* text = pages + page - len;
+        memcpy(text, inputs[i], len);
+        for (ScanLevel level = SCAN_SCALAR; level <= SCAN_AVX2; level++) {
+            if (set_scan_level(level) != level) {
+                continue;
+            }
+            LexerState s = {0};
+            init_lexer_slice(&s, text, len);
+            TokenKind kind;
+            do {
+                kind = next_token(&s);
+            } while (kind != TOKEN_EOF && kind != TOKEN_ERROR);
+            assert(s.current <= s.end);
+        }
+    }
+    set_scan_level(SCAN_AVX2);
+    munmap(pages, page * 2);
+}
+
+// test_scan_levels checks that every scanner level produces the same
+// tokens as the scalar one on blank and comment heavy inputs.
+static void test_scan_levels() {
+    static const char* pieces[] = {
+        " ", "\t", "\r", "\n", "    ", "\n\n\t\t", "# comment\n", "#\n",
+        "x", "42", "\"str\"", "(", "==", "                                  ",
+        "\"a \\n string \\\" that is longer than one vector block\"",
+    };
+    char source[4096 + 64];
+    unsigned seed = 42;
+    for (int round = 0; round < 64; round++) {
+        // Vary the alignment of the source.
+        char* p = source + round % 32;
+        char* end = p;
+        while (end - p < 4000) {
+            seed = seed * 1103515245 + 12345;
+            const char* piece = pieces[(seed >> 16) % (sizeof(pieces) / sizeof(pieces[0]))];
+            size_t len = strlen(piece);
+            memcpy(end, piece, len);
+            end += len;
+        }
+        if (round % 2) {
+            memcpy(end, "# trailing", 10);
+            end += 10;
+        }
+        *end = '\0';
+
+        TokenBuf expected, actual;
+        init_token_buf(&expected);
+        LexerState s = {0};
+        set_scan_level(SCAN_SCALAR);
+        init_lexer_state(&s, p);
+        assert(lex_all(&s, &expected) == TOKEN_EOF);
+        for (ScanLevel level = SCAN_SSE2; level <= SCAN_AVX2; level++) {
+            if (set_scan_level(level) != level) {
+                continue;
+            }
+            init_token_buf(&actual);
+            init_lexer_state(&s, p);
+            assert(lex_all(&s, &actual) == TOKEN_EOF);
+            assert(actual.len == expected.len);
+            for (size_t i = 0; i < expected.len; i++) {
+                const Token* e = &expected.buf[i];
+                LEXER_TEST_TOKEN(actual, i, e->kind, e->start, e->len, e->line, e->col);
+            }
+            free_token_buf(&actual);
+        }
+        free_token_buf(&expected);
+    }
+    set_scan_level(SCAN_AVX2);
+}
+
+// same_value returns whether two tokens of the same kind have the same
+// literal value.
+static bool same_value(const Token* a, const Token* b) {
+    switch (a->kind) {
+        case TOKEN_STR_LITERAL:
+            return a->value.str.len == b->value.str.len &&
+                   memcmp(a->value.str.text, b->value.str.text, a->value.str.len) == 0;
+        case TOKEN_CHAR_LITERAL:
+        case TOKEN_INT_LITERAL:
+        case TOKEN_FLOAT_LITERAL:
+            return a->value.i == b->value.i;
+        default:
+            return true;
+    }
+}
+
+// test_stream_chunks lexes the source through a stream lexer fed `chunk`
+// bytes at a time, and checks that it returns the tokens of `lex_all()`.
+static void test_stream_chunks(const char* source, size_t chunk) {
+    size_t len = strlen(source);
+    TokenBuf expected;
+    init_token_buf(&expected);
+    InternPool expected_pool, pool;
+    init_intern_pool(&expected_pool);
+    init_intern_pool(&pool);
+    Arena expected_strings, strings;
+    init_arena(&expected_strings);
+    init_arena(&strings);
+    LexerState s = {0};
+    init_lexer_state(&s, source);
+    s.intern = &expected_pool;
+    s.strings = &expected_strings;
+    lex_all(&s, &expected);
+
+    StreamLexer stream;
+    init_stream_lexer(&stream);
+    stream.state.intern = &pool;
+    stream.state.strings = &strings;
+    char* buf = NULL;
+    size_t fed = 0, i = 0;
+    while (true) {
+        TokenKind kind = next_stream_token(&stream);
+        if (kind == TOKEN_NEED_INPUT) {
+            // Each chunk is a separate allocation, freed once consumed.
+            assert(fed < len || len == 0);
+            free(buf);
+            size_t n = len - fed < chunk ? len - fed : chunk;
+            buf = malloc(n + 1);
+            memcpy(buf, source + fed, n);
+            feed_stream_lexer(&stream, buf, n);
+            fed += n;
+            if (fed == len) {
+                finish_stream_lexer(&stream);
+            }
+            continue;
+        }
+        assert(i < expected.len);
+        const Token* e = &expected.buf[i++];
+        assert(stream.token.kind == e->kind);
+        assert(stream.token.start == e->start);
+        assert(stream.token.len == e->len);
+        assert(memcmp(stream.text, source + e->start, e->len) == 0);
+        assert(stream.token.sym == e->sym);
+        assert(same_value(&stream.token, e));
+        if (kind == TOKEN_ERROR) {
+            assert(stream.state.error == s.error);
+        }
+        if (kind == TOKEN_EOF || kind == TOKEN_ERROR) {
+            break;
+        }
+    }
+    assert(i == expected.len);
+    free(buf);
+    free_stream_lexer(&stream);
+    free_token_buf(&expected);
+    free_intern_pool(&expected_pool);
+    free_intern_pool(&pool);
+    free_arena(&expected_strings);
+    free_arena(&strings);
+}
+
+// test_stream checks that tokens straddling chunks are carried over.
+static void test_stream() {
+    static const char* sources[] = {
+        "",
+        "   ",
+        "# only a comment",
+        "const x = 42\n",
+        "def main() {\n    # a comment that spans chunks\n    var s = \"hello, \\\"world\\\"\"\n"
+        "    x >>= 0x1f + 1.5e-3 ** 0b1010 .. y...z\n    c = '\xe4\xbd\xa0' + '\\u00e4'\n}\n",
+        "\"a long string that is longer than the carry grows at once, which takes "
+        "a few rounds to complete when it is fed one byte at a time\" end",
+        "x = \"unterminated",
+        "y = 'ab'",
+        "z = 0x",
+        "w = '\xe4\xbd",
+    };
+    static const size_t chunks[] = { 1, 2, 3, 5, 16, 100, 4096 };
+    for (size_t i = 0; i < sizeof(sources) / sizeof(sources[0]); i++) {
+        for (size_t j = 0; j < sizeof(chunks) / sizeof(chunks[0]); j++) {
+            test_stream_chunks(sources[i], chunks[j]);
+        }
+    }
+}
+
+// count_batch_tokens records the number of tokens of every visited file.
+static void count_batch_tokens(void* ctx, size_t index, const Source* src, const TokenBuf* tokens) {
+    size_t* counts = ctx;
+    assert(tokens->len > 0 && tokens->buf[tokens->len - 1].start <= src->len);
+    counts[index] += tokens->len;
+}
+
+// test_cache_source saves the tokens of the source and checks that the
+// tokens loaded back are the same.
+static void test_cache_source(const char* path, const char* source) {
+    InternPool pool;
+    init_intern_pool(&pool);
+    LexerState s = {0};
+    TokenBuf expected, actual;
+    init_token_buf(&expected);
+    init_token_buf(&actual);
+    init_lexer_state(&s, source);
+    s.intern = &pool;
+    lex_all(&s, &expected);
+    assert(save_tokens(path, &s, &expected) == 0);
+
+    // Loaded with a pool of its own, which numbers the names differently.
+    InternPool loaded;
+    init_intern_pool(&loaded);
+    intern(&loaded, "padding", 7);
+    TokenCache cache;
+    assert(open_token_cache(&cache, path, &loaded) == 0);
+    assert(is_cache_fresh(&cache, source, strlen(source)));
+    assert(cache.error == s.error);
+    assert(load_tokens(&cache, &actual) == 0);
+    assert(actual.len == expected.len);
+    for (size_t i = 0; i < expected.len; i++) {
+        const Token* e = &expected.buf[i];
+        const Token* t = &actual.buf[i];
+        LEXER_TEST_TOKEN(actual, i, e->kind, e->start, e->len, 0, 0);
+        assert((t->sym == SYMBOL_NONE) == (e->sym == SYMBOL_NONE));
+        if (t->sym != SYMBOL_NONE) {
+            const InternName* name = symbol_name(&loaded, t->sym);
+            assert(name->len == e->len && memcmp(name->text, source + e->start, e->len) == 0);
+        }
+        if (t->kind != TOKEN_STR_LITERAL) {
+            assert(same_value(t, e));
+        }
+    }
+    close_token_cache(&cache);
+
+    free_token_buf(&expected);
+    free_token_buf(&actual);
+    free_intern_pool(&pool);
+    free_intern_pool(&loaded);
+}
+
+static void test_cache() {
+    char path[] = "/tmp/lexer_test_XXXXXX";
+    int fd = mkstemp(path);
+    assert(fd >= 0);
+    close(fd);
+
+    test_cache_source(path, "");
+    test_cache_source(path, "def f(a, b) {\n    return a ** b # power\n}\n");
+    test_cache_source(path, "x = 'ab'");
+    test_cache_source(path, "var s = \"unterminated\n");
+    test_cache_source(path, "x = [1, 0xffff_ffff_ffff_ffff, 2.5e-300, '\xe4\xbd\xa0', \"s\\n\", 'c', x, y, x]\n"
+                            "# comment\n\n\n        far = 1e308\n");
+    static const char* lines[] = {
+        "def f(a, b) {\n", "    return a ** b # power\n", "}\n", "\n", "# comment\n",
+        "var s = \"str \\\" # not a comment\"\n", "x = y >>= 0x1f + 1.5e3 - 'c'\n", "name_%u = %u\n",
+    };
+    char* text = malloc((64 << 10) + 64);
+    size_t len = 0;
+    unsigned seed = 18;
+    while (len < 64 << 10) {
+        seed = seed * 1103515245 + 12345;
+        len += sprintf(text + len, lines[(seed >> 16) % (sizeof(lines) / sizeof(lines[0]))], seed % 512, seed);
+    }
+    test_cache_source(path, text);
+
+    TokenCache cache;
+    InternPool pool;
+    init_intern_pool(&pool);
+    assert(open_token_cache(&cache, path, &pool) == 0);
+    assert(!is_cache_fresh(&cache, "x = 1\n", 6));
+    text[100] ^= 1;
+    assert(!is_cache_fresh(&cache, text, strlen(text)));
+    close_token_cache(&cache);
+
+    // Every truncation of a valid file fails cleanly.
+    Source file;
+    assert(open_source(&file, path) == 0);
+    size_t size = file.len;
+    char* bytes = malloc(size);
+    memcpy(bytes, file.text, size);
+    close_source(&file);
+    for (size_t len = 0; len < size; len += 1 + len / 16) {
+        fd = open(path, O_WRONLY | O_TRUNC);
+        assert(fd >= 0);
+        assert(write(fd, bytes, len) == (ssize_t)len);
+        close(fd);
+        int err = open_token_cache(&cache, path, &pool);
+        if (err == 0) {
+            TokenBuf tokens;
+            init_token_buf(&tokens);
+            assert(load_tokens(&cache, &tokens) == EINVAL);
+            free_token_buf(&tokens);
+            close_token_cache(&cache);
+        } else {
+            assert(err == EINVAL);
+        }
+    }
+    free(bytes);
+    free_intern_pool(&pool);
+    free(text);
+    unlink(path);
+}
+
+// test_batch checks that the results of a batch are in input order and
+// match lexing the files one by one, with any number of workers.
+static void test_batch() {
+    static const char* texts[] = {
+        "const x = 42\n",
+        "",
+        "def f(a, b) {\n    return a ** b # power\n}\n",
+        "var s = \"unterminated\n",
+        "x = 'ab'",
+    };
+    enum { NFILES = 64 };
+    char paths[NFILES][32];
+    const char* list[NFILES];
+    for (size_t i = 0; i < NFILES; i++) {
+        strcpy(paths[i], "/tmp/lexer_test_XXXXXX");
+        int fd = mkstemp(paths[i]);
+        assert(fd >= 0);
+        const char* text = texts[i % 5];
+        assert(write(fd, text, strlen(text)) == (ssize_t)strlen(text));
+        close(fd);
+        list[i] = paths[i];
+    }
+    // A file that can't be opened fails alone.
+    unlink(paths[NFILES - 1]);
+
+    int threads[] = { 1, 2, 3, 8, 0 };
+    for (size_t t = 0; t < sizeof(threads) / sizeof(threads[0]); t++) {
+        BatchResult results[NFILES];
+        size_t counts[NFILES] = {0};
+        assert(lex_batch(list, NFILES, threads[t], count_batch_tokens, counts, results) == 0);
+        for (size_t i = 0; i < NFILES - 1; i++) {
+            const char* text = texts[i % 5];
+            LexerState s = {0};
+            TokenBuf tokens;
+            init_token_buf(&tokens);
+            init_lexer_state(&s, text);
+            TokenKind kind = lex_all(&s, &tokens);
+            assert(results[i].err == 0);
+            assert(results[i].kind == kind);
+            assert(results[i].error == s.error);
+            assert(results[i].bytes == strlen(text));
+            assert(results[i].tokens == tokens.len);
+            assert(counts[i] == tokens.len);
+            if (kind == TOKEN_ERROR) {
+                locate_tokens(&s, &tokens.buf[tokens.len - 1], 1);
+                const Token* e = &tokens.buf[tokens.len - 1];
+                assert(results[i].token.start == e->start);
+                assert(results[i].token.line == e->line);
+                assert(results[i].token.col == e->col);
+            }
+            free_token_buf(&tokens);
+            free_lexer_state(&s);
+        }
+        assert(results[NFILES - 1].err == ENOENT);
+        assert(results[NFILES - 1].kind == TOKEN_ERROR);
+        assert(counts[NFILES - 1] == 0);
+    }
+    assert(lex_batch(list, 0, 4, NULL, NULL, NULL) == 0);
+    for (size_t i = 0; i < NFILES - 1; i++) {
+        unlink(paths[i]);
+    }
+}
+
+// test_split_source checks that `lex_split()` returns the tokens and the
+// lexer state of `lex_all()` with any number of chunks.
+static void test_split_source(const char* source) {
+    InternPool expected_pool;
+    init_intern_pool(&expected_pool);
+    Arena expected_strings;
+    init_arena(&expected_strings);
+    LexerState expected_state = {0};
+    TokenBuf expected;
+    init_token_buf(&expected);
+    init_lexer_state(&expected_state, source);
+    expected_state.intern = &expected_pool;
+    expected_state.strings = &expected_strings;
+    TokenKind kind = lex_all(&expected_state, &expected);
+    for (int threads = 1; threads <= 16; threads++) {
+        InternPool pool;
+        init_intern_pool(&pool);
+        Arena strings;
+        init_arena(&strings);
+        LexerState s = {0};
+        TokenBuf actual;
+        init_token_buf(&actual);
+        init_lexer_state(&s, source);
+        s.intern = &pool;
+        s.strings = &strings;
+        assert(lex_split(&s, &actual, threads) == kind);
+        assert(s.error == expected_state.error);
+        assert(s.current == expected_state.current);
+        assert(actual.len == expected.len);
+        for (size_t i = 0; i < expected.len; i++) {
+            const Token* e = &expected.buf[i];
+            LEXER_TEST_TOKEN(actual, i, e->kind, e->start, e->len, e->line, e->col);
+            assert(actual.buf[i].sym == e->sym);
+            assert(same_value(&actual.buf[i], e));
+        }
+        free_token_buf(&actual);
+        free_intern_pool(&pool);
+        free_arena(&strings);
+    }
+    free_token_buf(&expected);
+    free_intern_pool(&expected_pool);
+    free_arena(&expected_strings);
+}
+
+// test_split checks the stitching of chunks, including chunks that start
+// inside a token that spans lines.
+static void test_split() {
+    static const char* lines[] = {
+        "def f(a, b) {\n", "    return a ** b # power\n", "}\n", "\n", "# comment\n",
+        "var s = \"str \\\" # not a comment\"\n", "x = y >>= 0x1f\n", "c = '\xc3\n'\n",
+    };
+    char source[4096];
+    unsigned seed = 7;
+    for (int round = 0; round < 32; round++) {
+        size_t len = 0;
+        while (len < 2000) {
+            seed = seed * 1103515245 + 12345;
+            const char* line = lines[(seed >> 16) % (sizeof(lines) / sizeof(lines[0]))];
+            strcpy(source + len, line);
+            len += strlen(line);
+        }
+        if (round % 4 == 1) {
+            // An error in the middle ends the tokens.
+            memcpy(source + len / 2, "\"\n", 2);
+        } else if (round % 4 == 2) {
+            strcpy(source + len, "# trailing");
+        }
+        test_split_source(source);
+    }
+    test_split_source("");
+    test_split_source("x");
+    test_split_source("\n\n\n\n");
+}
+
+// check_relex applies an edit to the source in place, updates the tokens
+// with `relex_edit()`, and checks that they are those of `lex_all()`.
+// It returns the kind of the last token.
+static TokenKind check_relex(LexerState* s, RelexBuf* tokens, char* source, size_t* len, LexerEdit edit,
+                             const char* insert) {
+    memmove(source + edit.offset + edit.inserted, source + edit.offset + edit.deleted,
+            *len - edit.offset - edit.deleted);
+    memcpy(source + edit.offset, insert, edit.inserted);
+    *len = *len - edit.deleted + edit.inserted;
+
+    InternPool* pool = s->intern;
+    init_lexer_slice(s, source, *len);
+    s->intern = pool;
+    TokenKind kind = relex_edit(s, tokens, edit);
+
+    LexerState e = {0};
+    TokenBuf expected;
+    init_token_buf(&expected);
+    init_lexer_slice(&e, source, *len);
+    e.intern = pool;
+    assert(lex_all(&e, &expected) == kind);
+    assert(s->error == e.error);
+    assert(s->current == e.current);
+    assert(relex_len(tokens) == expected.len);
+    for (size_t i = 0; i < expected.len; i++) {
+        Token t = relex_token(tokens, i);
+        assert(t.kind == expected.buf[i].kind);
+        assert(t.start == expected.buf[i].start);
+        assert(t.len == expected.buf[i].len);
+        assert(t.sym == expected.buf[i].sym);
+        if (t.kind != TOKEN_STR_LITERAL) {
+            assert(same_value(&t, &expected.buf[i]));
+        }
+    }
+    free_lexer_state(&e);
+    free_token_buf(&expected);
+    return kind;
+}
+
+// test_relex applies random edits to a source, and undoes those that
+// leave an error so that most edits are made to a valid source.
+static void test_relex() {
+    static const char* lines[] = {
+        "def f(a, b) {\n", "    return a ** b # power\n", "}\n", "\n", "# comment\n",
+        "var s = \"str \\\" # not \\n a comment\"\n", "x = y >>= 0x1f + 1.5e3\n", "c = '\\n'\n",
+    };
+    static const char* inserts[] = {
+        "", "x", " ", "\n", "\"", "#", "1.5e3", "'a'", "\\n", "==", "\"s\\tr\"", "0x", "\xc3\xa9", ".",
+        "foo_bar", "\n# a comment\n",
+    };
+    char source[8192];
+    size_t len = 0;
+    unsigned seed = 17;
+    while (len < 2000) {
+        seed = seed * 1103515245 + 12345;
+        const char* line = lines[(seed >> 16) % (sizeof(lines) / sizeof(lines[0]))];
+        strcpy(source + len, line);
+        len += strlen(line);
+    }
+    InternPool pool;
+    init_intern_pool(&pool);
+    LexerState s = {0};
+    RelexBuf tokens;
+    init_relex_buf(&tokens);
+    init_lexer_slice(&s, source, len);
+    s.intern = &pool;
+    assert(relex_all(&s, &tokens) == TOKEN_EOF);
+
+    int valid = 0;
+    char deleted[32];
+    for (int round = 0; round < 4000; round++) {
+        seed = seed * 1103515245 + 12345;
+        LexerEdit edit;
+        edit.offset = (seed >> 8) % (len + 1);
+        seed = seed * 1103515245 + 12345;
+        edit.deleted = (seed >> 16) % 8 == 0 ? (seed >> 8) % 24 : (seed >> 8) % 3;
+        if (edit.deleted > len - edit.offset) {
+            edit.deleted = len - edit.offset;
+        }
+        seed = seed * 1103515245 + 12345;
+        const char* insert = inserts[(seed >> 16) % (sizeof(inserts) / sizeof(inserts[0]))];
+        edit.inserted = strlen(insert);
+        memcpy(deleted, source + edit.offset, edit.deleted);
+        if (check_relex(&s, &tokens, source, &len, edit, insert) == TOKEN_EOF) {
+            valid++;
+        } else {
+            LexerEdit undo = { edit.offset, edit.inserted, edit.deleted };
+            check_relex(&s, &tokens, source, &len, undo, deleted);
+        }
+    }
+    assert(valid > 1000);
+
+    // A string with invalid UTF-8 is an error that ends far before the edits
+    // inside it that change it, to a bad escape or to a newline.
+    static const char bad[] = "x = 1\nvar s = \"\\U0001F600\xff\xff and some padding \\U0010f000\"\ny = 2\n";
+    free_lexer_state(&s);
+    len = strlen(bad);
+    memcpy(source, bad, len + 1);
+    init_lexer_slice(&s, source, len);
+    s.intern = &pool;
+    assert(relex_all(&s, &tokens) == TOKEN_ERROR && s.error == LEXER_EUTF8CHR);
+    size_t escape = strstr(source, "f000") - source + 2;
+    check_relex(&s, &tokens, source, &len, (LexerEdit){ escape, 2, 0 }, "");
+    assert(s.error == LEXER_EUTF8UNDER8);
+    check_relex(&s, &tokens, source, &len, (LexerEdit){ escape, 0, 2 }, "00");
+    assert(s.error == LEXER_EUTF8CHR);
+    check_relex(&s, &tokens, source, &len, (LexerEdit){ strstr(source, "padding") - source, 0, 1 }, "\n");
+    assert(s.error == LEXER_EMULTILINESTR);
+    free_lexer_state(&s);
+    free_relex_buf(&tokens);
+    free_intern_pool(&pool);
+}
+
 int main(int argc, char **argv) {
 
     LEXER_TEST_PASS("", TOKEN_EOF, 0);
@@ -43,13 +1209,27 @@ int main(int argc, char **argv) {
     LEXER_TEST_PASS("0o777", TOKEN_INT_LITERAL, 5);
     LEXER_TEST_FAILED("0o7778", LEXER_EOCTCHR, 5);
     LEXER_TEST_PASS("0x000A", TOKEN_INT_LITERAL, 6);
+    LEXER_TEST_FAILED("0x", LEXER_EHEXCHR, 2);
+    LEXER_TEST_FAILED("0xg", LEXER_EHEXCHR, 2);
+    LEXER_TEST_FAILED("0o8", LEXER_EOCTCHR, 2);
+    LEXER_TEST_FAILED("1.", LEXER_EDECCHR, 2);
+    LEXER_TEST_FAILED("1e+", LEXER_EDECCHR, 3);
+    LEXER_TEST_FAILED("3E", LEXER_EDECCHR, 2);
+    LEXER_TEST_FAILED("3e+", LEXER_EDECCHR, 3);
+    LEXER_TEST_FAILED("0.e1", LEXER_EDECCHR, 2);
+    LEXER_TEST_FAILED("1.e5", LEXER_EDECCHR, 2);
     LEXER_TEST_FAILED("\"\n\"", LEXER_EMULTILINESTR, 1);
+    LEXER_TEST_FAILED("\"abc", LEXER_ESTREND, 4);
+    LEXER_TEST_PASS("\"a long string literal that spans several vector blocks, \\\"quoted\\\"\"", TOKEN_STR_LITERAL, 68);
     LEXER_TEST_PASS("\"\\n\"", TOKEN_STR_LITERAL, 4);
-    LEXER_TEST_PASS("\"\\U00a000a0\"", TOKEN_STR_LITERAL, 12);
+    LEXER_TEST_PASS("\"\\U0010ffff\"", TOKEN_STR_LITERAL, 12);
+    LEXER_TEST_FAILED("\"\\U00a000a0\"", LEXER_EESCAPE, 11);
+    LEXER_TEST_FAILED("\"\\ud800\"", LEXER_EESCAPE, 7);
     LEXER_TEST_FAILED("\"\\U000a\"", LEXER_EUTF8UNDER8, 7);
     LEXER_TEST_PASS("\"\\u00a0\"", TOKEN_STR_LITERAL, 8);
     LEXER_TEST_PASS("\"\\u00A0\"", TOKEN_STR_LITERAL, 8);
     LEXER_TEST_FAILED("\"\\u0a\"", LEXER_EUTF8UNDER4, 5);
+    LEXER_TEST_FAILED("\"\\q\"", LEXER_EESCAPE, 2);
     LEXER_TEST_PASS("\"你好世界\"", TOKEN_STR_LITERAL, 14);
     LEXER_TEST_FAILED("@", LEXER_EINVALIDCHAR, 0);
     LEXER_TEST_PASS("'a'", TOKEN_CHAR_LITERAL, 3);
@@ -57,8 +1237,52 @@ int main(int argc, char **argv) {
     LEXER_TEST_PASS("'\\n'", TOKEN_CHAR_LITERAL, 4);
     LEXER_TEST_PASS("'\\xA0'", TOKEN_CHAR_LITERAL, 6);
     LEXER_TEST_PASS("'\\u00A0'", TOKEN_CHAR_LITERAL, 8);
-    LEXER_TEST_PASS("'\\U00A000A0'", TOKEN_CHAR_LITERAL, 12);
+    LEXER_TEST_PASS("'\\U000100A0'", TOKEN_CHAR_LITERAL, 12);
+    LEXER_TEST_FAILED("'\\x'", LEXER_EESCAPE, 3);
+    LEXER_TEST_FAILED("'\\x4'", LEXER_EESCAPE, 4);
+    LEXER_TEST_FAILED("'\\q'", LEXER_EESCAPE, 2);
+    LEXER_TEST_FAILED("'\\U00A000A0'", LEXER_EESCAPE, 11);
     LEXER_TEST_FAILED("''", LEXER_EEMPTYCHR, 1);
+    LEXER_TEST_PASS("'9'", TOKEN_CHAR_LITERAL, 3);
+    LEXER_TEST_PASS("'G'", TOKEN_CHAR_LITERAL, 3);
+    LEXER_TEST_PASS("'\"'", TOKEN_CHAR_LITERAL, 3);
+    LEXER_TEST_FAILED("'\n'", LEXER_EASCIICHR, 1);
+    LEXER_TEST_FAILED("\xff", LEXER_EINVALIDCHAR, 0);
+
+    LEXER_TEST_PASS("if", TOKEN_IF, 2);
+    LEXER_TEST_PASS("iff", TOKEN_IDENTIFIER, 3);
+    LEXER_TEST_PASS("_if", TOKEN_IDENTIFIER, 3);
+    LEXER_TEST_PASS("while(", TOKEN_WHILE, 5);
+    LEXER_TEST_PASS("continue_1 ", TOKEN_IDENTIFIER, 11);
+
+    LEXER_TEST_SLICE_PASS("foo bar", 3, TOKEN_IDENTIFIER, 3);
+    LEXER_TEST_SLICE_PASS("foo bar", 4, TOKEN_IDENTIFIER, 4);
+    LEXER_TEST_SLICE_PASS("123", 2, TOKEN_INT_LITERAL, 2);
+    LEXER_TEST_SLICE_PASS("==", 1, TOKEN_EQUAL, 1);
+    LEXER_TEST_SLICE_PASS("# abc\nx", 3, TOKEN_EOF, 3);
+    LEXER_TEST_SLICE_PASS("a\0b", 3, TOKEN_IDENTIFIER, 1);
+    LEXER_TEST_SLICE_FAILED("\0b", 2, LEXER_EINVALIDCHAR, 0);
+    LEXER_TEST_SLICE_FAILED("\"abc\"", 4, LEXER_ESTREND, 4);
+    LEXER_TEST_SLICE_FAILED("0x1", 2, LEXER_EHEXCHR, 2);
+    LEXER_TEST_SLICE_FAILED("'a'", 2, LEXER_ECHREND, 2);
+    LEXER_TEST_SLICE_FAILED("'\xe4\xbd\xa0'", 3, LEXER_EUTF8CHR, 1);
+
+    test_lex_all();
+    test_recover();
+    test_positions();
+    test_source();
+    test_slice_at_guard_page();
+    test_keywords();
+    test_numbers();
+    test_utf8();
+    test_literal_values();
+    test_intern();
+    test_scan_levels();
+    test_stream();
+    test_batch();
+    test_cache();
+    test_split();
+    test_relex();
 
     printf("all tests passed!\n");
 
@@ -0,0 +1,316 @@
+#include <float.h>
+#include <math.h>
+#include <stdbool.h>
+#include <string.h>
+#include "number.h"
+#include "pow5.h"
+
+// U128 is the 128-bit product of two 64-bit words.
+typedef struct U128 {
+    uint64_t lo;
+    uint64_t hi;
+} U128;
+
+static inline U128 mul_u64(uint64_t a, uint64_t b) {
+#ifdef __SIZEOF_INT128__
+    unsigned __int128 p = (unsigned __int128)a * b;
+    return (U128){ (uint64_t)p, (uint64_t)(p >> 64) };
+#else
+    uint64_t a_lo = (uint32_t)a, a_hi = a >> 32;
+    uint64_t b_lo = (uint32_t)b, b_hi = b >> 32;
+    uint64_t lo_lo = a_lo * b_lo, hi_lo = a_hi * b_lo;
+    uint64_t lo_hi = a_lo * b_hi, hi_hi = a_hi * b_hi;
+    uint64_t cross = (lo_lo >> 32) + (uint32_t)hi_lo + lo_hi;
+    return (U128){ (cross << 32) | (uint32_t)lo_lo, (hi_lo >> 32) + (cross >> 32) + hi_hi };
+#endif
+}
+
+static inline int clz_u64(uint64_t x) {
+#ifdef __GNUC__
+    return __builtin_clzll(x);
+#else
+    int n = 0;
+    while (!(x & (1ull << 63))) {
+        x <<= 1;
+        n++;
+    }
+    return n;
+#endif
+}
+
+static inline double from_bits(uint64_t bits) {
+    double d;
+    memcpy(&d, &bits, sizeof(d));
+    return d;
+}
+
+// The exact powers of ten of Clinger's fast path.
+static const double ExactPow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+// Fields of a binary64 double.
+#define MANTISSA_BITS 52
+#define MIN_EXPONENT  -1023
+#define INF_POWER     0x7ff
+
+// eisel_lemire returns the double nearest to `w * 10^q`, for `w` != 0.
+// The product of `w` with the truncated 128-bit significand of 5^q always
+// has enough exact bits to round a 53-bit significand correctly, see
+// "Fast Number Parsing Without Fallback" by Mushtak and Lemire.
+static double eisel_lemire(uint64_t w, int64_t q) {
+    if (q < POW5_MIN_EXP) {
+        return 0.0;
+    }
+    if (q > POW5_MAX_EXP) {
+        return INFINITY;
+    }
+    int lz = clz_u64(w);
+    w <<= lz;
+
+    // 55 bits are needed: the 53 bits of the significand, a rounding bit,
+    // and a bit lost if the product has a leading zero.
+    size_t index = 2 * (size_t)(q - POW5_MIN_EXP);
+    U128 product = mul_u64(w, Pow5[index]);
+    const uint64_t precision_mask = UINT64_MAX >> (MANTISSA_BITS + 3);
+    if ((product.hi & precision_mask) == precision_mask) {
+        U128 second = mul_u64(w, Pow5[index + 1]);
+        product.lo += second.hi;
+        if (second.hi > product.lo) {
+            product.hi++;
+        }
+    }
+    int upperbit = (int)(product.hi >> 63);
+    int shift = upperbit + 64 - MANTISSA_BITS - 3;
+    uint64_t mantissa = product.hi >> shift;
+    // floor(log2(5^q)) + q + 63, for q in [-342, 308].
+    int32_t power2 = (int32_t)(((152170 + 65536) * q) >> 16) + 63 + upperbit - lz - MIN_EXPONENT;
+
+    if (power2 <= 0) {
+        // A subnormal, or zero below it.
+        if (-power2 + 1 >= 64) {
+            return 0.0;
+        }
+        mantissa >>= -power2 + 1;
+        mantissa += mantissa & 1;
+        mantissa >>= 1;
+        // Rounding up may reach the smallest normal.
+        power2 = mantissa < (1ull << MANTISSA_BITS) ? 0 : 1;
+        return from_bits(mantissa | (uint64_t)power2 << MANTISSA_BITS);
+    }
+
+    // Only 5^q that fit in 64 bits can make a product fall right between
+    // two doubles, round those halfway cases to even.
+    if (product.lo <= 1 && q >= -4 && q <= 23 && (mantissa & 3) == 1 &&
+        (mantissa << shift) == product.hi) {
+        mantissa &= ~1ull;
+    }
+    mantissa += mantissa & 1;
+    mantissa >>= 1;
+    if (mantissa >= (2ull << MANTISSA_BITS)) {
+        mantissa = 1ull << MANTISSA_BITS;
+        power2++;
+    }
+    mantissa &= ~(1ull << MANTISSA_BITS);
+    if (power2 >= INF_POWER) {
+        return INFINITY;
+    }
+    return from_bits(mantissa | (uint64_t)power2 << MANTISSA_BITS);
+}
+
+double decimal_to_double(uint64_t w, int64_t q) {
+    if (w == 0) {
+        return 0.0;
+    }
+#if FLT_EVAL_METHOD == 0
+    // Both operands are exact, so is the rounded result.
+    if (q >= -22 && q <= 22 && w <= (1ull << 53)) {
+        double d = (double)w;
+        return q < 0 ? d / ExactPow10[-q] : d * ExactPow10[q];
+    }
+#endif
+    return eisel_lemire(w, q);
+}
+
+// MAX_DIGITS is the number of significant digits `parse_double()` keeps.
+// A double halfway between two others has at most 767 of them, so the
+// digits past these only matter as a sticky nonzero digit.
+#define MAX_DIGITS 800
+
+// EXP_LIMIT bounds the exponents read by `parse_double()`, far past the
+// exponents where doubles overflow or underflow.
+#define EXP_LIMIT 100000
+
+// BIG_LIMBS bounds the 32-bit limbs of a BigInt. The operands compared by
+// `parse_double()` take fewer than 3600 bits.
+#define BIG_LIMBS 128
+
+// BigInt is an unsigned integer of little-endian 32-bit limbs.
+typedef struct BigInt {
+    uint32_t limbs[BIG_LIMBS];
+    int len;
+} BigInt;
+
+// big_mul_add sets `b` to `b * m + add`.
+static void big_mul_add(BigInt* b, uint32_t m, uint32_t add) {
+    uint64_t carry = add;
+    for (int i = 0; i < b->len; i++) {
+        uint64_t p = (uint64_t)b->limbs[i] * m + carry;
+        b->limbs[i] = (uint32_t)p;
+        carry = p >> 32;
+    }
+    if (carry != 0) {
+        b->limbs[b->len++] = (uint32_t)carry;
+    }
+}
+
+// big_mul_pow5 multiplies `b` by 5^e.
+static void big_mul_pow5(BigInt* b, int64_t e) {
+    static const uint32_t Pow5[] = {
+        1, 5, 25, 125, 625, 3125, 15625, 78125, 390625, 1953125, 9765625,
+        48828125, 244140625, 1220703125,
+    };
+    for (; e >= 13; e -= 13) {
+        big_mul_add(b, Pow5[13], 0);
+    }
+    big_mul_add(b, Pow5[e], 0);
+}
+
+// big_shl multiplies `b` by 2^s.
+static void big_shl(BigInt* b, int64_t s) {
+    if (b->len == 0) {
+        return;
+    }
+    int words = (int)(s / 32), bits = (int)(s % 32);
+    b->limbs[b->len] = 0;
+    for (int i = b->len; i >= 0; i--) {
+        uint32_t lo = i > 0 && bits > 0 ? b->limbs[i - 1] >> (32 - bits) : 0;
+        b->limbs[i + words] = b->limbs[i] << bits | lo;
+    }
+    memset(b->limbs, 0, words * sizeof(uint32_t));
+    b->len += words + 1;
+    while (b->limbs[b->len - 1] == 0) {
+        b->len--;
+    }
+}
+
+static int big_cmp(const BigInt* a, const BigInt* b) {
+    if (a->len != b->len) {
+        return a->len < b->len ? -1 : 1;
+    }
+    for (int i = a->len - 1; i >= 0; i--) {
+        if (a->limbs[i] != b->limbs[i]) {
+            return a->limbs[i] < b->limbs[i] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+double parse_double(const char* text, size_t len) {
+    // The first DECIMAL_DIGITS significant digits are `w * 10^q`, and the
+    // first MAX_DIGITS are `digits * 10^e`.
+    uint64_t w = 0;
+    int64_t q = 0;
+    int nw = 0;
+    BigInt digits = {0};
+    int64_t e = 0;
+    int n = 0;
+    bool sticky = false;
+    bool frac = false;
+    size_t i = 0;
+    for (; i < len; i++) {
+        char c = text[i];
+        if (c == '_') {
+            continue;
+        }
+        if (c == '.') {
+            frac = true;
+            continue;
+        }
+        if (c < '0' || c > '9') {
+            break;
+        }
+        unsigned digit = c - '0';
+        if (n == 0 && digit == 0) {
+            q -= frac;
+            e -= frac;
+            continue;
+        }
+        if (nw < DECIMAL_DIGITS) {
+            w = w * 10 + digit;
+            nw++;
+            q -= frac;
+        } else {
+            q += !frac;
+        }
+        if (n < MAX_DIGITS) {
+            big_mul_add(&digits, 10, digit);
+            n++;
+            e -= frac;
+        } else {
+            sticky |= digit != 0;
+            e += !frac;
+        }
+    }
+    if (sticky) {
+        big_mul_add(&digits, 10, 1);
+        e--;
+    }
+
+    // [eE] [+-]? [0-9] ('_'? [0-9])*
+    if (i < len) {
+        i++;
+        bool negative = i < len && text[i] == '-';
+        if (i < len && (text[i] == '+' || text[i] == '-')) {
+            i++;
+        }
+        int64_t exp = 0;
+        for (; i < len; i++) {
+            if (text[i] != '_' && exp < EXP_LIMIT) {
+                exp = exp * 10 + (text[i] - '0');
+            }
+        }
+        q += negative ? -exp : exp;
+        e += negative ? -exp : exp;
+    }
+
+    double lo = decimal_to_double(w, q);
+    if (n <= DECIMAL_DIGITS) {
+        return lo;
+    }
+    // The digits past `w` round the value to that of `w` or of `w + 1`,
+    // which are the same or adjacent doubles. Compare the digits with the
+    // exact halfway point between them, `(2m + 1) * 2^(p - 1)`.
+    double hi = decimal_to_double(w + 1, q);
+    if (lo == hi) {
+        return lo;
+    }
+    uint64_t bits;
+    memcpy(&bits, &lo, sizeof(bits));
+    uint64_t m = bits & ((1ull << MANTISSA_BITS) - 1);
+    int64_t p = (int64_t)(bits >> MANTISSA_BITS);
+    if (p == 0) {
+        p = 1;
+    } else {
+        m |= 1ull << MANTISSA_BITS;
+    }
+    p += MIN_EXPONENT - MANTISSA_BITS;
+    uint64_t half = 2 * m + 1;
+    BigInt halfway = { .limbs = { (uint32_t)half, (uint32_t)(half >> 32) }, .len = half >> 32 ? 2 : 1 };
+    if (e >= 0) {
+        big_mul_pow5(&digits, e);
+    } else {
+        big_mul_pow5(&halfway, -e);
+    }
+    if (e >= p - 1) {
+        big_shl(&digits, e - (p - 1));
+    } else {
+        big_shl(&halfway, p - 1 - e);
+    }
+    int cmp = big_cmp(&digits, &halfway);
+    if (cmp == 0) {
+        return m & 1 ? hi : lo;
+    }
+    return cmp < 0 ? lo : hi;
+}
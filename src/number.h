@@ -0,0 +1,33 @@
+/**
+ * number.h
+ *
+ * Number converts the decimal significands scanned by the lexer to doubles.
+ *
+ * Exact significands of up to 19 digits are converted with Clinger's fast
+ * path when both the significand and the power of ten are exact doubles,
+ * and with the Eisel-Lemire algorithm otherwise, which always rounds
+ * correctly for them. Longer significands that can't be decided from their
+ * first 19 digits are compared exactly with the halfway point between the
+ * two candidate doubles, without depending on the locale or allocating.
+ *
+ */
+
+#ifndef NUMBER_H
+#define NUMBER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// DECIMAL_DIGITS is the number of significant digits that always fit in
+// a 64-bit significand.
+#define DECIMAL_DIGITS 19
+
+// decimal_to_double returns the double nearest to `w * 10^q`.
+double decimal_to_double(uint64_t w, int64_t q);
+
+// parse_double returns the double nearest to the decimal literal of `len`
+// bytes at `text`, which may have '_' separators. It is the slow path for
+// significands of more than DECIMAL_DIGITS digits.
+double parse_double(const char* text, size_t len);
+
+#endif
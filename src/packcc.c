@@ -80,6 +80,9 @@ static size_t strnlen_(const char *str, size_t maxlen) {
 #ifndef ARRAY_MIN_SIZE
 #define ARRAY_MIN_SIZE 2
 #endif
+#ifndef INLINE_RULE_MAX_SIZE
+#define INLINE_RULE_MAX_SIZE 16 /* the maximum number of nodes of a rule to be inlined without memoization unless specified */
+#endif
 
 #define VOID_VALUE (~(size_t)0)
 
@@ -141,6 +144,12 @@ typedef enum node_type_tag {
 
 typedef struct node_tag node_t;
 
+typedef enum memo_mode_tag {
+    MEMO_MODE__AUTO = 0, /* decided by the size of the rule */
+    MEMO_MODE__ON,
+    MEMO_MODE__OFF
+} memo_mode_t;
+
 typedef struct node_array_tag {
     node_t **buf;
     size_t max;
@@ -163,6 +172,9 @@ typedef struct node_rule_tag {
     char *name;
     node_t *expr;
     int ref; /* mutable */
+    size_t index; /* the dense index of the rule, which keys its answers in the memo table of the generated parser */
+    memo_mode_t memo; /* MEMO_MODE__AUTO only until decided */
+    size_t size; /* the number of nodes with the inlined rules expanded (VOID_VALUE if not inlined) */
     node_const_array_t vars;
     node_const_array_t capts;
     node_const_array_t codes;
@@ -175,6 +187,7 @@ typedef struct node_reference_tag {
     size_t index;
     char *name;
     const node_t *rule;
+    bool_t commit; /* TRUE if the input is committed after each match */
     size_t line;
     size_t col;
 } node_reference_t;
@@ -272,6 +285,9 @@ typedef struct context_tag {
     char *vtype;  /* the type name of the data output by the parsing API function (NULL means the default) */
     char *atype;  /* the type name of the user-defined data passed to the parser creation API function (NULL means the default) */
     char *prefix; /* the prefix of the API function names (NULL means the default) */
+    char *commit; /* the name of the rule after whose matches in the start rule the input is committed (NULL means none) */
+    node_array_t memos;   /* the references to the rules from %memo directives */
+    node_array_t nomemos; /* the references to the rules from %nomemo directives */
     options_t opts;      /* the options */
     code_flag_t flags;   /* the bitwise flags to control code generation; updated during PEG parsing */
     size_t errnum;       /* the current number of PEG parsing errors */
@@ -1211,6 +1227,7 @@ static context_t *create_context(const char *iname, const char *oname, const opt
     ctx->vtype = NULL;
     ctx->atype = NULL;
     ctx->prefix = NULL;
+    ctx->commit = NULL;
     ctx->opts = *opts;
     ctx->flags = CODE_FLAG__NONE;
     ctx->errnum = 0;
@@ -1220,6 +1237,8 @@ static context_t *create_context(const char *iname, const char *oname, const opt
     ctx->bufpos = 0;
     ctx->bufcur = 0;
     char_array__init(&ctx->buffer);
+    node_array__init(&ctx->memos);
+    node_array__init(&ctx->nomemos);
     node_array__init(&ctx->rules);
     ctx->rulehash.mod = 0;
     ctx->rulehash.max = 0;
@@ -1239,6 +1258,9 @@ static node_t *create_node(node_type_t type) {
         node->data.rule.name = NULL;
         node->data.rule.expr = NULL;
         node->data.rule.ref = 0;
+        node->data.rule.index = VOID_VALUE;
+        node->data.rule.memo = MEMO_MODE__AUTO;
+        node->data.rule.size = VOID_VALUE;
         node_const_array__init(&node->data.rule.vars);
         node_const_array__init(&node->data.rule.capts);
         node_const_array__init(&node->data.rule.codes);
@@ -1250,6 +1272,7 @@ static node_t *create_node(node_type_t type) {
         node->data.reference.index = VOID_VALUE;
         node->data.reference.name = NULL;
         node->data.reference.rule = NULL;
+        node->data.reference.commit = FALSE;
         node->data.reference.line = VOID_VALUE;
         node->data.reference.col = VOID_VALUE;
         break;
@@ -1365,7 +1388,10 @@ static void destroy_context(context_t *ctx) {
     code_block_array__term(&ctx->esource);
     free((node_t **)ctx->rulehash.buf);
     node_array__term(&ctx->rules);
+    node_array__term(&ctx->nomemos);
+    node_array__term(&ctx->memos);
     char_array__term(&ctx->buffer);
+    free(ctx->commit);
     free(ctx->prefix);
     free(ctx->atype);
     free(ctx->vtype);
@@ -1658,9 +1684,10 @@ static void dump_node(context_t *ctx, const node_t *node, const int indent) {
     if (node == NULL) return;
     switch (node->type) {
     case NODE_RULE:
-        fprintf(stdout, "%*sRule(name:'%s', ref:%d, vars.len:" FMT_LU ", capts.len:" FMT_LU ", codes.len:" FMT_LU ") {\n",
+        fprintf(stdout, "%*sRule(name:'%s', ref:%d, vars.len:" FMT_LU ", capts.len:" FMT_LU ", codes.len:" FMT_LU ", memo:%s) {\n",
             indent, "", node->data.rule.name, node->data.rule.ref,
-            (ulong_t)node->data.rule.vars.len, (ulong_t)node->data.rule.capts.len, (ulong_t)node->data.rule.codes.len);
+            (ulong_t)node->data.rule.vars.len, (ulong_t)node->data.rule.capts.len, (ulong_t)node->data.rule.codes.len,
+            (node->data.rule.memo == MEMO_MODE__OFF) ? "off" : (node->data.rule.memo == MEMO_MODE__ON) ? "on" : "auto");
         dump_node(ctx, node->data.rule.expr, indent + 2);
         fprintf(stdout, "%*s}\n", indent, "");
         break;
@@ -2459,6 +2486,23 @@ static bool_t parse_directive_include_(context_t *ctx, const char *name, code_bl
     return TRUE;
 }
 
+static bool_t parse_directive_string_(context_t *ctx, const char *name, char **output, string_flag_t mode);
+
+static bool_t parse_directive_rule_(context_t *ctx, const char *name, node_array_t *output) {
+    const size_t l = ctx->linenum;
+    const size_t m = column_number(ctx);
+    char *s = NULL;
+    if (!parse_directive_string_(ctx, name, &s, STRING_FLAG__NOTEMPTY | STRING_FLAG__IDENTIFIER)) return FALSE;
+    if (s != NULL) {
+        node_t *const node = create_node(NODE_REFERENCE);
+        node->data.reference.name = s;
+        node->data.reference.line = l;
+        node->data.reference.col = m;
+        node_array__add(output, node);
+    }
+    return TRUE;
+}
+
 static bool_t parse_directive_string_(context_t *ctx, const char *name, char **output, string_flag_t mode) {
     const size_t l = ctx->linenum;
     const size_t m = column_number(ctx);
@@ -2522,6 +2566,194 @@ static bool_t parse_directive_string_(context_t *ctx, const char *name, char **o
     return TRUE;
 }
 
+static void set_memo_modes(context_t *ctx, const node_array_t *refs, memo_mode_t mode, const char *name) {
+    size_t i;
+    for (i = 0; i < refs->len; i++) {
+        const node_t *const n = refs->buf[i];
+        node_t *const r = (node_t *)lookup_rulehash(ctx, n->data.reference.name);
+        if (r == NULL) {
+            print_error("%s:" FMT_LU ":" FMT_LU ": No definition of rule '%s' in %s\n",
+                ctx->iname, (ulong_t)(n->data.reference.line + 1), (ulong_t)(n->data.reference.col + 1), n->data.reference.name, name);
+            ctx->errnum++;
+        }
+        else if (r->data.rule.memo != MEMO_MODE__AUTO && r->data.rule.memo != mode) {
+            print_error("%s:" FMT_LU ":" FMT_LU ": Rule '%s' in both %%memo and %%nomemo\n",
+                ctx->iname, (ulong_t)(n->data.reference.line + 1), (ulong_t)(n->data.reference.col + 1), n->data.reference.name);
+            ctx->errnum++;
+        }
+        else {
+            r->data.rule.memo = mode;
+        }
+    }
+}
+
+static size_t measure_inlined_size(const node_t *node) {
+    /* VOID_VALUE if the expression refers to memoized rules or has captures or actions */
+    size_t n = 1;
+    switch (node->type) {
+    case NODE_REFERENCE:
+        return node->data.reference.rule->data.rule.size;
+    case NODE_STRING:
+    case NODE_CHARCLASS:
+        break;
+    case NODE_QUANTITY:
+        n = measure_inlined_size(node->data.quantity.expr);
+        if (n == VOID_VALUE) return VOID_VALUE;
+        n++;
+        break;
+    case NODE_PREDICATE:
+        n = measure_inlined_size(node->data.predicate.expr);
+        if (n == VOID_VALUE) return VOID_VALUE;
+        n++;
+        break;
+    case NODE_SEQUENCE:
+    case NODE_ALTERNATE:
+        {
+            const node_array_t *const a = (node->type == NODE_SEQUENCE) ? &node->data.sequence.nodes : &node->data.alternate.nodes;
+            size_t i;
+            for (i = 0; i < a->len; i++) {
+                const size_t m = measure_inlined_size(a->buf[i]);
+                if (m == VOID_VALUE) return VOID_VALUE;
+                n += m;
+            }
+        }
+        break;
+    default:
+        return VOID_VALUE;
+    }
+    return n;
+}
+
+static void decide_memoization(context_t *ctx) {
+    /* a rule is measured only after all the rules it refers to, so recursive rules are never inlined */
+    bool_t b = TRUE;
+    size_t i;
+    while (b) {
+        b = FALSE;
+        for (i = 0; i < ctx->rules.len; i++) {
+            node_rule_t *const r = &ctx->rules.buf[i]->data.rule;
+            size_t n;
+            if (r->size != VOID_VALUE || r->memo == MEMO_MODE__ON) continue;
+            if (r->vars.len > 0 || r->capts.len > 0 || r->codes.len > 0) continue;
+            n = measure_inlined_size(r->expr);
+            if (n == VOID_VALUE || n > INLINE_RULE_MAX_SIZE) continue;
+            r->size = n;
+            r->memo = MEMO_MODE__OFF;
+            b = TRUE;
+        }
+    }
+    for (i = 0; i < ctx->rules.len; i++) {
+        node_rule_t *const r = &ctx->rules.buf[i]->data.rule;
+        if (r->memo == MEMO_MODE__AUTO) r->memo = MEMO_MODE__ON;
+    }
+}
+
+static bool_t may_match_empty(const node_t *node) {
+    /* TRUE for all references, not to analyze the rules */
+    switch (node->type) {
+    case NODE_STRING:
+        return (node->data.string.value == NULL || node->data.string.value[0] == '\0') ? TRUE : FALSE;
+    case NODE_CHARCLASS:
+        return FALSE;
+    case NODE_QUANTITY:
+        return (node->data.quantity.min <= 0 || may_match_empty(node->data.quantity.expr)) ? TRUE : FALSE;
+    case NODE_SEQUENCE:
+        {
+            size_t i;
+            for (i = 0; i < node->data.sequence.nodes.len; i++) {
+                if (!may_match_empty(node->data.sequence.nodes.buf[i])) return FALSE;
+            }
+        }
+        return TRUE;
+    case NODE_ALTERNATE:
+        {
+            size_t i;
+            for (i = 0; i < node->data.alternate.nodes.len; i++) {
+                if (may_match_empty(node->data.alternate.nodes.buf[i])) return TRUE;
+            }
+        }
+        return FALSE;
+    case NODE_CAPTURE:
+        return may_match_empty(node->data.capture.expr);
+    case NODE_ERROR:
+        return may_match_empty(node->data.error.expr);
+    default:
+        return TRUE;
+    }
+}
+
+static bool_t refers_leftmost_to_rule(const node_t *node, const node_t *rule, node_const_array_t *rules) {
+    /* rules: the rules already visited */
+    switch (node->type) {
+    case NODE_REFERENCE:
+        {
+            const node_t *const r = node->data.reference.rule;
+            size_t i;
+            if (r == rule) return TRUE;
+            for (i = 0; i < rules->len; i++) {
+                if (rules->buf[i] == r) return FALSE;
+            }
+            node_const_array__add(rules, r);
+            return refers_leftmost_to_rule(r->data.rule.expr, rule, rules);
+        }
+    case NODE_QUANTITY:
+        return refers_leftmost_to_rule(node->data.quantity.expr, rule, rules);
+    case NODE_PREDICATE:
+        return refers_leftmost_to_rule(node->data.predicate.expr, rule, rules);
+    case NODE_SEQUENCE:
+        {
+            size_t i;
+            for (i = 0; i < node->data.sequence.nodes.len; i++) {
+                if (refers_leftmost_to_rule(node->data.sequence.nodes.buf[i], rule, rules)) return TRUE;
+                if (!may_match_empty(node->data.sequence.nodes.buf[i])) break;
+            }
+        }
+        return FALSE;
+    case NODE_ALTERNATE:
+        {
+            size_t i;
+            for (i = 0; i < node->data.alternate.nodes.len; i++) {
+                if (refers_leftmost_to_rule(node->data.alternate.nodes.buf[i], rule, rules)) return TRUE;
+            }
+        }
+        return FALSE;
+    case NODE_CAPTURE:
+        return refers_leftmost_to_rule(node->data.capture.expr, rule, rules);
+    case NODE_ERROR:
+        return refers_leftmost_to_rule(node->data.error.expr, rule, rules);
+    default:
+        return FALSE;
+    }
+}
+
+static size_t mark_commit_references(context_t *ctx, node_t *node) {
+    /* only the references the start rule can never backtrack over, which are those in sequences or repeated alone */
+    size_t n = 0;
+    if (node == NULL) return 0;
+    switch (node->type) {
+    case NODE_REFERENCE:
+        if (strcmp(node->data.reference.name, ctx->commit) == 0) {
+            node->data.reference.commit = TRUE;
+            n = 1;
+        }
+        break;
+    case NODE_QUANTITY:
+        if (node->data.quantity.expr->type == NODE_REFERENCE) n = mark_commit_references(ctx, node->data.quantity.expr);
+        break;
+    case NODE_SEQUENCE:
+        {
+            size_t i;
+            for (i = 0; i < node->data.sequence.nodes.len; i++) {
+                n += mark_commit_references(ctx, node->data.sequence.nodes.buf[i]);
+            }
+        }
+        break;
+    default:
+        break;
+    }
+    return n;
+}
+
 static bool_t parse(context_t *ctx) {
     {
         bool_t b = TRUE;
@@ -2542,7 +2774,10 @@ static bool_t parse(context_t *ctx) {
                 parse_directive_include_(ctx, "%common", &ctx->source, &ctx->header) ||
                 parse_directive_string_(ctx, "%value", &ctx->vtype, STRING_FLAG__NOTEMPTY | STRING_FLAG__NOTVOID) ||
                 parse_directive_string_(ctx, "%auxil", &ctx->atype, STRING_FLAG__NOTEMPTY | STRING_FLAG__NOTVOID) ||
-                parse_directive_string_(ctx, "%prefix", &ctx->prefix, STRING_FLAG__NOTEMPTY | STRING_FLAG__IDENTIFIER)
+                parse_directive_string_(ctx, "%prefix", &ctx->prefix, STRING_FLAG__NOTEMPTY | STRING_FLAG__IDENTIFIER) ||
+                parse_directive_string_(ctx, "%commit", &ctx->commit, STRING_FLAG__NOTEMPTY | STRING_FLAG__IDENTIFIER) ||
+                parse_directive_rule_(ctx, "%memo", &ctx->memos) ||
+                parse_directive_rule_(ctx, "%nomemo", &ctx->nomemos)
             ) {
                 b = TRUE;
             }
@@ -2578,6 +2813,7 @@ static bool_t parse(context_t *ctx) {
         size_t i;
         make_rulehash(ctx);
         for (i = 0; i < ctx->rules.len; i++) {
+            ctx->rules.buf[i]->data.rule.index = i;
             link_references(ctx, ctx->rules.buf[i]->data.rule.expr);
         }
         for (i = 1; i < ctx->rules.len; i++) {
@@ -2604,6 +2840,46 @@ static bool_t parse(context_t *ctx) {
             verify_captures(ctx, ctx->rules.buf[i]->data.rule.expr, NULL);
         }
     }
+    if (ctx->commit != NULL && ctx->rules.len > 0) {
+        const node_t *const r = ctx->rules.buf[0];
+        if (lookup_rulehash(ctx, ctx->commit) == NULL) {
+            print_error("%s: No definition of rule '%s' in %%commit\n", ctx->iname, ctx->commit);
+            ctx->errnum++;
+        }
+        else if (r->data.rule.ref > 0) {
+            print_error("%s:" FMT_LU ":" FMT_LU ": Start rule '%s' referenced by rules not allowed with %%commit\n",
+                ctx->iname, (ulong_t)(r->data.rule.line + 1), (ulong_t)(r->data.rule.col + 1), r->data.rule.name);
+            ctx->errnum++;
+        }
+        else if (r->data.rule.codes.len > 0) {
+            print_error("%s:" FMT_LU ":" FMT_LU ": Start rule '%s' with actions or error handlers not allowed with %%commit\n",
+                ctx->iname, (ulong_t)(r->data.rule.line + 1), (ulong_t)(r->data.rule.col + 1), r->data.rule.name);
+            ctx->errnum++;
+        }
+        else if (mark_commit_references(ctx, r->data.rule.expr) == 0) {
+            print_error("%s: Rule '%s' in %%commit not referenced by the start rule outside of alternatives, predicates and captures\n",
+                ctx->iname, ctx->commit);
+            ctx->errnum++;
+        }
+    }
+    set_memo_modes(ctx, &ctx->memos, MEMO_MODE__ON, "%memo");
+    set_memo_modes(ctx, &ctx->nomemos, MEMO_MODE__OFF, "%nomemo");
+    if (ctx->errnum == 0) {
+        size_t i;
+        decide_memoization(ctx);
+        for (i = 0; i < ctx->rules.len; i++) {
+            const node_t *const r = ctx->rules.buf[i];
+            node_const_array_t a;
+            if (r->data.rule.memo != MEMO_MODE__OFF || r->data.rule.size != VOID_VALUE) continue;
+            node_const_array__init(&a);
+            if (refers_leftmost_to_rule(r->data.rule.expr, r, &a)) {
+                print_error("%s:" FMT_LU ":" FMT_LU ": Left-recursive rule '%s' not allowed with %%nomemo\n",
+                    ctx->iname, (ulong_t)(r->data.rule.line + 1), (ulong_t)(r->data.rule.col + 1), r->data.rule.name);
+                ctx->errnum++;
+            }
+            node_const_array__term(&a);
+        }
+    }
     if (ctx->opts.debug) {
         size_t i;
         for (i = 0; i < ctx->rules.len; i++) {
@@ -2626,10 +2902,10 @@ static code_reach_t generate_matching_string_code(generate_t *gen, const char *v
             stream__printf(gen->stream, "pcc_refill_buffer(ctx, " FMT_LU ") < " FMT_LU " ||\n", (ulong_t)n, (ulong_t)n);
             for (i = 0; i < n - 1; i++) {
                 stream__write_characters(gen->stream, ' ', indent + 4);
-                stream__printf(gen->stream, "(ctx->buffer.buf + ctx->cur)[" FMT_LU "] != '%s' ||\n", (ulong_t)i, escape_character(value[i], &s));
+                stream__printf(gen->stream, "pcc_char_array__at(&ctx->buffer, ctx->cur)[" FMT_LU "] != '%s' ||\n", (ulong_t)i, escape_character(value[i], &s));
             }
             stream__write_characters(gen->stream, ' ', indent + 4);
-            stream__printf(gen->stream, "(ctx->buffer.buf + ctx->cur)[" FMT_LU "] != '%s'\n", (ulong_t)i, escape_character(value[i], &s));
+            stream__printf(gen->stream, "pcc_char_array__at(&ctx->buffer, ctx->cur)[" FMT_LU "] != '%s'\n", (ulong_t)i, escape_character(value[i], &s));
             stream__write_characters(gen->stream, ' ', indent);
             stream__printf(gen->stream, ") goto L%04d;\n", onfail);
             stream__write_characters(gen->stream, ' ', indent);
@@ -2642,7 +2918,7 @@ static code_reach_t generate_matching_string_code(generate_t *gen, const char *v
             stream__write_characters(gen->stream, ' ', indent + 4);
             stream__puts(gen->stream, "pcc_refill_buffer(ctx, 1) < 1 ||\n");
             stream__write_characters(gen->stream, ' ', indent + 4);
-            stream__printf(gen->stream, "ctx->buffer.buf[ctx->cur] != '%s'\n", escape_character(value[0], &s));
+            stream__printf(gen->stream, "*pcc_char_array__at(&ctx->buffer, ctx->cur) != '%s'\n", escape_character(value[0], &s));
             stream__write_characters(gen->stream, ' ', indent);
             stream__printf(gen->stream, ") goto L%04d;\n", onfail);
             stream__write_characters(gen->stream, ' ', indent);
@@ -2671,7 +2947,7 @@ static code_reach_t generate_matching_charclass_code(generate_t *gen, const char
                     stream__write_characters(gen->stream, ' ', indent + 4);
                     stream__puts(gen->stream, "pcc_refill_buffer(ctx, 1) < 1 ||\n");
                     stream__write_characters(gen->stream, ' ', indent + 4);
-                    stream__printf(gen->stream, "ctx->buffer.buf[ctx->cur] == '%s'\n", escape_character(value[i], &s));
+                    stream__printf(gen->stream, "*pcc_char_array__at(&ctx->buffer, ctx->cur) == '%s'\n", escape_character(value[i], &s));
                     stream__write_characters(gen->stream, ' ', indent);
                     stream__printf(gen->stream, ") goto L%04d;\n", onfail);
                     stream__write_characters(gen->stream, ' ', indent);
@@ -2689,7 +2965,7 @@ static code_reach_t generate_matching_charclass_code(generate_t *gen, const char
                     stream__write_characters(gen->stream, ' ', indent);
                     stream__printf(gen->stream, "if (pcc_refill_buffer(ctx, 1) < 1) goto L%04d;\n", onfail);
                     stream__write_characters(gen->stream, ' ', indent);
-                    stream__puts(gen->stream, "c = ctx->buffer.buf[ctx->cur];\n");
+                    stream__puts(gen->stream, "c = *pcc_char_array__at(&ctx->buffer, ctx->cur);\n");
                     if (i + 3 == n && value[i] != '\\' && value[i + 1] == '-') {
                         stream__write_characters(gen->stream, ' ', indent);
                         stream__printf(gen->stream,
@@ -2732,7 +3008,7 @@ static code_reach_t generate_matching_charclass_code(generate_t *gen, const char
                 stream__write_characters(gen->stream, ' ', indent + 4);
                 stream__puts(gen->stream, "pcc_refill_buffer(ctx, 1) < 1 ||\n");
                 stream__write_characters(gen->stream, ' ', indent + 4);
-                stream__printf(gen->stream, "ctx->buffer.buf[ctx->cur] != '%s'\n", escape_character(value[0], &s));
+                stream__printf(gen->stream, "*pcc_char_array__at(&ctx->buffer, ctx->cur) != '%s'\n", escape_character(value[0], &s));
                 stream__write_characters(gen->stream, ' ', indent);
                 stream__printf(gen->stream, ") goto L%04d;\n", onfail);
                 stream__write_characters(gen->stream, ' ', indent);
@@ -2861,7 +3137,7 @@ static code_reach_t generate_quantifying_code(generate_t *gen, const node_t *exp
                 stream__write_characters(gen->stream, ' ', indent + 4);
                 stream__puts(gen->stream, "ctx->cur = p;\n");
                 stream__write_characters(gen->stream, ' ', indent + 4);
-                stream__puts(gen->stream, "pcc_thunk_array__revert(ctx->auxil, &chunk->thunks, n);\n");
+                stream__puts(gen->stream, "pcc_thunk_array__revert(ctx, &chunk->thunks, n);\n");
                 stream__write_characters(gen->stream, ' ', indent + 4);
                 stream__puts(gen->stream, "break;\n");
             }
@@ -2874,7 +3150,7 @@ static code_reach_t generate_quantifying_code(generate_t *gen, const node_t *exp
             stream__write_characters(gen->stream, ' ', indent + 4);
             stream__puts(gen->stream, "ctx->cur = p0;\n");
             stream__write_characters(gen->stream, ' ', indent + 4);
-            stream__puts(gen->stream, "pcc_thunk_array__revert(ctx->auxil, &chunk->thunks, n0);\n");
+            stream__puts(gen->stream, "pcc_thunk_array__revert(ctx, &chunk->thunks, n0);\n");
             stream__write_characters(gen->stream, ' ', indent + 4);
             stream__printf(gen->stream, "goto L%04d;\n", onfail);
             stream__write_characters(gen->stream, ' ', indent);
@@ -2912,7 +3188,7 @@ static code_reach_t generate_quantifying_code(generate_t *gen, const node_t *exp
                     stream__write_characters(gen->stream, ' ', indent);
                     stream__puts(gen->stream, "ctx->cur = p;\n");
                     stream__write_characters(gen->stream, ' ', indent);
-                    stream__puts(gen->stream, "pcc_thunk_array__revert(ctx->auxil, &chunk->thunks, n);\n");
+                    stream__puts(gen->stream, "pcc_thunk_array__revert(ctx, &chunk->thunks, n);\n");
                     if (indent > 4) stream__write_characters(gen->stream, ' ', indent - 4);
                     stream__printf(gen->stream, "L%04d:;\n", m);
                 }
@@ -3058,7 +3334,7 @@ static code_reach_t generate_alternative_code(generate_t *gen, const node_array_
         stream__write_characters(gen->stream, ' ', indent);
         stream__puts(gen->stream, "ctx->cur = p;\n");
         stream__write_characters(gen->stream, ' ', indent);
-        stream__puts(gen->stream, "pcc_thunk_array__revert(ctx->auxil, &chunk->thunks, n);\n");
+        stream__puts(gen->stream, "pcc_thunk_array__revert(ctx, &chunk->thunks, n);\n");
         if (!c) {
             stream__write_characters(gen->stream, ' ', indent);
             stream__printf(gen->stream, "goto L%04d;\n", onfail);
@@ -3116,9 +3392,9 @@ static code_reach_t generate_expanding_code(generate_t *gen, size_t index, int o
     stream__write_characters(gen->stream, ' ', indent);
     stream__puts(gen->stream, "if (n > 0) {\n");
     stream__write_characters(gen->stream, ' ', indent + 4);
-    stream__puts(gen->stream, "const char *const p = ctx->buffer.buf + ctx->cur;\n");
+    stream__puts(gen->stream, "const char *const p = pcc_char_array__at(&ctx->buffer, ctx->cur);\n");
     stream__write_characters(gen->stream, ' ', indent + 4);
-    stream__printf(gen->stream, "const char *const q = ctx->buffer.buf + chunk->capts.buf[" FMT_LU "].range.start;\n", (ulong_t)index);
+    stream__printf(gen->stream, "const char *const q = pcc_char_array__at(&ctx->buffer, chunk->capts.buf[" FMT_LU "].range.start);\n", (ulong_t)index);
     stream__write_characters(gen->stream, ' ', indent + 4);
     stream__puts(gen->stream, "size_t i;\n");
     stream__write_characters(gen->stream, ' ', indent + 4);
@@ -3153,7 +3429,7 @@ static code_reach_t generate_thunking_action_code(
         stream__puts(gen->stream, "pcc_value_t null;\n");
     }
     stream__write_characters(gen->stream, ' ', indent);
-    stream__printf(gen->stream, "pcc_thunk_t *const thunk = pcc_thunk__create_leaf(ctx->auxil, pcc_action_%s_" FMT_LU ", " FMT_LU ", " FMT_LU ");\n",
+    stream__printf(gen->stream, "pcc_thunk_t *const thunk = pcc_thunk__create_leaf(ctx, pcc_action_%s_" FMT_LU ", " FMT_LU ", " FMT_LU ");\n",
         gen->rule->data.rule.name, (ulong_t)index, (ulong_t)gen->rule->data.rule.vars.len, (ulong_t)gen->rule->data.rule.capts.len);
     {
         size_t i;
@@ -3180,11 +3456,11 @@ static code_reach_t generate_thunking_action_code(
         stream__write_characters(gen->stream, ' ', indent);
         stream__puts(gen->stream, "thunk->data.leaf.action(ctx, thunk, &null);\n");
         stream__write_characters(gen->stream, ' ', indent);
-        stream__puts(gen->stream, "pcc_thunk__destroy(ctx->auxil, thunk);\n");
+        stream__puts(gen->stream, "pcc_thunk__destroy(ctx, thunk);\n");
     }
     else {
         stream__write_characters(gen->stream, ' ', indent);
-        stream__puts(gen->stream, "pcc_thunk_array__add(ctx->auxil, &chunk->thunks, thunk);\n");
+        stream__puts(gen->stream, "pcc_thunk_array__add(ctx, &chunk->thunks, thunk);\n");
     }
     if (!bare) {
         indent -= 4;
@@ -3224,6 +3500,10 @@ static code_reach_t generate_thunking_error_code(
     return r;
 }
 
+static bool_t is_inlined_rule(const node_t *rule) {
+    return (rule->data.rule.size != VOID_VALUE) ? TRUE : FALSE;
+}
+
 static code_reach_t generate_code(generate_t *gen, const node_t *node, int onfail, size_t indent, bool_t bare) {
     if (node == NULL) {
         print_error("Internal error [%d]\n", __LINE__);
@@ -3234,15 +3514,42 @@ static code_reach_t generate_code(generate_t *gen, const node_t *node, int onfai
         print_error("Internal error [%d]\n", __LINE__);
         exit(-1);
     case NODE_REFERENCE:
-        if (node->data.reference.index != VOID_VALUE) {
+        if (is_inlined_rule(node->data.reference.rule)) {
+            const code_reach_t r = generate_code(gen, node->data.reference.rule->data.rule.expr, onfail, indent, bare);
+            if (r != CODE_REACH__ALWAYS_FAIL && node->data.reference.index != VOID_VALUE) {
+                stream__write_characters(gen->stream, ' ', indent);
+                stream__printf(gen->stream, "memset(&(chunk->values.buf[" FMT_LU "]), 0, sizeof(pcc_value_t));\n", (ulong_t)node->data.reference.index);
+            }
+            if (r != CODE_REACH__ALWAYS_FAIL && node->data.reference.commit) {
+                stream__write_characters(gen->stream, ' ', indent);
+                stream__puts(gen->stream, "pcc_commit_window(ctx, chunk);\n");
+            }
+            return r;
+        }
+        else if (node->data.reference.rule->data.rule.memo == MEMO_MODE__OFF) {
+            stream__write_characters(gen->stream, ' ', indent);
+            if (node->data.reference.index != VOID_VALUE) {
+                stream__printf(gen->stream, "if (!pcc_call_rule(ctx, pcc_evaluate_rule_%s, &chunk->thunks, &(chunk->values.buf[" FMT_LU "]))) goto L%04d;\n",
+                    node->data.reference.name, (ulong_t)node->data.reference.index, onfail);
+            }
+            else {
+                stream__printf(gen->stream, "if (!pcc_call_rule(ctx, pcc_evaluate_rule_%s, &chunk->thunks, NULL)) goto L%04d;\n",
+                    node->data.reference.name, onfail);
+            }
+        }
+        else if (node->data.reference.index != VOID_VALUE) {
             stream__write_characters(gen->stream, ' ', indent);
-            stream__printf(gen->stream, "if (!pcc_apply_rule(ctx, pcc_evaluate_rule_%s, &chunk->thunks, &(chunk->values.buf[" FMT_LU "]))) goto L%04d;\n",
-                node->data.reference.name, (ulong_t)node->data.reference.index, onfail);
+            stream__printf(gen->stream, "if (!pcc_apply_rule(ctx, pcc_evaluate_rule_%s, " FMT_LU ", &chunk->thunks, &(chunk->values.buf[" FMT_LU "]))) goto L%04d;\n",
+                node->data.reference.name, (ulong_t)node->data.reference.rule->data.rule.index, (ulong_t)node->data.reference.index, onfail);
         }
         else {
             stream__write_characters(gen->stream, ' ', indent);
-            stream__printf(gen->stream, "if (!pcc_apply_rule(ctx, pcc_evaluate_rule_%s, &chunk->thunks, NULL)) goto L%04d;\n",
-                node->data.reference.name, onfail);
+            stream__printf(gen->stream, "if (!pcc_apply_rule(ctx, pcc_evaluate_rule_%s, " FMT_LU ", &chunk->thunks, NULL)) goto L%04d;\n",
+                node->data.reference.name, (ulong_t)node->data.reference.rule->data.rule.index, onfail);
+        }
+        if (node->data.reference.commit) {
+            stream__write_characters(gen->stream, ' ', indent);
+            stream__puts(gen->stream, "pcc_commit_window(ctx, chunk);\n");
         }
         return CODE_REACH__BOTH;
     case NODE_STRING:
@@ -3374,10 +3681,18 @@ static bool_t generate(context_t *ctx) {
             "#define PCC_ARRAY_MIN_SIZE 2\n"
             "#endif /* !PCC_ARRAY_MIN_SIZE */\n"
             "\n"
+            "#ifndef PCC_MEMO_MIN_SIZE\n"
+            "#define PCC_MEMO_MIN_SIZE 4 /* must be a power of 2 */\n"
+            "#endif /* !PCC_MEMO_MIN_SIZE */\n"
+            "\n"
             "#ifndef PCC_POOL_MIN_SIZE\n"
             "#define PCC_POOL_MIN_SIZE 65536\n"
             "#endif /* !PCC_POOL_MIN_SIZE */\n"
             "\n"
+            "#ifndef PCC_ARENA_MIN_SIZE\n"
+            "#define PCC_ARENA_MIN_SIZE 1048576\n"
+            "#endif /* !PCC_ARENA_MIN_SIZE */\n"
+            "\n"
             "#define PCC_DBG_EVALUATE 0\n"
             "#define PCC_DBG_MATCH    1\n"
             "#define PCC_DBG_NOMATCH  2\n"
@@ -3393,6 +3708,7 @@ static bool_t generate(context_t *ctx) {
             "    char *buf;\n"
             "    size_t max;\n"
             "    size_t len;\n"
+            "    size_t ofs; /* the number of the leading characters dropped, by which len and max are ahead of buf */\n"
             "} pcc_char_array_t;\n"
             "\n"
             "typedef struct pcc_range_tag {\n"
@@ -3475,6 +3791,7 @@ static bool_t generate(context_t *ctx) {
             "typedef struct pcc_thunk_node_tag {\n"
             "    const pcc_thunk_array_t *thunks; /* just a reference */\n"
             "    pcc_value_t *value; /* just a reference */\n"
+            "    struct pcc_thunk_chunk_tag *chunk; /* the chunk owned by the thunk if the rule is not memoized, or NULL */\n"
             "} pcc_thunk_node_t;\n"
             "\n"
             "typedef union pcc_thunk_data_tag {\n"
@@ -3542,13 +3859,13 @@ static bool_t generate(context_t *ctx) {
             "};\n"
             "\n"
             "typedef struct pcc_lr_memo_tag {\n"
-            "    pcc_rule_t rule;\n"
+            "    size_t rule; /* the index of the rule, or PCC_VOID_VALUE if the slot is empty */\n"
             "    pcc_lr_answer_t *answer;\n"
             "} pcc_lr_memo_t;\n"
             "\n"
-            "typedef struct pcc_lr_memo_map_tag {\n"
+            "typedef struct pcc_lr_memo_map_tag { /* open addressing keyed by the rule index */\n"
             "    pcc_lr_memo_t *buf;\n"
-            "    size_t max;\n"
+            "    size_t max; /* 0 or a power of 2 */\n"
             "    size_t len;\n"
             "} pcc_lr_memo_map_t;\n"
             "\n"
@@ -3564,6 +3881,7 @@ static bool_t generate(context_t *ctx) {
             "    size_t max;\n"
             "    size_t len;\n"
             "    size_t ofs;\n"
+            "    size_t pos; /* the input position of buf[ofs] */\n"
             "} pcc_lr_table_t;\n"
             "\n"
             "struct pcc_lr_entry_tag {\n"
@@ -3600,6 +3918,24 @@ static bool_t generate(context_t *ctx) {
             "    size_t element_size;\n"
             "} pcc_memory_recycler_t;\n"
             "\n"
+            "#ifdef PCC_USE_ARENA\n"
+            "#define PCC_ARENA_CLASS_COUNT (sizeof(size_t) * 8 + 8) /* multiples of 16 up to 256, then powers of 2 */\n"
+            "\n"
+            "typedef struct pcc_arena_block_tag pcc_arena_block_t;\n"
+            "\n"
+            "struct pcc_arena_block_tag {\n"
+            "    pcc_arena_block_t *next;\n"
+            "    size_t size;\n"
+            "};\n"
+            "\n"
+            "typedef struct pcc_arena_tag {\n"
+            "    pcc_arena_block_t *block_list; /* the current block first */\n"
+            "    char *cur;\n"
+            "    char *end;\n"
+            "    pcc_memory_entry_t *entry_lists[PCC_ARENA_CLASS_COUNT]; /* the freed memory by the class of its size */\n"
+            "} pcc_arena_t;\n"
+            "#endif /* PCC_USE_ARENA */\n"
+            "\n"
         );
         stream__printf(
             &sstream,
@@ -3615,6 +3951,9 @@ static bool_t generate(context_t *ctx) {
             "    pcc_memory_recycler_t thunk_chunk_recycler;\n"
             "    pcc_memory_recycler_t lr_head_recycler;\n"
             "    pcc_memory_recycler_t lr_answer_recycler;\n"
+            "#ifdef PCC_USE_ARENA\n"
+            "    pcc_arena_t arena;\n"
+            "#endif /* PCC_USE_ARENA */\n"
             "};\n"
             "\n",
             get_prefix(ctx)
@@ -3634,6 +3973,15 @@ static bool_t generate(context_t *ctx) {
             "#define PCC_GETCHAR(auxil) getchar()\n"
             "#endif /* !PCC_GETCHAR */\n"
             "\n"
+            "/* If defined, PCC_READ(auxil, buf, len) reads up to len bytes of the input into buf instead of PCC_GETCHAR,\n"
+            " * and returns the number of bytes read, or 0 at the end of the input. */\n"
+            "\n"
+            "/* If defined, PCC_INPUT(auxil) and PCC_INPUT_LENGTH(auxil) give the whole input, which is parsed in place\n"
+            " * and must outlive the context. Neither PCC_READ nor PCC_GETCHAR is used then. */\n"
+            "#if defined PCC_INPUT && !defined PCC_INPUT_LENGTH\n"
+            "#error PCC_INPUT_LENGTH must be defined with PCC_INPUT\n"
+            "#endif\n"
+            "\n"
             "#ifndef PCC_MALLOC\n"
             "#define PCC_MALLOC(auxil, size) pcc_malloc_e(size)\n"
             "static void *pcc_malloc_e(size_t size) {\n"
@@ -3666,9 +4014,131 @@ static bool_t generate(context_t *ctx) {
             "#define PCC_DEBUG(auxil, event, rule, level, pos, buffer, length) ((void)0)\n"
             "#endif /* !PCC_DEBUG */\n"
             "\n"
-            "static char *pcc_strndup_e(pcc_auxil_t auxil, const char *str, size_t len) {\n"
+            "/* If PCC_USE_ARENA is defined, the memory of a parse is drawn from blocks of at least PCC_ARENA_MIN_SIZE bytes,\n"
+            " * and is all released at once when the parse ends. Only the context and the input buffer are left to PCC_MALLOC. */\n"
+            "#ifdef PCC_USE_ARENA\n"
+            "#define PCC_ARENA_HEADER_SIZE ((sizeof(pcc_arena_block_t) + 15) & ~(size_t)15) /* keeps the memory 16-byte aligned */\n"
+            "\n"
+            "static void pcc_arena__init(pcc_context_t *ctx) {\n"
+            "    size_t i;\n"
+            "    ctx->arena.block_list = NULL;\n"
+            "    ctx->arena.cur = NULL;\n"
+            "    ctx->arena.end = NULL;\n"
+            "    for (i = 0; i < PCC_ARENA_CLASS_COUNT; i++) ctx->arena.entry_lists[i] = NULL;\n"
+            "}\n"
+            "\n"
+            "static size_t pcc_arena__class(size_t size, size_t *rounded) {\n"
+            "    size_t k = 9;\n"
+            "    if (size <= 256) {\n"
+            "        *rounded = (size <= 16) ? 16 : (size + 15) & ~(size_t)15;\n"
+            "        return (*rounded >> 4) - 1;\n"
+            "    }\n"
+            "    while (((size_t)1 << k) < size) k++;\n"
+            "    *rounded = (size_t)1 << k;\n"
+            "    return k + 7;\n"
+            "}\n"
+            "\n"
+            "static void *pcc_arena__alloc(pcc_context_t *ctx, size_t size) {\n"
+            "    pcc_arena_t *const arena = &ctx->arena;\n"
+            "    size_t n;\n"
+            "    const size_t k = pcc_arena__class(size, &n);\n"
+            "    void *p;\n"
+            "    if (arena->entry_lists[k]) {\n"
+            "        pcc_memory_entry_t *const tmp = arena->entry_lists[k];\n"
+            "        arena->entry_lists[k] = tmp->next;\n"
+            "        return tmp;\n"
+            "    }\n"
+            "    if ((size_t)(arena->end - arena->cur) < n) {\n"
+            "        size_t m = PCC_ARENA_MIN_SIZE;\n"
+            "        if (arena->block_list) m = arena->block_list->size << 1;\n"
+            "        while (m < n) m <<= 1;\n"
+            "        {\n"
+            "            pcc_arena_block_t *const block = (pcc_arena_block_t *)PCC_MALLOC(ctx->auxil, PCC_ARENA_HEADER_SIZE + m);\n"
+            "            block->size = m;\n"
+            "            block->next = arena->block_list;\n"
+            "            arena->block_list = block;\n"
+            "            arena->cur = (char *)block + PCC_ARENA_HEADER_SIZE;\n"
+            "            arena->end = arena->cur + m;\n"
+            "        }\n"
+            "    }\n"
+            "    p = arena->cur;\n"
+            "    arena->cur += n;\n"
+            "    return p;\n"
+            "}\n"
+            "\n"
+            "static void pcc_arena__free(pcc_context_t *ctx, void *ptr, size_t size) {\n"
+            "    pcc_memory_entry_t *const tmp = (pcc_memory_entry_t *)ptr;\n"
+            "    size_t n;\n"
+            "    const size_t k = pcc_arena__class(size, &n);\n"
+            "    tmp->next = ctx->arena.entry_lists[k];\n"
+            "    ctx->arena.entry_lists[k] = tmp;\n"
+            "}\n"
+            "\n"
+            "static void pcc_arena__reset(pcc_context_t *ctx) { /* keeps the last block, which is the largest */\n"
+            "    pcc_arena_block_t *const block = ctx->arena.block_list;\n"
+            "    if (block == NULL) return;\n"
+            "    while (block->next) {\n"
+            "        pcc_arena_block_t *const tmp = block->next;\n"
+            "        block->next = tmp->next;\n"
+            "        PCC_FREE(ctx->auxil, tmp);\n"
+            "    }\n"
+            "    pcc_arena__init(ctx);\n"
+            "    ctx->arena.block_list = block;\n"
+            "    ctx->arena.cur = (char *)block + PCC_ARENA_HEADER_SIZE;\n"
+            "    ctx->arena.end = ctx->arena.cur + block->size;\n"
+            "}\n"
+            "\n"
+            "static void pcc_arena__term(pcc_context_t *ctx) {\n"
+            "    while (ctx->arena.block_list) {\n"
+            "        pcc_arena_block_t *const tmp = ctx->arena.block_list;\n"
+            "        ctx->arena.block_list = tmp->next;\n"
+            "        PCC_FREE(ctx->auxil, tmp);\n"
+            "    }\n"
+            "}\n"
+            "#endif /* PCC_USE_ARENA */\n"
+            "\n"
+            "static void *pcc_malloc(pcc_context_t *ctx, size_t size) {\n"
+            "#ifdef PCC_USE_ARENA\n"
+            "    return pcc_arena__alloc(ctx, size);\n"
+            "#else /* !PCC_USE_ARENA */\n"
+            "    return PCC_MALLOC(ctx->auxil, size);\n"
+            "#endif /* PCC_USE_ARENA */\n"
+            "}\n"
+            "\n"
+            "static void *pcc_realloc(pcc_context_t *ctx, void *ptr, size_t old_size, size_t size) {\n"
+            "#ifdef PCC_USE_ARENA\n"
+            "    void *p;\n"
+            "    size_t n;\n"
+            "    if (ptr == NULL) return pcc_arena__alloc(ctx, size);\n"
+            "    if (pcc_arena__class(old_size, &n) == pcc_arena__class(size, &n)) return ptr;\n"
+            "    p = pcc_arena__alloc(ctx, size);\n"
+            "    memcpy(p, ptr, (old_size < size) ? old_size : size);\n"
+            "    pcc_arena__free(ctx, ptr, old_size);\n"
+            "    return p;\n"
+            "#else /* !PCC_USE_ARENA */\n"
+            "    return PCC_REALLOC(ctx->auxil, ptr, size);\n"
+            "#endif /* PCC_USE_ARENA */\n"
+            "}\n"
+            "\n"
+            "static void pcc_free(pcc_context_t *ctx, void *ptr, size_t size) {\n"
+            "#ifdef PCC_USE_ARENA\n"
+            "    if (ptr != NULL) pcc_arena__free(ctx, ptr, size);\n"
+            "#else /* !PCC_USE_ARENA */\n"
+            "    PCC_FREE(ctx->auxil, ptr);\n"
+            "#endif /* PCC_USE_ARENA */\n"
+            "}\n"
+            "\n"
+            "static void pcc_free_string(pcc_context_t *ctx, char *str) {\n"
+            "#ifdef PCC_USE_ARENA\n"
+            "    if (str != NULL) pcc_arena__free(ctx, str, strlen(str) + 1);\n"
+            "#else /* !PCC_USE_ARENA */\n"
+            "    PCC_FREE(ctx->auxil, str);\n"
+            "#endif /* PCC_USE_ARENA */\n"
+            "}\n"
+            "\n"
+            "static char *pcc_strndup_e(pcc_context_t *ctx, const char *str, size_t len) {\n"
             "    const size_t m = strnlen(str, len);\n"
-            "    char *const s = (char *)PCC_MALLOC(auxil, m + 1);\n"
+            "    char *const s = (char *)pcc_malloc(ctx, m + 1);\n"
             "    memcpy(s, str, m);\n"
             "    s[m] = '\\0';\n"
             "    return s;\n"
@@ -3680,103 +4150,124 @@ static bool_t generate(context_t *ctx) {
             "static void pcc_char_array__init(pcc_auxil_t auxil, pcc_char_array_t *array) {\n"
             "    array->len = 0;\n"
             "    array->max = 0;\n"
+            "    array->ofs = 0;\n"
             "    array->buf = NULL;\n"
             "}\n"
             "\n"
-            "static void pcc_char_array__add(pcc_auxil_t auxil, pcc_char_array_t *array, char ch) {\n"
-            "    if (array->max <= array->len) {\n"
-            "        const size_t n = array->len + 1;\n"
-            "        size_t m = array->max;\n"
+            "MARK_FUNC_AS_USED\n"
+            "static void pcc_char_array__reserve(pcc_auxil_t auxil, pcc_char_array_t *array, size_t len) {\n"
+            "    if (array->max < len) {\n"
+            "        size_t m = array->max - array->ofs;\n"
             "        if (m == 0) m = PCC_BUFFER_MIN_SIZE;\n"
-            "        while (m < n && m != 0) m <<= 1;\n"
-            "        if (m == 0) m = n;\n"
+            "        while (m < len - array->ofs && m != 0) m <<= 1;\n"
+            "        if (m == 0) m = len - array->ofs;\n"
             "        array->buf = (char *)PCC_REALLOC(auxil, array->buf, m);\n"
-            "        array->max = m;\n"
+            "        array->max = m + array->ofs;\n"
             "    }\n"
-            "    array->buf[array->len++] = ch;\n"
+            "}\n"
+            "\n"
+            "MARK_FUNC_AS_USED\n"
+            "static void pcc_char_array__add(pcc_auxil_t auxil, pcc_char_array_t *array, char ch) {\n"
+            "    if (array->max <= array->len) pcc_char_array__reserve(auxil, array, array->len + 1);\n"
+            "    array->buf[array->len++ - array->ofs] = ch;\n"
+            "}\n"
+            "\n"
+            "MARK_FUNC_AS_USED\n"
+            "static void pcc_char_array__drop(pcc_auxil_t auxil, pcc_char_array_t *array, size_t len) {\n"
+            "    const size_t n = len - array->ofs;\n"
+            "    memmove(array->buf, array->buf + n, array->len - len);\n"
+            "    array->max += n;\n"
+            "    array->ofs = len;\n"
             "}\n"
             "\n"
             "static void pcc_char_array__term(pcc_auxil_t auxil, pcc_char_array_t *array) {\n"
+            "#ifndef PCC_INPUT\n"
             "    PCC_FREE(auxil, array->buf);\n"
+            "#endif /* !PCC_INPUT */\n"
+            "}\n"
+            "\n"
+            "MARK_FUNC_AS_USED\n"
+            "static const char *pcc_char_array__at(const pcc_char_array_t *array, size_t pos) { /* pos must not be dropped */\n"
+            "    return array->buf + (pos - array->ofs);\n"
             "}\n"
             "\n"
         );
         stream__puts(
             &sstream,
-            "static void pcc_value_table__init(pcc_auxil_t auxil, pcc_value_table_t *table) {\n"
+            "static void pcc_value_table__init(pcc_context_t *ctx, pcc_value_table_t *table) {\n"
             "    table->len = 0;\n"
             "    table->max = 0;\n"
             "    table->buf = NULL;\n"
             "}\n"
             "\n"
             "MARK_FUNC_AS_USED\n"
-            "static void pcc_value_table__resize(pcc_auxil_t auxil, pcc_value_table_t *table, size_t len) {\n"
+            "static void pcc_value_table__resize(pcc_context_t *ctx, pcc_value_table_t *table, size_t len) {\n"
             "    if (table->max < len) {\n"
             "        size_t m = table->max;\n"
             "        if (m == 0) m = PCC_ARRAY_MIN_SIZE;\n"
             "        while (m < len && m != 0) m <<= 1;\n"
             "        if (m == 0) m = len;\n"
-            "        table->buf = (pcc_value_t *)PCC_REALLOC(auxil, table->buf, sizeof(pcc_value_t) * m);\n"
+            "        table->buf = (pcc_value_t *)pcc_realloc(ctx, table->buf, sizeof(pcc_value_t) * table->max, sizeof(pcc_value_t) * m);\n"
             "        table->max = m;\n"
             "    }\n"
             "    table->len = len;\n"
             "}\n"
             "\n"
             "MARK_FUNC_AS_USED\n"
-            "static void pcc_value_table__clear(pcc_auxil_t auxil, pcc_value_table_t *table) {\n"
+            "static void pcc_value_table__clear(pcc_context_t *ctx, pcc_value_table_t *table) {\n"
             "    memset(table->buf, 0, sizeof(pcc_value_t) * table->len);\n"
             "}\n"
             "\n"
-            "static void pcc_value_table__term(pcc_auxil_t auxil, pcc_value_table_t *table) {\n"
-            "    PCC_FREE(auxil, table->buf);\n"
+            "static void pcc_value_table__term(pcc_context_t *ctx, pcc_value_table_t *table) {\n"
+            "    pcc_free(ctx, table->buf, sizeof(pcc_value_t) * table->max);\n"
             "}\n"
             "\n"
         );
         stream__puts(
             &sstream,
-            "static void pcc_value_refer_table__init(pcc_auxil_t auxil, pcc_value_refer_table_t *table) {\n"
+            "static void pcc_value_refer_table__init(pcc_context_t *ctx, pcc_value_refer_table_t *table) {\n"
             "    table->len = 0;\n"
             "    table->max = 0;\n"
             "    table->buf = NULL;\n"
             "}\n"
             "\n"
-            "static void pcc_value_refer_table__resize(pcc_auxil_t auxil, pcc_value_refer_table_t *table, size_t len) {\n"
+            "static void pcc_value_refer_table__resize(pcc_context_t *ctx, pcc_value_refer_table_t *table, size_t len) {\n"
             "    size_t i;\n"
             "    if (table->max < len) {\n"
             "        size_t m = table->max;\n"
             "        if (m == 0) m = PCC_ARRAY_MIN_SIZE;\n"
             "        while (m < len && m != 0) m <<= 1;\n"
             "        if (m == 0) m = len;\n"
-            "        table->buf = (pcc_value_t **)PCC_REALLOC(auxil, table->buf, sizeof(pcc_value_t *) * m);\n"
+            "        table->buf = (pcc_value_t **)pcc_realloc(ctx, table->buf, sizeof(pcc_value_t *) * table->max, sizeof(pcc_value_t *) * m);\n"
             "        table->max = m;\n"
             "    }\n"
             "    for (i = table->len; i < len; i++) table->buf[i] = NULL;\n"
             "    table->len = len;\n"
             "}\n"
             "\n"
-            "static void pcc_value_refer_table__term(pcc_auxil_t auxil, pcc_value_refer_table_t *table) {\n"
-            "    PCC_FREE(auxil, table->buf);\n"
+            "static void pcc_value_refer_table__term(pcc_context_t *ctx, pcc_value_refer_table_t *table) {\n"
+            "    pcc_free(ctx, table->buf, sizeof(pcc_value_t *) * table->max);\n"
             "}\n"
             "\n"
         );
         stream__puts(
             &sstream,
-            "static void pcc_capture_table__init(pcc_auxil_t auxil, pcc_capture_table_t *table) {\n"
+            "static void pcc_capture_table__init(pcc_context_t *ctx, pcc_capture_table_t *table) {\n"
             "    table->len = 0;\n"
             "    table->max = 0;\n"
             "    table->buf = NULL;\n"
             "}\n"
             "\n"
             "MARK_FUNC_AS_USED\n"
-            "static void pcc_capture_table__resize(pcc_auxil_t auxil, pcc_capture_table_t *table, size_t len) {\n"
+            "static void pcc_capture_table__resize(pcc_context_t *ctx, pcc_capture_table_t *table, size_t len) {\n"
             "    size_t i;\n"
-            "    for (i = len; i < table->len; i++) PCC_FREE(auxil, table->buf[i].string);\n"
+            "    for (i = len; i < table->len; i++) pcc_free_string(ctx, table->buf[i].string);\n"
             "    if (table->max < len) {\n"
             "        size_t m = table->max;\n"
             "        if (m == 0) m = PCC_ARRAY_MIN_SIZE;\n"
             "        while (m < len && m != 0) m <<= 1;\n"
             "        if (m == 0) m = len;\n"
-            "        table->buf = (pcc_capture_t *)PCC_REALLOC(auxil, table->buf, sizeof(pcc_capture_t) * m);\n"
+            "        table->buf = (pcc_capture_t *)pcc_realloc(ctx, table->buf, sizeof(pcc_capture_t) * table->max, sizeof(pcc_capture_t) * m);\n"
             "        table->max = m;\n"
             "    }\n"
             "    for (i = table->len; i < len; i++) {\n"
@@ -3787,52 +4278,52 @@ static bool_t generate(context_t *ctx) {
             "    table->len = len;\n"
             "}\n"
             "\n"
-            "static void pcc_capture_table__term(pcc_auxil_t auxil, pcc_capture_table_t *table) {\n"
+            "static void pcc_capture_table__term(pcc_context_t *ctx, pcc_capture_table_t *table) {\n"
             "    while (table->len > 0) {\n"
             "        table->len--;\n"
-            "        PCC_FREE(auxil, table->buf[table->len].string);\n"
+            "        pcc_free_string(ctx, table->buf[table->len].string);\n"
             "    }\n"
-            "    PCC_FREE(auxil, table->buf);\n"
+            "    pcc_free(ctx, table->buf, sizeof(pcc_capture_t) * table->max);\n"
             "}\n"
             "\n"
         );
         stream__puts(
             &sstream,
-            "static void pcc_capture_const_table__init(pcc_auxil_t auxil, pcc_capture_const_table_t *table) {\n"
+            "static void pcc_capture_const_table__init(pcc_context_t *ctx, pcc_capture_const_table_t *table) {\n"
             "    table->len = 0;\n"
             "    table->max = 0;\n"
             "    table->buf = NULL;\n"
             "}\n"
             "\n"
-            "static void pcc_capture_const_table__resize(pcc_auxil_t auxil, pcc_capture_const_table_t *table, size_t len) {\n"
+            "static void pcc_capture_const_table__resize(pcc_context_t *ctx, pcc_capture_const_table_t *table, size_t len) {\n"
             "    size_t i;\n"
             "    if (table->max < len) {\n"
             "        size_t m = table->max;\n"
             "        if (m == 0) m = PCC_ARRAY_MIN_SIZE;\n"
             "        while (m < len && m != 0) m <<= 1;\n"
             "        if (m == 0) m = len;\n"
-            "        table->buf = (const pcc_capture_t **)PCC_REALLOC(auxil, (pcc_capture_t **)table->buf, sizeof(const pcc_capture_t *) * m);\n"
+            "        table->buf = (const pcc_capture_t **)pcc_realloc(ctx, (pcc_capture_t **)table->buf, sizeof(const pcc_capture_t *) * table->max, sizeof(const pcc_capture_t *) * m);\n"
             "        table->max = m;\n"
             "    }\n"
             "    for (i = table->len; i < len; i++) table->buf[i] = NULL;\n"
             "    table->len = len;\n"
             "}\n"
             "\n"
-            "static void pcc_capture_const_table__term(pcc_auxil_t auxil, pcc_capture_const_table_t *table) {\n"
-            "    PCC_FREE(auxil, (void *)table->buf);\n"
+            "static void pcc_capture_const_table__term(pcc_context_t *ctx, pcc_capture_const_table_t *table) {\n"
+            "    pcc_free(ctx, (void *)table->buf, sizeof(const pcc_capture_t *) * table->max);\n"
             "}\n"
             "\n"
         );
         stream__puts(
             &sstream,
             "MARK_FUNC_AS_USED\n"
-            "static pcc_thunk_t *pcc_thunk__create_leaf(pcc_auxil_t auxil, pcc_action_t action, size_t valuec, size_t captc) {\n"
-            "    pcc_thunk_t *const thunk = (pcc_thunk_t *)PCC_MALLOC(auxil, sizeof(pcc_thunk_t));\n"
+            "static pcc_thunk_t *pcc_thunk__create_leaf(pcc_context_t *ctx, pcc_action_t action, size_t valuec, size_t captc) {\n"
+            "    pcc_thunk_t *const thunk = (pcc_thunk_t *)pcc_malloc(ctx, sizeof(pcc_thunk_t));\n"
             "    thunk->type = PCC_THUNK_LEAF;\n"
-            "    pcc_value_refer_table__init(auxil, &thunk->data.leaf.values);\n"
-            "    pcc_value_refer_table__resize(auxil, &thunk->data.leaf.values, valuec);\n"
-            "    pcc_capture_const_table__init(auxil, &thunk->data.leaf.capts);\n"
-            "    pcc_capture_const_table__resize(auxil, &thunk->data.leaf.capts, captc);\n"
+            "    pcc_value_refer_table__init(ctx, &thunk->data.leaf.values);\n"
+            "    pcc_value_refer_table__resize(ctx, &thunk->data.leaf.values, valuec);\n"
+            "    pcc_capture_const_table__init(ctx, &thunk->data.leaf.capts);\n"
+            "    pcc_capture_const_table__resize(ctx, &thunk->data.leaf.capts, captc);\n"
             "    thunk->data.leaf.capt0.range.start = 0;\n"
             "    thunk->data.leaf.capt0.range.end = 0;\n"
             "    thunk->data.leaf.capt0.string = NULL;\n"
@@ -3840,77 +4331,81 @@ static bool_t generate(context_t *ctx) {
             "    return thunk;\n"
             "}\n"
             "\n"
-            "static pcc_thunk_t *pcc_thunk__create_node(pcc_auxil_t auxil, const pcc_thunk_array_t *thunks, pcc_value_t *value) {\n"
-            "    pcc_thunk_t *const thunk = (pcc_thunk_t *)PCC_MALLOC(auxil, sizeof(pcc_thunk_t));\n"
+            "static pcc_thunk_t *pcc_thunk__create_node(pcc_context_t *ctx, const pcc_thunk_array_t *thunks, pcc_value_t *value) {\n"
+            "    pcc_thunk_t *const thunk = (pcc_thunk_t *)pcc_malloc(ctx, sizeof(pcc_thunk_t));\n"
             "    thunk->type = PCC_THUNK_NODE;\n"
             "    thunk->data.node.thunks = thunks;\n"
             "    thunk->data.node.value = value;\n"
+            "    thunk->data.node.chunk = NULL;\n"
             "    return thunk;\n"
             "}\n"
             "\n"
-            "static void pcc_thunk__destroy(pcc_auxil_t auxil, pcc_thunk_t *thunk) {\n"
+            "static void pcc_thunk_chunk__destroy(pcc_context_t *ctx, pcc_thunk_chunk_t *chunk);\n"
+            "\n"
+            "static void pcc_thunk__destroy(pcc_context_t *ctx, pcc_thunk_t *thunk) {\n"
             "    if (thunk == NULL) return;\n"
             "    switch (thunk->type) {\n"
             "    case PCC_THUNK_LEAF:\n"
-            "        PCC_FREE(auxil, thunk->data.leaf.capt0.string);\n"
-            "        pcc_capture_const_table__term(auxil, &thunk->data.leaf.capts);\n"
-            "        pcc_value_refer_table__term(auxil, &thunk->data.leaf.values);\n"
+            "        pcc_free_string(ctx, thunk->data.leaf.capt0.string);\n"
+            "        pcc_capture_const_table__term(ctx, &thunk->data.leaf.capts);\n"
+            "        pcc_value_refer_table__term(ctx, &thunk->data.leaf.values);\n"
             "        break;\n"
             "    case PCC_THUNK_NODE:\n"
+            "        pcc_thunk_chunk__destroy(ctx, thunk->data.node.chunk);\n"
             "        break;\n"
             "    default: /* unknown */\n"
             "        break;\n"
             "    }\n"
-            "    PCC_FREE(auxil, thunk);\n"
+            "    pcc_free(ctx, thunk, sizeof(pcc_thunk_t));\n"
             "}\n"
             "\n"
         );
         stream__puts(
             &sstream,
-            "static void pcc_thunk_array__init(pcc_auxil_t auxil, pcc_thunk_array_t *array) {\n"
+            "static void pcc_thunk_array__init(pcc_context_t *ctx, pcc_thunk_array_t *array) {\n"
             "    array->len = 0;\n"
             "    array->max = 0;\n"
             "    array->buf = NULL;\n"
             "}\n"
             "\n"
-            "static void pcc_thunk_array__add(pcc_auxil_t auxil, pcc_thunk_array_t *array, pcc_thunk_t *thunk) {\n"
+            "static void pcc_thunk_array__add(pcc_context_t *ctx, pcc_thunk_array_t *array, pcc_thunk_t *thunk) {\n"
             "    if (array->max <= array->len) {\n"
             "        const size_t n = array->len + 1;\n"
             "        size_t m = array->max;\n"
             "        if (m == 0) m = PCC_ARRAY_MIN_SIZE;\n"
             "        while (m < n && m != 0) m <<= 1;\n"
             "        if (m == 0) m = n;\n"
-            "        array->buf = (pcc_thunk_t **)PCC_REALLOC(auxil, array->buf, sizeof(pcc_thunk_t *) * m);\n"
+            "        array->buf = (pcc_thunk_t **)pcc_realloc(ctx, array->buf, sizeof(pcc_thunk_t *) * array->max, sizeof(pcc_thunk_t *) * m);\n"
             "        array->max = m;\n"
             "    }\n"
             "    array->buf[array->len++] = thunk;\n"
             "}\n"
             "\n"
-            "static void pcc_thunk_array__revert(pcc_auxil_t auxil, pcc_thunk_array_t *array, size_t len) {\n"
+            "static void pcc_thunk_array__revert(pcc_context_t *ctx, pcc_thunk_array_t *array, size_t len) {\n"
             "    while (array->len > len) {\n"
             "        array->len--;\n"
-            "        pcc_thunk__destroy(auxil, array->buf[array->len]);\n"
+            "        pcc_thunk__destroy(ctx, array->buf[array->len]);\n"
             "    }\n"
             "}\n"
             "\n"
-            "static void pcc_thunk_array__term(pcc_auxil_t auxil, pcc_thunk_array_t *array) {\n"
+            "static void pcc_thunk_array__term(pcc_context_t *ctx, pcc_thunk_array_t *array) {\n"
             "    while (array->len > 0) {\n"
             "        array->len--;\n"
-            "        pcc_thunk__destroy(auxil, array->buf[array->len]);\n"
+            "        pcc_thunk__destroy(ctx, array->buf[array->len]);\n"
             "    }\n"
-            "    PCC_FREE(auxil, array->buf);\n"
+            "    pcc_free(ctx, array->buf, sizeof(pcc_thunk_t *) * array->max);\n"
             "}\n"
             "\n"
         );
         stream__puts(
             &sstream,
-            "static void pcc_memory_recycler__init(pcc_auxil_t auxil, pcc_memory_recycler_t *recycler, size_t element_size) {\n"
+            "static void pcc_memory_recycler__init(pcc_context_t *ctx, pcc_memory_recycler_t *recycler, size_t element_size) {\n"
             "    recycler->pool_list = NULL;\n"
             "    recycler->entry_list = NULL;\n"
             "    recycler->element_size = element_size;\n"
             "}\n"
             "\n"
-            "static void *pcc_memory_recycler__supply(pcc_auxil_t auxil, pcc_memory_recycler_t *recycler) {\n"
+            "static void *pcc_memory_recycler__supply(pcc_context_t *ctx, pcc_memory_recycler_t *recycler) {\n"
             "    if (recycler->entry_list) {\n"
             "        pcc_memory_entry_t *const tmp = recycler->entry_list;\n"
             "        recycler->entry_list = tmp->next;\n"
@@ -3923,8 +4418,8 @@ static bool_t generate(context_t *ctx) {
             "            if (size == 0) size = recycler->pool_list->allocated;\n"
             "        }\n"
             "        {\n"
-            "            pcc_memory_pool_t *const pool = (pcc_memory_pool_t *)PCC_MALLOC(\n"
-            "                auxil, sizeof(pcc_memory_pool_t) + recycler->element_size * size\n"
+            "            pcc_memory_pool_t *const pool = (pcc_memory_pool_t *)pcc_malloc(\n"
+            "                ctx, sizeof(pcc_memory_pool_t) + recycler->element_size * size\n"
             "            );\n"
             "            pool->allocated = size;\n"
             "            pool->unused = size;\n"
@@ -3936,17 +4431,18 @@ static bool_t generate(context_t *ctx) {
             "    return (char *)recycler->pool_list + sizeof(pcc_memory_pool_t) + recycler->element_size * recycler->pool_list->unused;\n"
             "}\n"
             "\n"
-            "static void pcc_memory_recycler__recycle(pcc_auxil_t auxil, pcc_memory_recycler_t *recycler, void *ptr) {\n"
+            "static void pcc_memory_recycler__recycle(pcc_context_t *ctx, pcc_memory_recycler_t *recycler, void *ptr) {\n"
             "    pcc_memory_entry_t *const tmp = (pcc_memory_entry_t *)ptr;\n"
             "    tmp->next = recycler->entry_list;\n"
             "    recycler->entry_list = tmp;\n"
             "}\n"
             "\n"
-            "static void pcc_memory_recycler__term(pcc_auxil_t auxil, pcc_memory_recycler_t *recycler) {\n"
+            "MARK_FUNC_AS_USED\n"
+            "static void pcc_memory_recycler__term(pcc_context_t *ctx, pcc_memory_recycler_t *recycler) {\n"
             "    while (recycler->pool_list) {\n"
             "        pcc_memory_pool_t *const tmp = recycler->pool_list;\n"
             "        recycler->pool_list = tmp->next;\n"
-            "        PCC_FREE(auxil, tmp);\n"
+            "        pcc_free(ctx, tmp, sizeof(pcc_memory_pool_t) + recycler->element_size * tmp->allocated);\n"
             "    }\n"
             "}\n"
             "\n"
@@ -3955,32 +4451,32 @@ static bool_t generate(context_t *ctx) {
             &sstream,
             "MARK_FUNC_AS_USED\n"
             "static pcc_thunk_chunk_t *pcc_thunk_chunk__create(pcc_context_t *ctx) {\n"
-            "    pcc_thunk_chunk_t *const chunk = (pcc_thunk_chunk_t *)pcc_memory_recycler__supply(ctx->auxil, &ctx->thunk_chunk_recycler);\n"
-            "    pcc_value_table__init(ctx->auxil, &chunk->values);\n"
-            "    pcc_capture_table__init(ctx->auxil, &chunk->capts);\n"
-            "    pcc_thunk_array__init(ctx->auxil, &chunk->thunks);\n"
+            "    pcc_thunk_chunk_t *const chunk = (pcc_thunk_chunk_t *)pcc_memory_recycler__supply(ctx, &ctx->thunk_chunk_recycler);\n"
+            "    pcc_value_table__init(ctx, &chunk->values);\n"
+            "    pcc_capture_table__init(ctx, &chunk->capts);\n"
+            "    pcc_thunk_array__init(ctx, &chunk->thunks);\n"
             "    chunk->pos = 0;\n"
             "    return chunk;\n"
             "}\n"
             "\n"
             "static void pcc_thunk_chunk__destroy(pcc_context_t *ctx, pcc_thunk_chunk_t *chunk) {\n"
             "    if (chunk == NULL) return;\n"
-            "    pcc_thunk_array__term(ctx->auxil, &chunk->thunks);\n"
-            "    pcc_capture_table__term(ctx->auxil, &chunk->capts);\n"
-            "    pcc_value_table__term(ctx->auxil, &chunk->values);\n"
-            "    pcc_memory_recycler__recycle(ctx->auxil, &ctx->thunk_chunk_recycler, chunk);\n"
+            "    pcc_thunk_array__term(ctx, &chunk->thunks);\n"
+            "    pcc_capture_table__term(ctx, &chunk->capts);\n"
+            "    pcc_value_table__term(ctx, &chunk->values);\n"
+            "    pcc_memory_recycler__recycle(ctx, &ctx->thunk_chunk_recycler, chunk);\n"
             "}\n"
             "\n"
         );
         stream__puts(
             &sstream,
-            "static void pcc_rule_set__init(pcc_auxil_t auxil, pcc_rule_set_t *set) {\n"
+            "static void pcc_rule_set__init(pcc_context_t *ctx, pcc_rule_set_t *set) {\n"
             "    set->len = 0;\n"
             "    set->max = 0;\n"
             "    set->buf = NULL;\n"
             "}\n"
             "\n"
-            "static size_t pcc_rule_set__index(pcc_auxil_t auxil, const pcc_rule_set_t *set, pcc_rule_t rule) {\n"
+            "static size_t pcc_rule_set__index(pcc_context_t *ctx, const pcc_rule_set_t *set, pcc_rule_t rule) {\n"
             "    size_t i;\n"
             "    for (i = 0; i < set->len; i++) {\n"
             "        if (set->buf[i] == rule) return i;\n"
@@ -3988,8 +4484,8 @@ static bool_t generate(context_t *ctx) {
             "    return PCC_VOID_VALUE;\n"
             "}\n"
             "\n"
-            "static pcc_bool_t pcc_rule_set__add(pcc_auxil_t auxil, pcc_rule_set_t *set, pcc_rule_t rule) {\n"
-            "    const size_t i = pcc_rule_set__index(auxil, set, rule);\n"
+            "static pcc_bool_t pcc_rule_set__add(pcc_context_t *ctx, pcc_rule_set_t *set, pcc_rule_t rule) {\n"
+            "    const size_t i = pcc_rule_set__index(ctx, set, rule);\n"
             "    if (i != PCC_VOID_VALUE) return PCC_FALSE;\n"
             "    if (set->max <= set->len) {\n"
             "        const size_t n = set->len + 1;\n"
@@ -3997,44 +4493,44 @@ static bool_t generate(context_t *ctx) {
             "        if (m == 0) m = PCC_ARRAY_MIN_SIZE;\n"
             "        while (m < n && m != 0) m <<= 1;\n"
             "        if (m == 0) m = n;\n"
-            "        set->buf = (pcc_rule_t *)PCC_REALLOC(auxil, set->buf, sizeof(pcc_rule_t) * m);\n"
+            "        set->buf = (pcc_rule_t *)pcc_realloc(ctx, set->buf, sizeof(pcc_rule_t) * set->max, sizeof(pcc_rule_t) * m);\n"
             "        set->max = m;\n"
             "    }\n"
             "    set->buf[set->len++] = rule;\n"
             "    return PCC_TRUE;\n"
             "}\n"
             "\n"
-            "static pcc_bool_t pcc_rule_set__remove(pcc_auxil_t auxil, pcc_rule_set_t *set, pcc_rule_t rule) {\n"
-            "    const size_t i = pcc_rule_set__index(auxil, set, rule);\n"
+            "static pcc_bool_t pcc_rule_set__remove(pcc_context_t *ctx, pcc_rule_set_t *set, pcc_rule_t rule) {\n"
+            "    const size_t i = pcc_rule_set__index(ctx, set, rule);\n"
             "    if (i == PCC_VOID_VALUE) return PCC_FALSE;\n"
             "    memmove(set->buf + i, set->buf + (i + 1), sizeof(pcc_rule_t) * (set->len - (i + 1)));\n"
             "    return PCC_TRUE;\n"
             "}\n"
             "\n"
-            "static void pcc_rule_set__clear(pcc_auxil_t auxil, pcc_rule_set_t *set) {\n"
+            "static void pcc_rule_set__clear(pcc_context_t *ctx, pcc_rule_set_t *set) {\n"
             "    set->len = 0;\n"
             "}\n"
             "\n"
-            "static void pcc_rule_set__copy(pcc_auxil_t auxil, pcc_rule_set_t *set, const pcc_rule_set_t *src) {\n"
+            "static void pcc_rule_set__copy(pcc_context_t *ctx, pcc_rule_set_t *set, const pcc_rule_set_t *src) {\n"
             "    size_t i;\n"
-            "    pcc_rule_set__clear(auxil, set);\n"
+            "    pcc_rule_set__clear(ctx, set);\n"
             "    for (i = 0; i < src->len; i++) {\n"
-            "        pcc_rule_set__add(auxil, set, src->buf[i]);\n"
+            "        pcc_rule_set__add(ctx, set, src->buf[i]);\n"
             "    }\n"
             "}\n"
             "\n"
-            "static void pcc_rule_set__term(pcc_auxil_t auxil, pcc_rule_set_t *set) {\n"
-            "    PCC_FREE(auxil, set->buf);\n"
+            "static void pcc_rule_set__term(pcc_context_t *ctx, pcc_rule_set_t *set) {\n"
+            "    pcc_free(ctx, set->buf, sizeof(pcc_rule_t) * set->max);\n"
             "}\n"
             "\n"
         );
         stream__puts(
             &sstream,
             "static pcc_lr_head_t *pcc_lr_head__create(pcc_context_t *ctx, pcc_rule_t rule) {\n"
-            "    pcc_lr_head_t *const head = (pcc_lr_head_t *)pcc_memory_recycler__supply(ctx->auxil, &ctx->lr_head_recycler);\n"
+            "    pcc_lr_head_t *const head = (pcc_lr_head_t *)pcc_memory_recycler__supply(ctx, &ctx->lr_head_recycler);\n"
             "    head->rule = rule;\n"
-            "    pcc_rule_set__init(ctx->auxil, &head->invol);\n"
-            "    pcc_rule_set__init(ctx->auxil, &head->eval);\n"
+            "    pcc_rule_set__init(ctx, &head->invol);\n"
+            "    pcc_rule_set__init(ctx, &head->eval);\n"
             "    head->hold = NULL;\n"
             "    return head;\n"
             "}\n"
@@ -4042,18 +4538,18 @@ static bool_t generate(context_t *ctx) {
             "static void pcc_lr_head__destroy(pcc_context_t *ctx, pcc_lr_head_t *head) {\n"
             "    if (head == NULL) return;\n"
             "    pcc_lr_head__destroy(ctx, head->hold);\n"
-            "    pcc_rule_set__term(ctx->auxil, &head->eval);\n"
-            "    pcc_rule_set__term(ctx->auxil, &head->invol);\n"
-            "    pcc_memory_recycler__recycle(ctx->auxil, &ctx->lr_head_recycler, head);\n"
+            "    pcc_rule_set__term(ctx, &head->eval);\n"
+            "    pcc_rule_set__term(ctx, &head->invol);\n"
+            "    pcc_memory_recycler__recycle(ctx, &ctx->lr_head_recycler, head);\n"
             "}\n"
             "\n"
         );
         stream__puts(
             &sstream,
-            "static void pcc_lr_entry__destroy(pcc_auxil_t auxil, pcc_lr_entry_t *lr);\n"
+            "static void pcc_lr_entry__destroy(pcc_context_t *ctx, pcc_lr_entry_t *lr);\n"
             "\n"
             "static pcc_lr_answer_t *pcc_lr_answer__create(pcc_context_t *ctx, pcc_lr_answer_type_t type, size_t pos) {\n"
-            "    pcc_lr_answer_t *answer = (pcc_lr_answer_t *)pcc_memory_recycler__supply(ctx->auxil, &ctx->lr_answer_recycler);\n"
+            "    pcc_lr_answer_t *answer = (pcc_lr_answer_t *)pcc_memory_recycler__supply(ctx, &ctx->lr_answer_recycler);\n"
             "    answer->type = type;\n"
             "    answer->pos = pos;\n"
             "    answer->hold = NULL;\n"
@@ -4065,7 +4561,7 @@ static bool_t generate(context_t *ctx) {
             "        answer->data.chunk = NULL;\n"
             "        break;\n"
             "    default: /* unknown */\n"
-            "        PCC_FREE(ctx->auxil, answer);\n"
+            "        pcc_memory_recycler__recycle(ctx, &ctx->lr_answer_recycler, answer);\n"
             "        answer = NULL;\n"
             "    }\n"
             "    return answer;\n"
@@ -4094,7 +4590,7 @@ static bool_t generate(context_t *ctx) {
             "        pcc_lr_answer_t *const a = answer->hold;\n"
             "        switch (answer->type) {\n"
             "        case PCC_LR_ANSWER_LR:\n"
-            "            pcc_lr_entry__destroy(ctx->auxil, answer->data.lr);\n"
+            "            pcc_lr_entry__destroy(ctx, answer->data.lr);\n"
             "            break;\n"
             "        case PCC_LR_ANSWER_CHUNK:\n"
             "            pcc_thunk_chunk__destroy(ctx, answer->data.chunk);\n"
@@ -4102,7 +4598,7 @@ static bool_t generate(context_t *ctx) {
             "        default: /* unknown */\n"
             "            break;\n"
             "        }\n"
-            "        pcc_memory_recycler__recycle(ctx->auxil, &ctx->lr_answer_recycler, answer);\n"
+            "        pcc_memory_recycler__recycle(ctx, &ctx->lr_answer_recycler, answer);\n"
             "        answer = a;\n"
             "    }\n"
             "}\n"
@@ -4110,62 +4606,76 @@ static bool_t generate(context_t *ctx) {
         );
         stream__puts(
             &sstream,
-            "static void pcc_lr_memo_map__init(pcc_auxil_t auxil, pcc_lr_memo_map_t *map) {\n"
+            "static void pcc_lr_memo_map__init(pcc_context_t *ctx, pcc_lr_memo_map_t *map) {\n"
             "    map->len = 0;\n"
             "    map->max = 0;\n"
             "    map->buf = NULL;\n"
             "}\n"
             "\n"
-            "static size_t pcc_lr_memo_map__index(pcc_context_t *ctx, pcc_lr_memo_map_t *map, pcc_rule_t rule) {\n"
+            "static size_t pcc_lr_memo_map__index(pcc_context_t *ctx, const pcc_lr_memo_map_t *map, size_t rule) { /* the slot of the rule, or the empty slot for it */\n"
+            "    const size_t mask = map->max - 1;\n"
+            "    size_t i = rule & mask;\n"
+            "    while (map->buf[i].rule != rule && map->buf[i].rule != PCC_VOID_VALUE) i = (i + 1) & mask;\n"
+            "    return i;\n"
+            "}\n"
+            "\n"
+            "static void pcc_lr_memo_map__rehash(pcc_context_t *ctx, pcc_lr_memo_map_t *map, size_t max) {\n"
+            "    pcc_lr_memo_t *const buf = map->buf;\n"
+            "    const size_t n = map->max;\n"
             "    size_t i;\n"
-            "    for (i = 0; i < map->len; i++) {\n"
-            "        if (map->buf[i].rule == rule) return i;\n"
+            "    map->buf = (pcc_lr_memo_t *)pcc_malloc(ctx, sizeof(pcc_lr_memo_t) * max);\n"
+            "    map->max = max;\n"
+            "    for (i = 0; i < max; i++) map->buf[i].rule = PCC_VOID_VALUE;\n"
+            "    for (i = 0; i < n; i++) {\n"
+            "        if (buf[i].rule != PCC_VOID_VALUE) map->buf[pcc_lr_memo_map__index(ctx, map, buf[i].rule)] = buf[i];\n"
             "    }\n"
-            "    return PCC_VOID_VALUE;\n"
+            "    pcc_free(ctx, buf, sizeof(pcc_lr_memo_t) * n);\n"
             "}\n"
             "\n"
-            "static void pcc_lr_memo_map__put(pcc_context_t *ctx, pcc_lr_memo_map_t *map, pcc_rule_t rule, pcc_lr_answer_t *answer) {\n"
-            "    const size_t i = pcc_lr_memo_map__index(ctx, map, rule);\n"
-            "    if (i != PCC_VOID_VALUE) {\n"
-            "        pcc_lr_answer__destroy(ctx, map->buf[i].answer);\n"
-            "        map->buf[i].answer = answer;\n"
-            "    }\n"
-            "    else {\n"
-            "        if (map->max <= map->len) {\n"
-            "            const size_t n = map->len + 1;\n"
-            "            size_t m = map->max;\n"
-            "            if (m == 0) m = PCC_ARRAY_MIN_SIZE;\n"
-            "            while (m < n && m != 0) m <<= 1;\n"
-            "            if (m == 0) m = n;\n"
-            "            map->buf = (pcc_lr_memo_t *)PCC_REALLOC(ctx->auxil, map->buf, sizeof(pcc_lr_memo_t) * m);\n"
-            "            map->max = m;\n"
+            "static void pcc_lr_memo_map__put(pcc_context_t *ctx, pcc_lr_memo_map_t *map, size_t rule, pcc_lr_answer_t *answer) {\n"
+            "    size_t i;\n"
+            "    if (map->max > 0) {\n"
+            "        i = pcc_lr_memo_map__index(ctx, map, rule);\n"
+            "        if (map->buf[i].rule == rule) {\n"
+            "            pcc_lr_answer__destroy(ctx, map->buf[i].answer);\n"
+            "            map->buf[i].answer = answer;\n"
+            "            return;\n"
             "        }\n"
-            "        map->buf[map->len].rule = rule;\n"
-            "        map->buf[map->len].answer = answer;\n"
-            "        map->len++;\n"
             "    }\n"
+            "    if (map->max < (map->len + 1) * 2) { /* keeps the load factor at most 1/2 */\n"
+            "        size_t m = map->max;\n"
+            "        if (m == 0) m = PCC_MEMO_MIN_SIZE;\n"
+            "        while (m < (map->len + 1) * 2) m <<= 1;\n"
+            "        pcc_lr_memo_map__rehash(ctx, map, m);\n"
+            "    }\n"
+            "    i = pcc_lr_memo_map__index(ctx, map, rule);\n"
+            "    map->buf[i].rule = rule;\n"
+            "    map->buf[i].answer = answer;\n"
+            "    map->len++;\n"
             "}\n"
             "\n"
-            "static pcc_lr_answer_t *pcc_lr_memo_map__get(pcc_context_t *ctx, pcc_lr_memo_map_t *map, pcc_rule_t rule) {\n"
-            "    const size_t i = pcc_lr_memo_map__index(ctx, map, rule);\n"
-            "    return (i != PCC_VOID_VALUE) ? map->buf[i].answer : NULL;\n"
+            "static pcc_lr_answer_t *pcc_lr_memo_map__get(pcc_context_t *ctx, pcc_lr_memo_map_t *map, size_t rule) {\n"
+            "    size_t i;\n"
+            "    if (map->max == 0) return NULL;\n"
+            "    i = pcc_lr_memo_map__index(ctx, map, rule);\n"
+            "    return (map->buf[i].rule == rule) ? map->buf[i].answer : NULL;\n"
             "}\n"
             "\n"
             "static void pcc_lr_memo_map__term(pcc_context_t *ctx, pcc_lr_memo_map_t *map) {\n"
-            "    while (map->len > 0) {\n"
-            "        map->len--;\n"
-            "        pcc_lr_answer__destroy(ctx, map->buf[map->len].answer);\n"
+            "    size_t i;\n"
+            "    for (i = 0; i < map->max; i++) {\n"
+            "        if (map->buf[i].rule != PCC_VOID_VALUE) pcc_lr_answer__destroy(ctx, map->buf[i].answer);\n"
             "    }\n"
-            "    PCC_FREE(ctx->auxil, map->buf);\n"
+            "    pcc_free(ctx, map->buf, sizeof(pcc_lr_memo_t) * map->max);\n"
             "}\n"
             "\n"
         );
         stream__puts(
             &sstream,
             "static pcc_lr_table_entry_t *pcc_lr_table_entry__create(pcc_context_t *ctx) {\n"
-            "    pcc_lr_table_entry_t *const entry = (pcc_lr_table_entry_t *)PCC_MALLOC(ctx->auxil, sizeof(pcc_lr_table_entry_t));\n"
+            "    pcc_lr_table_entry_t *const entry = (pcc_lr_table_entry_t *)pcc_malloc(ctx, sizeof(pcc_lr_table_entry_t));\n"
             "    entry->head = NULL;\n"
-            "    pcc_lr_memo_map__init(ctx->auxil, &entry->memos);\n"
+            "    pcc_lr_memo_map__init(ctx, &entry->memos);\n"
             "    entry->hold_a = NULL;\n"
             "    entry->hold_h = NULL;\n"
             "    return entry;\n"
@@ -4176,14 +4686,15 @@ static bool_t generate(context_t *ctx) {
             "    pcc_lr_head__destroy(ctx, entry->hold_h);\n"
             "    pcc_lr_answer__destroy(ctx, entry->hold_a);\n"
             "    pcc_lr_memo_map__term(ctx, &entry->memos);\n"
-            "    PCC_FREE(ctx->auxil, entry);\n"
+            "    pcc_free(ctx, entry, sizeof(pcc_lr_table_entry_t));\n"
             "}\n"
             "\n"
         );
         stream__puts(
             &sstream,
-            "static void pcc_lr_table__init(pcc_auxil_t auxil, pcc_lr_table_t *table) {\n"
+            "static void pcc_lr_table__init(pcc_context_t *ctx, pcc_lr_table_t *table) {\n"
             "    table->ofs = 0;\n"
+            "    table->pos = 0;\n"
             "    table->len = 0;\n"
             "    table->max = 0;\n"
             "    table->buf = NULL;\n"
@@ -4197,7 +4708,7 @@ static bool_t generate(context_t *ctx) {
             "        if (m == 0) m = PCC_ARRAY_MIN_SIZE;\n"
             "        while (m < len && m != 0) m <<= 1;\n"
             "        if (m == 0) m = len;\n"
-            "        table->buf = (pcc_lr_table_entry_t **)PCC_REALLOC(ctx->auxil, table->buf, sizeof(pcc_lr_table_entry_t *) * m);\n"
+            "        table->buf = (pcc_lr_table_entry_t **)pcc_realloc(ctx, table->buf, sizeof(pcc_lr_table_entry_t *) * table->max, sizeof(pcc_lr_table_entry_t *) * m);\n"
             "        table->max = m;\n"
             "    }\n"
             "    for (i = table->len; i < len; i++) table->buf[i] = NULL;\n"
@@ -4205,29 +4716,29 @@ static bool_t generate(context_t *ctx) {
             "}\n"
             "\n"
             "static void pcc_lr_table__set_head(pcc_context_t *ctx, pcc_lr_table_t *table, size_t index, pcc_lr_head_t *head) {\n"
-            "    index += table->ofs;\n"
+            "    index += table->ofs - table->pos;\n"
             "    if (index >= table->len) pcc_lr_table__resize(ctx, table, index + 1);\n"
             "    if (table->buf[index] == NULL) table->buf[index] = pcc_lr_table_entry__create(ctx);\n"
             "    table->buf[index]->head = head;\n"
             "}\n"
             "\n"
             "static void pcc_lr_table__hold_head(pcc_context_t *ctx, pcc_lr_table_t *table, size_t index, pcc_lr_head_t *head) {\n"
-            "    index += table->ofs;\n"
+            "    index += table->ofs - table->pos;\n"
             "    if (index >= table->len) pcc_lr_table__resize(ctx, table, index + 1);\n"
             "    if (table->buf[index] == NULL) table->buf[index] = pcc_lr_table_entry__create(ctx);\n"
             "    head->hold = table->buf[index]->hold_h;\n"
             "    table->buf[index]->hold_h = head;\n"
             "}\n"
             "\n"
-            "static void pcc_lr_table__set_answer(pcc_context_t *ctx, pcc_lr_table_t *table, size_t index, pcc_rule_t rule, pcc_lr_answer_t *answer) {\n"
-            "    index += table->ofs;\n"
+            "static void pcc_lr_table__set_answer(pcc_context_t *ctx, pcc_lr_table_t *table, size_t index, size_t rule, pcc_lr_answer_t *answer) {\n"
+            "    index += table->ofs - table->pos;\n"
             "    if (index >= table->len) pcc_lr_table__resize(ctx, table, index + 1);\n"
             "    if (table->buf[index] == NULL) table->buf[index] = pcc_lr_table_entry__create(ctx);\n"
             "    pcc_lr_memo_map__put(ctx, &table->buf[index]->memos, rule, answer);\n"
             "}\n"
             "\n"
             "static void pcc_lr_table__hold_answer(pcc_context_t *ctx, pcc_lr_table_t *table, size_t index, pcc_lr_answer_t *answer) {\n"
-            "    index += table->ofs;\n"
+            "    index += table->ofs - table->pos;\n"
             "    if (index >= table->len) pcc_lr_table__resize(ctx, table, index + 1);\n"
             "    if (table->buf[index] == NULL) table->buf[index] = pcc_lr_table_entry__create(ctx);\n"
             "    answer->hold = table->buf[index]->hold_a;\n"
@@ -4235,21 +4746,24 @@ static bool_t generate(context_t *ctx) {
             "}\n"
             "\n"
             "static pcc_lr_head_t *pcc_lr_table__get_head(pcc_context_t *ctx, pcc_lr_table_t *table, size_t index) {\n"
-            "    index += table->ofs;\n"
+            "    if (index < table->pos) return NULL;\n"
+            "    index += table->ofs - table->pos;\n"
             "    if (index >= table->len || table->buf[index] == NULL) return NULL;\n"
             "    return table->buf[index]->head;\n"
             "}\n"
             "\n"
-            "static pcc_lr_answer_t *pcc_lr_table__get_answer(pcc_context_t *ctx, pcc_lr_table_t *table, size_t index, pcc_rule_t rule) {\n"
-            "    index += table->ofs;\n"
+            "static pcc_lr_answer_t *pcc_lr_table__get_answer(pcc_context_t *ctx, pcc_lr_table_t *table, size_t index, size_t rule) {\n"
+            "    if (index < table->pos) return NULL;\n"
+            "    index += table->ofs - table->pos;\n"
             "    if (index >= table->len || table->buf[index] == NULL) return NULL;\n"
             "    return pcc_lr_memo_map__get(ctx, &table->buf[index]->memos, rule);\n"
             "}\n"
             "\n"
-            "static void pcc_lr_table__shift(pcc_context_t *ctx, pcc_lr_table_t *table, size_t count) {\n"
-            "    size_t i;\n"
+            "static void pcc_lr_table__shift(pcc_context_t *ctx, pcc_lr_table_t *table, size_t pos) {\n"
+            "    size_t i, count = pos - table->pos;\n"
             "    if (count > table->len - table->ofs) count = table->len - table->ofs;\n"
             "    for (i = 0; i < count; i++) pcc_lr_table_entry__destroy(ctx, table->buf[table->ofs++]);\n"
+            "    table->pos = pos;\n"
             "    if (table->ofs > (table->max >> 1)) {\n"
             "        memmove(table->buf, table->buf + table->ofs, sizeof(pcc_lr_table_entry_t *) * (table->len - table->ofs));\n"
             "        table->len -= table->ofs;\n"
@@ -4257,57 +4771,59 @@ static bool_t generate(context_t *ctx) {
             "    }\n"
             "}\n"
             "\n"
+            "MARK_FUNC_AS_USED\n"
             "static void pcc_lr_table__term(pcc_context_t *ctx, pcc_lr_table_t *table) {\n"
             "    while (table->len > table->ofs) {\n"
             "        table->len--;\n"
             "        pcc_lr_table_entry__destroy(ctx, table->buf[table->len]);\n"
             "    }\n"
-            "    PCC_FREE(ctx->auxil, table->buf);\n"
+            "    pcc_free(ctx, table->buf, sizeof(pcc_lr_table_entry_t *) * table->max);\n"
             "}\n"
             "\n"
         );
         stream__puts(
             &sstream,
-            "static pcc_lr_entry_t *pcc_lr_entry__create(pcc_auxil_t auxil, pcc_rule_t rule) {\n"
-            "    pcc_lr_entry_t *const lr = (pcc_lr_entry_t *)PCC_MALLOC(auxil, sizeof(pcc_lr_entry_t));\n"
+            "static pcc_lr_entry_t *pcc_lr_entry__create(pcc_context_t *ctx, pcc_rule_t rule) {\n"
+            "    pcc_lr_entry_t *const lr = (pcc_lr_entry_t *)pcc_malloc(ctx, sizeof(pcc_lr_entry_t));\n"
             "    lr->rule = rule;\n"
             "    lr->seed = NULL;\n"
             "    lr->head = NULL;\n"
             "    return lr;\n"
             "}\n"
             "\n"
-            "static void pcc_lr_entry__destroy(pcc_auxil_t auxil, pcc_lr_entry_t *lr) {\n"
-            "    PCC_FREE(auxil, lr);\n"
+            "static void pcc_lr_entry__destroy(pcc_context_t *ctx, pcc_lr_entry_t *lr) {\n"
+            "    pcc_free(ctx, lr, sizeof(pcc_lr_entry_t));\n"
             "}\n"
             "\n"
         );
         stream__puts(
             &sstream,
-            "static void pcc_lr_stack__init(pcc_auxil_t auxil, pcc_lr_stack_t *stack) {\n"
+            "static void pcc_lr_stack__init(pcc_context_t *ctx, pcc_lr_stack_t *stack) {\n"
             "    stack->len = 0;\n"
             "    stack->max = 0;\n"
             "    stack->buf = NULL;\n"
             "}\n"
             "\n"
-            "static void pcc_lr_stack__push(pcc_auxil_t auxil, pcc_lr_stack_t *stack, pcc_lr_entry_t *lr) {\n"
+            "static void pcc_lr_stack__push(pcc_context_t *ctx, pcc_lr_stack_t *stack, pcc_lr_entry_t *lr) {\n"
             "    if (stack->max <= stack->len) {\n"
             "        const size_t n = stack->len + 1;\n"
             "        size_t m = stack->max;\n"
             "        if (m == 0) m = PCC_ARRAY_MIN_SIZE;\n"
             "        while (m < n && m != 0) m <<= 1;\n"
             "        if (m == 0) m = n;\n"
-            "        stack->buf = (pcc_lr_entry_t **)PCC_REALLOC(auxil, stack->buf, sizeof(pcc_lr_entry_t *) * m);\n"
+            "        stack->buf = (pcc_lr_entry_t **)pcc_realloc(ctx, stack->buf, sizeof(pcc_lr_entry_t *) * stack->max, sizeof(pcc_lr_entry_t *) * m);\n"
             "        stack->max = m;\n"
             "    }\n"
             "    stack->buf[stack->len++] = lr;\n"
             "}\n"
             "\n"
-            "static pcc_lr_entry_t *pcc_lr_stack__pop(pcc_auxil_t auxil, pcc_lr_stack_t *stack) {\n"
+            "static pcc_lr_entry_t *pcc_lr_stack__pop(pcc_context_t *ctx, pcc_lr_stack_t *stack) {\n"
             "    return stack->buf[--stack->len];\n"
             "}\n"
             "\n"
-            "static void pcc_lr_stack__term(pcc_auxil_t auxil, pcc_lr_stack_t *stack) {\n"
-            "    PCC_FREE(auxil, stack->buf);\n"
+            "MARK_FUNC_AS_USED\n"
+            "static void pcc_lr_stack__term(pcc_context_t *ctx, pcc_lr_stack_t *stack) {\n"
+            "    pcc_free(ctx, stack->buf, sizeof(pcc_lr_entry_t *) * stack->max);\n"
             "}\n"
             "\n"
         );
@@ -4315,32 +4831,55 @@ static bool_t generate(context_t *ctx) {
             &sstream,
             "static pcc_context_t *pcc_context__create(pcc_auxil_t auxil) {\n"
             "    pcc_context_t *const ctx = (pcc_context_t *)PCC_MALLOC(auxil, sizeof(pcc_context_t));\n"
+            "    ctx->auxil = auxil;\n"
+            "#ifdef PCC_USE_ARENA\n"
+            "    pcc_arena__init(ctx);\n"
+            "#endif /* PCC_USE_ARENA */\n"
             "    ctx->pos = 0;\n"
             "    ctx->cur = 0;\n"
             "    ctx->level = 0;\n"
             "    pcc_char_array__init(auxil, &ctx->buffer);\n"
-            "    pcc_lr_table__init(auxil, &ctx->lrtable);\n"
-            "    pcc_lr_stack__init(auxil, &ctx->lrstack);\n"
-            "    pcc_thunk_array__init(auxil, &ctx->thunks);\n"
-            "    pcc_memory_recycler__init(auxil, &ctx->thunk_chunk_recycler, sizeof(pcc_thunk_chunk_t));\n"
-            "    pcc_memory_recycler__init(auxil, &ctx->lr_head_recycler, sizeof(pcc_lr_head_t));\n"
-            "    pcc_memory_recycler__init(auxil, &ctx->lr_answer_recycler, sizeof(pcc_lr_answer_t));\n"
-            "    ctx->auxil = auxil;\n"
+            "#ifdef PCC_INPUT\n"
+            "    ctx->buffer.buf = (char *)PCC_INPUT(auxil);\n"
+            "    ctx->buffer.len = PCC_INPUT_LENGTH(auxil);\n"
+            "#endif /* PCC_INPUT */\n"
+            "    pcc_lr_table__init(ctx, &ctx->lrtable);\n"
+            "    pcc_lr_stack__init(ctx, &ctx->lrstack);\n"
+            "    pcc_thunk_array__init(ctx, &ctx->thunks);\n"
+            "    pcc_memory_recycler__init(ctx, &ctx->thunk_chunk_recycler, sizeof(pcc_thunk_chunk_t));\n"
+            "    pcc_memory_recycler__init(ctx, &ctx->lr_head_recycler, sizeof(pcc_lr_head_t));\n"
+            "    pcc_memory_recycler__init(ctx, &ctx->lr_answer_recycler, sizeof(pcc_lr_answer_t));\n"
             "    return ctx;\n"
             "}\n"
             "\n"
+            "#ifdef PCC_USE_ARENA\n"
+            "static void pcc_context__reset(pcc_context_t *ctx) { /* releases all the memory of the parse at once */\n"
+            "    pcc_lr_table__init(ctx, &ctx->lrtable);\n"
+            "    pcc_lr_stack__init(ctx, &ctx->lrstack);\n"
+            "    pcc_thunk_array__init(ctx, &ctx->thunks);\n"
+            "    pcc_memory_recycler__init(ctx, &ctx->thunk_chunk_recycler, sizeof(pcc_thunk_chunk_t));\n"
+            "    pcc_memory_recycler__init(ctx, &ctx->lr_head_recycler, sizeof(pcc_lr_head_t));\n"
+            "    pcc_memory_recycler__init(ctx, &ctx->lr_answer_recycler, sizeof(pcc_lr_answer_t));\n"
+            "    pcc_arena__reset(ctx);\n"
+            "}\n"
+            "#endif /* PCC_USE_ARENA */\n"
+            "\n"
         );
         stream__puts(
             &sstream,
             "static void pcc_context__destroy(pcc_context_t *ctx) {\n"
             "    if (ctx == NULL) return;\n"
-            "    pcc_thunk_array__term(ctx->auxil, &ctx->thunks);\n"
-            "    pcc_lr_stack__term(ctx->auxil, &ctx->lrstack);\n"
+            "#ifdef PCC_USE_ARENA\n"
+            "    pcc_arena__term(ctx);\n"
+            "#else /* !PCC_USE_ARENA */\n"
+            "    pcc_thunk_array__term(ctx, &ctx->thunks);\n"
+            "    pcc_lr_stack__term(ctx, &ctx->lrstack);\n"
             "    pcc_lr_table__term(ctx, &ctx->lrtable);\n"
+            "    pcc_memory_recycler__term(ctx, &ctx->thunk_chunk_recycler);\n"
+            "    pcc_memory_recycler__term(ctx, &ctx->lr_head_recycler);\n"
+            "    pcc_memory_recycler__term(ctx, &ctx->lr_answer_recycler);\n"
+            "#endif /* PCC_USE_ARENA */\n"
             "    pcc_char_array__term(ctx->auxil, &ctx->buffer);\n"
-            "    pcc_memory_recycler__term(ctx->auxil, &ctx->thunk_chunk_recycler);\n"
-            "    pcc_memory_recycler__term(ctx->auxil, &ctx->lr_head_recycler);\n"
-            "    pcc_memory_recycler__term(ctx->auxil, &ctx->lr_answer_recycler);\n"
             "    PCC_FREE(ctx->auxil, ctx);\n"
             "}\n"
             "\n"
@@ -4348,6 +4887,19 @@ static bool_t generate(context_t *ctx) {
         stream__puts(
             &sstream,
             "static size_t pcc_refill_buffer(pcc_context_t *ctx, size_t num) {\n"
+            "#if defined PCC_INPUT\n"
+            "    return ctx->buffer.len - ctx->cur;\n"
+            "#elif defined PCC_READ\n"
+            "    if (ctx->buffer.len >= ctx->cur + num) return ctx->buffer.len - ctx->cur;\n"
+            "    while (ctx->buffer.len < ctx->cur + num) {\n"
+            "        size_t n;\n"
+            "        pcc_char_array__reserve(ctx->auxil, &ctx->buffer, ctx->cur + num);\n"
+            "        n = PCC_READ(ctx->auxil, ctx->buffer.buf + (ctx->buffer.len - ctx->buffer.ofs), ctx->buffer.max - ctx->buffer.len);\n"
+            "        if (n == 0) break;\n"
+            "        ctx->buffer.len += n;\n"
+            "    }\n"
+            "    return ctx->buffer.len - ctx->cur;\n"
+            "#else\n"
             "    if (ctx->buffer.len >= ctx->cur + num) return ctx->buffer.len - ctx->cur;\n"
             "    while (ctx->buffer.len < ctx->cur + num) {\n"
             "        const int c = PCC_GETCHAR(ctx->auxil);\n"
@@ -4355,6 +4907,7 @@ static bool_t generate(context_t *ctx) {
             "        pcc_char_array__add(ctx->auxil, &ctx->buffer, (char)c);\n"
             "    }\n"
             "    return ctx->buffer.len - ctx->cur;\n"
+            "#endif\n"
             "}\n"
             "\n"
         );
@@ -4362,10 +4915,17 @@ static bool_t generate(context_t *ctx) {
             &sstream,
             "MARK_FUNC_AS_USED\n"
             "static void pcc_commit_buffer(pcc_context_t *ctx) {\n"
-            "    memmove(ctx->buffer.buf, ctx->buffer.buf + ctx->cur, ctx->buffer.len - ctx->cur);\n"
+            "#ifdef PCC_INPUT\n"
+            "    ctx->buffer.buf += ctx->cur;\n"
+            "#else /* !PCC_INPUT */\n"
+            "    if (ctx->buffer.len > ctx->cur)\n"
+            "        memmove(ctx->buffer.buf, pcc_char_array__at(&ctx->buffer, ctx->cur), ctx->buffer.len - ctx->cur);\n"
+            "    ctx->buffer.max -= ctx->buffer.ofs;\n"
+            "    ctx->buffer.ofs = 0;\n"
+            "#endif /* PCC_INPUT */\n"
             "    ctx->buffer.len -= ctx->cur;\n"
             "    ctx->pos += ctx->cur;\n"
-            "    pcc_lr_table__shift(ctx, &ctx->lrtable, ctx->cur);\n"
+            "    pcc_lr_table__shift(ctx, &ctx->lrtable, ctx->pos);\n"
             "    ctx->cur = 0;\n"
             "}\n"
             "\n"
@@ -4376,7 +4936,7 @@ static bool_t generate(context_t *ctx) {
             "static const char *pcc_get_capture_string(pcc_context_t *ctx, const pcc_capture_t *capt) {\n"
             "    if (capt->string == NULL)\n"
             "        ((pcc_capture_t *)capt)->string =\n"
-            "            pcc_strndup_e(ctx->auxil, ctx->buffer.buf + capt->range.start, capt->range.end - capt->range.start);\n"
+            "            pcc_strndup_e(ctx, pcc_char_array__at(&ctx->buffer, capt->range.start), capt->range.end - capt->range.start);\n"
             "    return capt->string;\n"
             "}\n"
             "\n"
@@ -4388,7 +4948,7 @@ static bool_t generate(context_t *ctx) {
                 "    int c, u;\n"
                 "    size_t n;\n"
                 "    if (pcc_refill_buffer(ctx, 1) < 1) return 0;\n"
-                "    c = (int)(unsigned char)ctx->buffer.buf[ctx->cur];\n"
+                "    c = (int)(unsigned char)pcc_char_array__at(&ctx->buffer, ctx->cur)[0];\n"
                 "    n = (c < 0x80) ? 1 :\n"
                 "        ((c & 0xe0) == 0xc0) ? 2 :\n"
                 "        ((c & 0xf0) == 0xe0) ? 3 :\n"
@@ -4401,30 +4961,30 @@ static bool_t generate(context_t *ctx) {
                 "        break;\n"
                 "    case 2:\n"
                 "        u = c & 0x1f;\n"
-                "        c = (int)(unsigned char)ctx->buffer.buf[ctx->cur + 1];\n"
+                "        c = (int)(unsigned char)pcc_char_array__at(&ctx->buffer, ctx->cur)[1];\n"
                 "        if ((c & 0xc0) != 0x80) return 0;\n"
                 "        u <<= 6; u |= c & 0x3f;\n"
                 "        if (u < 0x80) return 0;\n"
                 "        break;\n"
                 "    case 3:\n"
                 "        u = c & 0x0f;\n"
-                "        c = (int)(unsigned char)ctx->buffer.buf[ctx->cur + 1];\n"
+                "        c = (int)(unsigned char)pcc_char_array__at(&ctx->buffer, ctx->cur)[1];\n"
                 "        if ((c & 0xc0) != 0x80) return 0;\n"
                 "        u <<= 6; u |= c & 0x3f;\n"
-                "        c = (int)(unsigned char)ctx->buffer.buf[ctx->cur + 2];\n"
+                "        c = (int)(unsigned char)pcc_char_array__at(&ctx->buffer, ctx->cur)[2];\n"
                 "        if ((c & 0xc0) != 0x80) return 0;\n"
                 "        u <<= 6; u |= c & 0x3f;\n"
                 "        if (u < 0x800) return 0;\n"
                 "        break;\n"
                 "    case 4:\n"
                 "        u = c & 0x07;\n"
-                "        c = (int)(unsigned char)ctx->buffer.buf[ctx->cur + 1];\n"
+                "        c = (int)(unsigned char)pcc_char_array__at(&ctx->buffer, ctx->cur)[1];\n"
                 "        if ((c & 0xc0) != 0x80) return 0;\n"
                 "        u <<= 6; u |= c & 0x3f;\n"
-                "        c = (int)(unsigned char)ctx->buffer.buf[ctx->cur + 2];\n"
+                "        c = (int)(unsigned char)pcc_char_array__at(&ctx->buffer, ctx->cur)[2];\n"
                 "        if ((c & 0xc0) != 0x80) return 0;\n"
                 "        u <<= 6; u |= c & 0x3f;\n"
-                "        c = (int)(unsigned char)ctx->buffer.buf[ctx->cur + 3];\n"
+                "        c = (int)(unsigned char)pcc_char_array__at(&ctx->buffer, ctx->cur)[3];\n"
                 "        if ((c & 0xc0) != 0x80) return 0;\n"
                 "        u <<= 6; u |= c & 0x3f;\n"
                 "        if (u < 0x10000 || u > 0x10ffff) return 0;\n"
@@ -4441,19 +5001,19 @@ static bool_t generate(context_t *ctx) {
         stream__puts(
             &sstream,
             "MARK_FUNC_AS_USED\n"
-            "static pcc_bool_t pcc_apply_rule(pcc_context_t *ctx, pcc_rule_t rule, pcc_thunk_array_t *thunks, pcc_value_t *value) {\n"
+            "static pcc_bool_t pcc_apply_rule(pcc_context_t *ctx, pcc_rule_t rule, size_t index, pcc_thunk_array_t *thunks, pcc_value_t *value) {\n"
             "    static pcc_value_t null;\n"
             "    pcc_thunk_chunk_t *c = NULL;\n"
             "    const size_t p = ctx->pos + ctx->cur;\n"
             "    pcc_bool_t b = PCC_TRUE;\n"
-            "    pcc_lr_answer_t *a = pcc_lr_table__get_answer(ctx, &ctx->lrtable, p, rule);\n"
+            "    pcc_lr_answer_t *a = pcc_lr_table__get_answer(ctx, &ctx->lrtable, p, index);\n"
             "    pcc_lr_head_t *h = pcc_lr_table__get_head(ctx, &ctx->lrtable, p);\n"
             "    if (h != NULL) {\n"
-            "        if (a == NULL && rule != h->rule && pcc_rule_set__index(ctx->auxil, &h->invol, rule) == PCC_VOID_VALUE) {\n"
+            "        if (a == NULL && rule != h->rule && pcc_rule_set__index(ctx, &h->invol, rule) == PCC_VOID_VALUE) {\n"
             "            b = PCC_FALSE;\n"
             "            c = NULL;\n"
             "        }\n"
-            "        else if (pcc_rule_set__remove(ctx->auxil, &h->eval, rule)) {\n"
+            "        else if (pcc_rule_set__remove(ctx, &h->eval, rule)) {\n"
             "            b = PCC_FALSE;\n"
             "            c = rule(ctx);\n"
             "            a = pcc_lr_answer__create(ctx, PCC_LR_ANSWER_CHUNK, ctx->pos + ctx->cur);\n"
@@ -4476,7 +5036,7 @@ static bool_t generate(context_t *ctx) {
             "                        i--;\n"
             "                        if (ctx->lrstack.buf[i]->head == a->data.lr->head) break;\n"
             "                        ctx->lrstack.buf[i]->head = a->data.lr->head;\n"
-            "                        pcc_rule_set__add(ctx->auxil, &a->data.lr->head->invol, ctx->lrstack.buf[i]->rule);\n"
+            "                        pcc_rule_set__add(ctx, &a->data.lr->head->invol, ctx->lrstack.buf[i]->rule);\n"
             "                    }\n"
             "                }\n"
             "                c = a->data.lr->seed;\n"
@@ -4489,13 +5049,13 @@ static bool_t generate(context_t *ctx) {
             "            }\n"
             "        }\n"
             "        else {\n"
-            "            pcc_lr_entry_t *const e = pcc_lr_entry__create(ctx->auxil, rule);\n"
-            "            pcc_lr_stack__push(ctx->auxil, &ctx->lrstack, e);\n"
+            "            pcc_lr_entry_t *const e = pcc_lr_entry__create(ctx, rule);\n"
+            "            pcc_lr_stack__push(ctx, &ctx->lrstack, e);\n"
             "            a = pcc_lr_answer__create(ctx, PCC_LR_ANSWER_LR, p);\n"
             "            a->data.lr = e;\n"
-            "            pcc_lr_table__set_answer(ctx, &ctx->lrtable, p, rule, a);\n"
+            "            pcc_lr_table__set_answer(ctx, &ctx->lrtable, p, index, a);\n"
             "            c = rule(ctx);\n"
-            "            pcc_lr_stack__pop(ctx->auxil, &ctx->lrstack);\n"
+            "            pcc_lr_stack__pop(ctx, &ctx->lrstack);\n"
             "            a->pos = ctx->pos + ctx->cur;\n"
             "            if (e->head == NULL) {\n"
             "                pcc_lr_answer__set_chunk(ctx, a, c);\n"
@@ -4518,7 +5078,7 @@ static bool_t generate(context_t *ctx) {
             "                        pcc_lr_table__set_head(ctx, &ctx->lrtable, p, h);\n"
             "                        for (;;) {\n"
             "                            ctx->cur = p - ctx->pos;\n"
-            "                            pcc_rule_set__copy(ctx->auxil, &h->eval, &h->invol);\n"
+            "                            pcc_rule_set__copy(ctx, &h->eval, &h->invol);\n"
             "                            c = rule(ctx);\n"
             "                            if (c == NULL || ctx->pos + ctx->cur <= a->pos) break;\n"
             "                            pcc_lr_answer__set_chunk(ctx, a, c);\n"
@@ -4536,7 +5096,21 @@ static bool_t generate(context_t *ctx) {
             "    if (c == NULL) return PCC_FALSE;\n"
             "    if (value == NULL) value = &null;\n"
             "    memset(value, 0, sizeof(pcc_value_t)); /* in case */\n"
-            "    pcc_thunk_array__add(ctx->auxil, thunks, pcc_thunk__create_node(ctx->auxil, &c->thunks, value));\n"
+            "    pcc_thunk_array__add(ctx, thunks, pcc_thunk__create_node(ctx, &c->thunks, value));\n"
+            "    return PCC_TRUE;\n"
+            "}\n"
+            "\n"
+            "MARK_FUNC_AS_USED\n"
+            "static pcc_bool_t pcc_call_rule(pcc_context_t *ctx, pcc_rule_t rule, pcc_thunk_array_t *thunks, pcc_value_t *value) {\n"
+            "    static pcc_value_t null;\n"
+            "    pcc_thunk_chunk_t *const c = rule(ctx);\n"
+            "    pcc_thunk_t *thunk;\n"
+            "    if (c == NULL) return PCC_FALSE;\n"
+            "    if (value == NULL) value = &null;\n"
+            "    memset(value, 0, sizeof(pcc_value_t)); /* in case */\n"
+            "    thunk = pcc_thunk__create_node(ctx, &c->thunks, value);\n"
+            "    thunk->data.node.chunk = c;\n"
+            "    pcc_thunk_array__add(ctx, thunks, thunk);\n"
             "    return PCC_TRUE;\n"
             "}\n"
             "\n"
@@ -4562,6 +5136,23 @@ static bool_t generate(context_t *ctx) {
             "}\n"
             "\n"
         );
+        if (ctx->commit != NULL) {
+            stream__puts(
+                &sstream,
+                "static void pcc_commit_window(pcc_context_t *ctx, pcc_thunk_chunk_t *chunk) {\n"
+                "    /* the start rule can no longer backtrack behind the current position */\n"
+                "    pcc_do_action(ctx, &chunk->thunks, NULL);\n"
+                "    pcc_thunk_array__revert(ctx, &chunk->thunks, 0);\n"
+                "    chunk->pos = ctx->cur;\n"
+                "    pcc_lr_table__shift(ctx, &ctx->lrtable, ctx->pos + ctx->cur);\n"
+                "#ifndef PCC_INPUT\n"
+                "    if (ctx->cur - ctx->buffer.ofs >= ctx->buffer.len - ctx->cur) /* amortizes the moves to the dropped characters */\n"
+                "        pcc_char_array__drop(ctx->auxil, &ctx->buffer, ctx->cur);\n"
+                "#endif /* !PCC_INPUT */\n"
+                "}\n"
+                "\n"
+            );
+        }
         {
             size_t i, j, k;
             for (i = 0; i < ctx->rules.len; i++) {
@@ -4686,6 +5277,7 @@ static bool_t generate(context_t *ctx) {
         {
             size_t i;
             for (i = 0; i < ctx->rules.len; i++) {
+                if (i > 0 && is_inlined_rule(ctx->rules.buf[i])) continue;
                 stream__printf(
                     &sstream,
                     "static pcc_thunk_chunk_t *pcc_evaluate_rule_%s(pcc_context_t *ctx);\n",
@@ -4699,6 +5291,7 @@ static bool_t generate(context_t *ctx) {
             for (i = 0; i < ctx->rules.len; i++) {
                 code_reach_t r;
                 generate_t g;
+                if (i > 0 && is_inlined_rule(ctx->rules.buf[i])) continue; /* the start rule is called by the API function */
                 g.stream = &sstream;
                 g.rule = ctx->rules.buf[i];
                 g.label = 0;
@@ -4712,31 +5305,31 @@ static bool_t generate(context_t *ctx) {
                     &sstream,
                     "    pcc_thunk_chunk_t *const chunk = pcc_thunk_chunk__create(ctx);\n"
                     "    chunk->pos = ctx->cur;\n"
-                    "    PCC_DEBUG(ctx->auxil, PCC_DBG_EVALUATE, \"%s\", ctx->level, chunk->pos, (ctx->buffer.buf + chunk->pos), (ctx->buffer.len - chunk->pos));\n"
+                    "    PCC_DEBUG(ctx->auxil, PCC_DBG_EVALUATE, \"%s\", ctx->level, chunk->pos, pcc_char_array__at(&ctx->buffer, chunk->pos), (ctx->buffer.len - chunk->pos));\n"
                     "    ctx->level++;\n",
                     ctx->rules.buf[i]->data.rule.name
                 );
                 stream__printf(
                     &sstream,
-                    "    pcc_value_table__resize(ctx->auxil, &chunk->values, " FMT_LU ");\n",
+                    "    pcc_value_table__resize(ctx, &chunk->values, " FMT_LU ");\n",
                     (ulong_t)ctx->rules.buf[i]->data.rule.vars.len
                 );
                 stream__printf(
                     &sstream,
-                    "    pcc_capture_table__resize(ctx->auxil, &chunk->capts, " FMT_LU ");\n",
+                    "    pcc_capture_table__resize(ctx, &chunk->capts, " FMT_LU ");\n",
                     (ulong_t)ctx->rules.buf[i]->data.rule.capts.len
                 );
                 if (ctx->rules.buf[i]->data.rule.vars.len > 0) {
                     stream__puts(
                         &sstream,
-                        "    pcc_value_table__clear(ctx->auxil, &chunk->values);\n"
+                        "    pcc_value_table__clear(ctx, &chunk->values);\n"
                     );
                 }
                 r = generate_code(&g, ctx->rules.buf[i]->data.rule.expr, 0, 4, FALSE);
                 stream__printf(
                     &sstream,
                     "    ctx->level--;\n"
-                    "    PCC_DEBUG(ctx->auxil, PCC_DBG_MATCH, \"%s\", ctx->level, chunk->pos, (ctx->buffer.buf + chunk->pos), (ctx->cur - chunk->pos));\n"
+                    "    PCC_DEBUG(ctx->auxil, PCC_DBG_MATCH, \"%s\", ctx->level, chunk->pos, pcc_char_array__at(&ctx->buffer, chunk->pos), (ctx->cur - chunk->pos));\n"
                     "    return chunk;\n",
                     ctx->rules.buf[i]->data.rule.name
                 );
@@ -4745,7 +5338,7 @@ static bool_t generate(context_t *ctx) {
                         &sstream,
                         "L0000:;\n"
                         "    ctx->level--;\n"
-                        "    PCC_DEBUG(ctx->auxil, PCC_DBG_NOMATCH, \"%s\", ctx->level, chunk->pos, (ctx->buffer.buf + chunk->pos), (ctx->cur - chunk->pos));\n"
+                        "    PCC_DEBUG(ctx->auxil, PCC_DBG_NOMATCH, \"%s\", ctx->level, chunk->pos, pcc_char_array__at(&ctx->buffer, chunk->pos), (ctx->cur - chunk->pos));\n"
                         "    pcc_thunk_chunk__destroy(ctx, chunk);\n"
                         "    return NULL;\n",
                         ctx->rules.buf[i]->data.rule.name
@@ -4776,23 +5369,51 @@ static bool_t generate(context_t *ctx) {
             get_prefix(ctx), get_prefix(ctx),
             vt, vp ? "" : " "
         );
-        if (ctx->rules.len > 0) {
+        if (ctx->rules.len > 0 && ctx->commit != NULL) {
             stream__printf(
                 &sstream,
-                "    if (pcc_apply_rule(ctx, pcc_evaluate_rule_%s, &ctx->thunks, ret))\n",
+                "    {\n"
+                "        pcc_thunk_chunk_t *const c = pcc_evaluate_rule_%s(ctx); /* not memoized, since its position is evicted from the memo table */\n"
+                "        if (ret != NULL) memset(ret, 0, sizeof(pcc_value_t)); /* in case */\n"
+                "        if (c != NULL) {\n"
+                "            pcc_do_action(ctx, &c->thunks, ret);\n"
+                "            pcc_thunk_chunk__destroy(ctx, c);\n"
+                "        }\n"
+                "        else {\n"
+                "            PCC_ERROR(ctx->auxil);\n"
+                "            if (ctx->pos + ctx->cur < ctx->lrtable.pos) ctx->cur = ctx->lrtable.pos - ctx->pos; /* the committed input is consumed */\n"
+                "        }\n"
+                "    }\n",
                 ctx->rules.buf[0]->data.rule.name
             );
+        }
+        else if (ctx->rules.len > 0) {
+            stream__printf(
+                &sstream,
+                "    if (pcc_apply_rule(ctx, pcc_evaluate_rule_%s, " FMT_LU ", &ctx->thunks, ret))\n",
+                ctx->rules.buf[0]->data.rule.name, (ulong_t)ctx->rules.buf[0]->data.rule.index
+            );
             stream__puts(
                 &sstream,
                 "        pcc_do_action(ctx, &ctx->thunks, ret);\n"
                 "    else\n"
                 "        PCC_ERROR(ctx->auxil);\n"
+            );
+        }
+        if (ctx->rules.len > 0) {
+            stream__puts(
+                &sstream,
+                "#ifdef PCC_USE_ARENA\n"
+                "    pcc_context__reset(ctx); /* drops the memo table before committing, which would destroy its entries one by one */\n"
+                "#endif /* PCC_USE_ARENA */\n"
                 "    pcc_commit_buffer(ctx);\n"
             );
         }
         stream__puts(
             &sstream,
-            "    pcc_thunk_array__revert(ctx->auxil, &ctx->thunks, 0);\n"
+            "#ifndef PCC_USE_ARENA\n"
+            "    pcc_thunk_array__revert(ctx, &ctx->thunks, 0);\n"
+            "#endif /* !PCC_USE_ARENA */\n"
             "    return pcc_refill_buffer(ctx, 1) >= 1;\n"
             "}\n"
             "\n"
@@ -0,0 +1,179 @@
+#include <stdlib.h>
+#include <string.h>
+#include "relex.h"
+
+void init_relex_buf(RelexBuf* tokens) {
+    memset(tokens, 0, sizeof(*tokens));
+}
+
+void free_relex_buf(RelexBuf* tokens) {
+    free(tokens->buf);
+    init_relex_buf(tokens);
+}
+
+// recorded_token returns the token at the given index as it is recorded,
+// with the start of a token after the gap not yet shifted.
+static inline const Token* recorded_token(const RelexBuf* tokens, size_t i) {
+    return i < tokens->gap ? &tokens->buf[i] : &tokens->buf[tokens->gap_end + (i - tokens->gap)];
+}
+
+// relex_start returns the start of the token at the given index.
+static inline size_t relex_start(const RelexBuf* tokens, size_t i) {
+    return recorded_token(tokens, i)->start + (i < tokens->gap ? 0 : tokens->shift);
+}
+
+// relex_end returns the end of the token at the given index.
+static inline size_t relex_end(const RelexBuf* tokens, size_t i) {
+    return relex_start(tokens, i) + recorded_token(tokens, i)->len;
+}
+
+// kept_tokens returns the number of leading tokens that end at least
+// LEXER_LOOKAHEAD bytes before `offset`.
+static size_t kept_tokens(const RelexBuf* tokens, size_t offset) {
+    size_t lo = 0, hi = relex_len(tokens);
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (relex_end(tokens, mid) + LEXER_LOOKAHEAD <= offset) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// first_token_from returns the index of the first token that starts at or
+// after `offset`, from the index `from` on.
+static size_t first_token_from(const RelexBuf* tokens, size_t from, size_t offset) {
+    size_t lo = from, hi = relex_len(tokens);
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (relex_start(tokens, mid) < offset) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// move_gap moves the gap to the given index, recording the starts of the
+// tokens that cross it relative to their side.
+static void move_gap(RelexBuf* tokens, size_t index) {
+    while (tokens->gap > index) {
+        Token* token = &tokens->buf[--tokens->gap_end];
+        *token = tokens->buf[--tokens->gap];
+        token->start -= tokens->shift;
+    }
+    while (tokens->gap < index) {
+        Token* token = &tokens->buf[tokens->gap++];
+        *token = tokens->buf[tokens->gap_end++];
+        token->start += tokens->shift;
+    }
+}
+
+// reserve_gap makes room for at least `size` tokens in the gap.
+static bool reserve_gap(RelexBuf* tokens, size_t size) {
+    if (tokens->gap_end - tokens->gap >= size) {
+        return true;
+    }
+    size_t after = tokens->cap - tokens->gap_end;
+    size_t len = tokens->gap + after;
+    size_t cap = tokens->cap == 0 ? 256 : tokens->cap;
+    while (cap < len + size) {
+        cap <<= 1;
+    }
+    Token* buf = realloc(tokens->buf, cap * sizeof(Token));
+    if (buf == NULL) {
+        return false;
+    }
+    memmove(buf + cap - after, buf + tokens->gap_end, after * sizeof(Token));
+    tokens->buf = buf;
+    tokens->cap = cap;
+    tokens->gap_end = cap - after;
+    return true;
+}
+
+// finish_relex lexes the last token again for the state it leaves, which
+// is not recorded in the tokens.
+static TokenKind finish_relex(LexerState* state, const RelexBuf* tokens) {
+    state->current = state->source + relex_start(tokens, relex_len(tokens) - 1);
+    state->error = LEXER_EOK;
+    return next_token(state);
+}
+
+TokenKind relex_all(LexerState* state, RelexBuf* tokens) {
+    tokens->gap = 0;
+    tokens->gap_end = tokens->cap;
+    tokens->shift = 0;
+    return relex_edit(state, tokens, (LexerEdit){ 0, 0, state->end - state->source });
+}
+
+TokenKind relex_edit(LexerState* state, RelexBuf* tokens, LexerEdit edit) {
+    size_t old_end = edit.offset + edit.deleted;
+    size_t new_end = edit.offset + edit.inserted;
+    free_lexer_state(state);
+    Arena* strings = state->strings;
+    state->strings = NULL;
+
+    // The new tokens replace the old ones from `kept` to `next`.
+    size_t len = relex_len(tokens);
+    size_t kept = kept_tokens(tokens, edit.offset);
+    if (kept > 0 && recorded_token(tokens, kept - 1)->kind == TOKEN_ERROR) {
+        // The error of a string may depend on the source up to its closing
+        // quote, far past the end of the token.
+        kept--;
+    }
+    size_t next = first_token_from(tokens, kept, old_end);
+    TokenBuf fresh;
+    init_token_buf(&fresh);
+    const Token* last = kept > 0 ? recorded_token(tokens, kept - 1) : NULL;
+    if (last != NULL && last->kind == TOKEN_EOF) {
+        // The lexer stopped before the edit.
+        next = len;
+    } else {
+        state->current = state->source + (kept > 0 ? relex_end(tokens, kept - 1) : 0);
+        while (true) {
+            TokenKind kind = next_token(state);
+            const Token* token = &state->token;
+            if (token->start >= new_end) {
+                size_t old_start = token->start - new_end + old_end;
+                while (next < len && relex_start(tokens, next) < old_start) {
+                    next++;
+                }
+                if (next < len && relex_start(tokens, next) == old_start) {
+                    break;
+                }
+            }
+            if (fresh.len == fresh.cap && !reserve_token_buf(&fresh, fresh.len + 1)) {
+                goto no_memory;
+            }
+            fresh.buf[fresh.len++] = *token;
+            if (kind == TOKEN_EOF || kind == TOKEN_ERROR) {
+                next = len;
+                break;
+            }
+        }
+    }
+
+    move_gap(tokens, kept);
+    tokens->gap_end += next - kept;
+    if (!reserve_gap(tokens, fresh.len)) {
+        tokens->gap_end -= next - kept;
+        goto no_memory;
+    }
+    if (fresh.len > 0) {
+        memcpy(tokens->buf + tokens->gap, fresh.buf, fresh.len * sizeof(Token));
+    }
+    tokens->gap += fresh.len;
+    tokens->shift += new_end - old_end;
+    free_token_buf(&fresh);
+    state->strings = strings;
+    return finish_relex(state, tokens);
+
+no_memory:
+    free_token_buf(&fresh);
+    state->strings = strings;
+    state->error = LEXER_ENOMEM;
+    return TOKEN_ERROR;
+}
@@ -0,0 +1,86 @@
+/**
+ * relex.h
+ *
+ * Relex keeps the tokens of a source up to date as it is edited, such as
+ * on each keystroke in an editor, without lexing the whole source again.
+ *
+ * A token only depends on the source from its start to LEXER_LOOKAHEAD
+ * bytes past its end, so the tokens that end far enough before an edit
+ * are kept. Lexing restarts after the last of them and stops as soon as
+ * a new token starts where an old token started after the edit: the source
+ * is the same from there on, and so are the tokens. A last kept token that
+ * is an error is lexed again, since a string with invalid UTF-8 is only
+ * reported at its closing quote.
+ *
+ * The tokens are kept in a gap buffer whose gap follows the edits, and the
+ * tokens after the gap are moved by the edits lazily. An edit thus costs
+ * the tokens it changes, plus the tokens between it and the previous edit,
+ * but not the size of the source.
+ *
+ */
+
+#ifndef RELEX_H
+#define RELEX_H
+
+#include <stddef.h>
+#include "lexer.h"
+
+// LexerEdit is the replacement of `deleted` bytes at `offset` by `inserted`
+// bytes.
+typedef struct LexerEdit {
+    size_t offset;
+    size_t deleted;
+    size_t inserted;
+} LexerEdit;
+
+// RelexBuf is a gap buffer of tokens.
+typedef struct RelexBuf {
+    Token* buf;
+    size_t cap;
+    // The tokens before the gap are at [0, gap), the ones after it at
+    // [gap_end, cap).
+    size_t gap;
+    size_t gap_end;
+    // The tokens after the gap start `shift` bytes after their recorded
+    // start, modulo SIZE_MAX + 1.
+    size_t shift;
+} RelexBuf;
+
+// init_relex_buf initializes an empty buffer.
+void init_relex_buf(RelexBuf* tokens);
+
+// free_relex_buf releases the memory held by the buffer.
+void free_relex_buf(RelexBuf* tokens);
+
+// relex_len returns the number of tokens of the buffer.
+static inline size_t relex_len(const RelexBuf* tokens) {
+    return tokens->gap + (tokens->cap - tokens->gap_end);
+}
+
+// relex_token returns the token at the given index.
+static inline Token relex_token(const RelexBuf* tokens, size_t i) {
+    if (i < tokens->gap) {
+        return tokens->buf[i];
+    }
+    Token token = tokens->buf[tokens->gap_end + (i - tokens->gap)];
+    token.start += tokens->shift;
+    return token;
+}
+
+// relex_all lexes the whole source of the state into the buffer, like
+// `lex_all()`. String literals are not decoded, since the source they
+// would point into changes: `decode_tokens()` decodes the ones needed.
+// Lines and columns are not located.
+TokenKind relex_all(LexerState* state, RelexBuf* tokens);
+
+// relex_edit updates the tokens of the buffer, lexed from the source
+// before the edit, to the tokens of the source of `state`, which has the
+// edit applied. The lexer only runs from the last token unaffected by the
+// edit until the tokens resynchronize.
+//
+// It returns the last token like `lex_all()`, with `state` as if it had
+// lexed the whole source. The tokens are unchanged if the memory for the
+// new ones can't be allocated.
+TokenKind relex_edit(LexerState* state, RelexBuf* tokens, LexerEdit edit);
+
+#endif
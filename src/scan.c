@@ -0,0 +1,471 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "scan.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SCAN_X86
+#include <immintrin.h>
+#endif
+
+static inline bool is_blank(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static const char* skip_blanks_scalar(const char* p, const char* end) {
+    while (p < end && is_blank(*p)) {
+        p++;
+    }
+    return p;
+}
+
+static const char* find_eol_scalar(const char* p, const char* end) {
+    while (p < end && *p != '\n') {
+        p++;
+    }
+    return p;
+}
+
+static const char* find_str_special_scalar(const char* p, const char* end) {
+    for (; p < end; p++) {
+        switch (*p) {
+            case '\\':
+            case '"':
+            case '\n':
+                return p;
+        }
+    }
+    return p;
+}
+
+
+// validate_utf8_from validates the sequences from `p` up to `stop`, and
+// returns the position past the last one, or the first invalid one.
+static inline const char* validate_utf8_from(const char* p, const char* stop, const char* end) {
+    while (p < stop) {
+        size_t len = utf8_char_len(p, end);
+        if (len == 0) {
+            return p;
+        }
+        p += len;
+    }
+    return p;
+}
+
+static const char* validate_utf8_scalar(const char* p, const char* end) {
+    while (p < end) {
+        // Skip ASCII 8 bytes at a time.
+        uint64_t word;
+        if (end - p >= 8) {
+            memcpy(&word, p, 8);
+            if (!(word & 0x8080808080808080ull)) {
+                p += 8;
+                continue;
+            }
+        }
+        const char* stop = end - p >= 8 ? p + 8 : end;
+        const char* q = validate_utf8_from(p, stop, end);
+        if (q < stop) {
+            return q;
+        }
+        p = q;
+    }
+    return end;
+}
+
+#ifdef SCAN_X86
+
+// The vector scanners read whole aligned blocks, which may extend past the
+// end of the input but never past its page. AddressSanitizer can't tell
+// the difference, and neither can ThreadSanitizer, so they are not
+// instrumented.
+#define SCAN_KERNEL(isa) __attribute__((target(isa), no_sanitize_address, no_sanitize_thread))
+
+// found_at returns the position of the first bit of `found` in the block,
+// or `end` if the block has none before `end`. `found` has the bits before
+// the start of the scan cleared.
+static inline const char* found_at(const char* block, uint32_t found, const char* end) {
+    if (found) {
+        const char* p = block + __builtin_ctz(found);
+        return p < end ? p : end;
+    }
+    return end;
+}
+
+SCAN_KERNEL("sse2")
+static const char* skip_blanks_sse2(const char* p, const char* end) {
+    const __m128i sp = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i lf = _mm_set1_epi8('\n');
+
+    if (p >= end) {
+        return end;
+    }
+    // Start from the aligned block containing `p` and pretend that
+    // the bytes before `p` are blanks.
+    unsigned skew = (uintptr_t)p & 15;
+    const char* block = p - skew;
+    uint32_t before = (1u << skew) - 1;
+    while (block < end) {
+        __m128i v = _mm_load_si128((const __m128i*)block);
+        __m128i b = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, sp), _mm_cmpeq_epi8(v, tab)),
+                                 _mm_or_si128(_mm_cmpeq_epi8(v, cr), _mm_cmpeq_epi8(v, lf)));
+        uint32_t other = ~((uint32_t)_mm_movemask_epi8(b) | before) & 0xffff;
+        if (other) {
+            return found_at(block, other, end);
+        }
+        block += 16;
+        before = 0;
+    }
+    return end;
+}
+
+SCAN_KERNEL("sse2")
+static const char* find_eol_sse2(const char* p, const char* end) {
+    const __m128i lf = _mm_set1_epi8('\n');
+
+    if (p >= end) {
+        return end;
+    }
+    unsigned skew = (uintptr_t)p & 15;
+    const char* block = p - skew;
+    uint32_t mask = ~((1u << skew) - 1);
+    while (block < end) {
+        __m128i v = _mm_load_si128((const __m128i*)block);
+        uint32_t found = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, lf)) & mask;
+        if (found) {
+            return found_at(block, found, end);
+        }
+        block += 16;
+        mask = ~0u;
+    }
+    return end;
+}
+
+SCAN_KERNEL("sse2")
+static const char* find_str_special_sse2(const char* p, const char* end) {
+    const __m128i bs = _mm_set1_epi8('\\');
+    const __m128i dq = _mm_set1_epi8('"');
+    const __m128i lf = _mm_set1_epi8('\n');
+
+    if (p >= end) {
+        return end;
+    }
+    unsigned skew = (uintptr_t)p & 15;
+    const char* block = p - skew;
+    uint32_t mask = ~((1u << skew) - 1);
+    while (block < end) {
+        __m128i v = _mm_load_si128((const __m128i*)block);
+        __m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, bs), _mm_cmpeq_epi8(v, dq)),
+                                 _mm_cmpeq_epi8(v, lf));
+        uint32_t found = (uint32_t)_mm_movemask_epi8(m) & mask;
+        if (found) {
+            return found_at(block, found, end);
+        }
+        block += 16;
+        mask = ~0u;
+    }
+    return end;
+}
+
+SCAN_KERNEL("avx2")
+static const char* skip_blanks_avx2(const char* p, const char* end) {
+    const __m256i sp = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i cr = _mm256_set1_epi8('\r');
+    const __m256i lf = _mm256_set1_epi8('\n');
+
+    if (p >= end) {
+        return end;
+    }
+    unsigned skew = (uintptr_t)p & 31;
+    const char* block = p - skew;
+    uint32_t before = (uint32_t)((1ull << skew) - 1);
+    while (block < end) {
+        __m256i v = _mm256_load_si256((const __m256i*)block);
+        __m256i b = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, sp), _mm256_cmpeq_epi8(v, tab)),
+                                    _mm256_or_si256(_mm256_cmpeq_epi8(v, cr), _mm256_cmpeq_epi8(v, lf)));
+        uint32_t other = ~((uint32_t)_mm256_movemask_epi8(b) | before);
+        if (other) {
+            return found_at(block, other, end);
+        }
+        block += 32;
+        before = 0;
+    }
+    return end;
+}
+
+SCAN_KERNEL("avx2")
+static const char* find_eol_avx2(const char* p, const char* end) {
+    const __m256i lf = _mm256_set1_epi8('\n');
+
+    if (p >= end) {
+        return end;
+    }
+    unsigned skew = (uintptr_t)p & 31;
+    const char* block = p - skew;
+    uint32_t mask = ~(uint32_t)((1ull << skew) - 1);
+    while (block < end) {
+        __m256i v = _mm256_load_si256((const __m256i*)block);
+        uint32_t found = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, lf)) & mask;
+        if (found) {
+            return found_at(block, found, end);
+        }
+        block += 32;
+        mask = ~0u;
+    }
+    return end;
+}
+
+SCAN_KERNEL("avx2")
+static const char* find_str_special_avx2(const char* p, const char* end) {
+    const __m256i bs = _mm256_set1_epi8('\\');
+    const __m256i dq = _mm256_set1_epi8('"');
+    const __m256i lf = _mm256_set1_epi8('\n');
+
+    if (p >= end) {
+        return end;
+    }
+    unsigned skew = (uintptr_t)p & 31;
+    const char* block = p - skew;
+    uint32_t mask = ~(uint32_t)((1ull << skew) - 1);
+    while (block < end) {
+        __m256i v = _mm256_load_si256((const __m256i*)block);
+        __m256i m = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, bs), _mm256_cmpeq_epi8(v, dq)),
+                                    _mm256_cmpeq_epi8(v, lf));
+        uint32_t found = (uint32_t)_mm256_movemask_epi8(m) & mask;
+        if (found) {
+            return found_at(block, found, end);
+        }
+        block += 32;
+        mask = ~0u;
+    }
+    return end;
+}
+
+
+// The UTF-8 validators load whole blocks inside [p, end) only, so they can
+// be given any slice.
+
+SCAN_KERNEL("sse2")
+static const char* validate_utf8_sse2(const char* p, const char* end) {
+    while (p < end) {
+        if (end - p >= 16) {
+            __m128i v = _mm_loadu_si128((const __m128i*)p);
+            if (_mm_movemask_epi8(v) == 0) {
+                p += 16;
+                continue;
+            }
+        }
+        const char* stop = end - p >= 16 ? p + 16 : end;
+        const char* q = validate_utf8_from(p, stop, end);
+        if (q < stop) {
+            return q;
+        }
+        p = q;
+    }
+    return end;
+}
+
+// The errors of the UTF-8 lookup tables. Each table maps a nibble of the
+// input to the errors it allows, and a pair of bytes is invalid where the
+// three tables have an error in common.
+#define UTF8_TOO_SHORT   (1 << 0)
+#define UTF8_TOO_LONG    (1 << 1)
+#define UTF8_OVERLONG_3  (1 << 2)
+#define UTF8_TOO_LARGE   (1 << 3)
+#define UTF8_SURROGATE   (1 << 4)
+#define UTF8_OVERLONG_2  (1 << 5)
+#define UTF8_TOO_LARGE_1000 (1 << 6)
+#define UTF8_OVERLONG_4  (1 << 6)
+#define UTF8_TWO_CONTS   (1 << 7)
+#define UTF8_CARRY       (UTF8_TOO_SHORT | UTF8_TOO_LONG | UTF8_TWO_CONTS)
+
+#define UTF8_TABLE(...) _mm256_setr_epi8(__VA_ARGS__, __VA_ARGS__)
+
+// prev_bytes returns the input shifted right by `n` bytes across blocks,
+// so that each byte lines up with the byte `n` before it.
+#define prev_bytes(input, prev, n) \
+    _mm256_alignr_epi8((input), _mm256_permute2x128_si256((prev), (input), 0x21), 16 - (n))
+
+SCAN_KERNEL("avx2")
+static inline __m256i utf8_errors_avx2(__m256i input, __m256i prev_input) {
+    const __m256i byte_1_high_table = UTF8_TABLE(
+        // 0xxx ASCII followed by a continuation.
+        UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+        UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+        // 10xx continuation followed by a continuation.
+        UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS,
+        // 1100 and 1101 two byte leads.
+        UTF8_TOO_SHORT | UTF8_OVERLONG_2,
+        UTF8_TOO_SHORT,
+        // 1110 three byte lead.
+        UTF8_TOO_SHORT | UTF8_OVERLONG_3 | UTF8_SURROGATE,
+        // 1111 four byte lead.
+        UTF8_TOO_SHORT | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4);
+    const __m256i byte_1_low_table = UTF8_TABLE(
+        UTF8_CARRY | UTF8_OVERLONG_3 | UTF8_OVERLONG_2 | UTF8_OVERLONG_4,
+        UTF8_CARRY | UTF8_OVERLONG_2,
+        UTF8_CARRY,
+        UTF8_CARRY,
+        UTF8_CARRY | UTF8_TOO_LARGE,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_SURROGATE,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000);
+    const __m256i byte_2_high_table = UTF8_TABLE(
+        // 0xxx ASCII after a lead.
+        UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+        UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+        // 1000, 1001 and 101x continuations.
+        UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4,
+        UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE,
+        UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE | UTF8_TOO_LARGE,
+        UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE | UTF8_TOO_LARGE,
+        // 11xx lead after a lead.
+        UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT);
+    const __m256i nibble = _mm256_set1_epi8(0x0f);
+
+    __m256i prev1 = prev_bytes(input, prev_input, 1);
+    __m256i byte_1_high = _mm256_shuffle_epi8(byte_1_high_table,
+                                              _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble));
+    __m256i byte_1_low = _mm256_shuffle_epi8(byte_1_low_table, _mm256_and_si256(prev1, nibble));
+    __m256i byte_2_high = _mm256_shuffle_epi8(byte_2_high_table,
+                                              _mm256_and_si256(_mm256_srli_epi16(input, 4), nibble));
+    __m256i special = _mm256_and_si256(_mm256_and_si256(byte_1_high, byte_1_low), byte_2_high);
+
+    // The third and fourth bytes of a sequence must be continuations,
+    // which the tables flag as two continuations in a row.
+    __m256i prev2 = prev_bytes(input, prev_input, 2);
+    __m256i prev3 = prev_bytes(input, prev_input, 3);
+    __m256i third = _mm256_subs_epu8(prev2, _mm256_set1_epi8((char)(0xe0 - 0x80)));
+    __m256i fourth = _mm256_subs_epu8(prev3, _mm256_set1_epi8((char)(0xf0 - 0x80)));
+    __m256i must_be_cont = _mm256_and_si256(_mm256_or_si256(third, fourth), _mm256_set1_epi8((char)0x80));
+    return _mm256_xor_si256(must_be_cont, special);
+}
+
+SCAN_KERNEL("avx2")
+static const char* validate_utf8_avx2(const char* p, const char* end) {
+    // The last three bytes of a block that start sequences too long to
+    // end in it.
+    const __m256i incomplete_max = _mm256_setr_epi8(
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        (char)(0xf0 - 1), (char)(0xe0 - 1), (char)(0xc0 - 1));
+
+    const char* start = p;
+    __m256i prev_input = _mm256_setzero_si256();
+    __m256i prev_incomplete = _mm256_setzero_si256();
+    while (true) {
+        __m256i input;
+        if (end - p >= 32) {
+            input = _mm256_loadu_si256((const __m256i*)p);
+        } else if (p < end) {
+            // Pad the last block with zeros, which end any sequence too
+            // short as if it was followed by ASCII.
+            char last[32] = {0};
+            memcpy(last, p, end - p);
+            input = _mm256_loadu_si256((const __m256i*)last);
+        } else {
+            if (_mm256_testz_si256(prev_incomplete, prev_incomplete)) {
+                return end;
+            }
+            break;
+        }
+        __m256i errors;
+        if (_mm256_movemask_epi8(input) == 0) {
+            errors = prev_incomplete;
+            prev_incomplete = _mm256_setzero_si256();
+        } else {
+            errors = utf8_errors_avx2(input, prev_input);
+            prev_incomplete = _mm256_subs_epu8(input, incomplete_max);
+        }
+        if (!_mm256_testz_si256(errors, errors)) {
+            break;
+        }
+        if (end - p < 32) {
+            return end;
+        }
+        prev_input = input;
+        p += 32;
+    }
+    // The blocks before `p` are valid, but their last sequence may cross
+    // into the next one. Find the invalid sequence from its lead byte.
+    const char* q = p;
+    for (int i = 0; i < 3 && q > start; i++) {
+        q--;
+        if ((*q & 0xc0) == 0xc0) {
+            p = q;
+            break;
+        }
+        if (!(*q & 0x80)) {
+            break;
+        }
+    }
+    return validate_utf8_scalar(p, end);
+}
+
+#undef prev_bytes
+#undef UTF8_TABLE
+
+#endif
+
+static const Scanner scanners[] = {
+    [SCAN_SCALAR] = { skip_blanks_scalar, find_eol_scalar, find_str_special_scalar, validate_utf8_scalar },
+#ifdef SCAN_X86
+    [SCAN_SSE2] = { skip_blanks_sse2, find_eol_sse2, find_str_special_sse2, validate_utf8_sse2 },
+    [SCAN_AVX2] = { skip_blanks_avx2, find_eol_avx2, find_str_special_avx2, validate_utf8_avx2 },
+#endif
+};
+
+Scanner scanner = { skip_blanks_scalar, find_eol_scalar, find_str_special_scalar, validate_utf8_scalar };
+
+static ScanLevel scan_level = SCAN_SCALAR;
+
+static bool is_supported(ScanLevel level) {
+    switch (level) {
+        case SCAN_SCALAR:
+            return true;
+#ifdef SCAN_X86
+        case SCAN_SSE2:
+            return __builtin_cpu_supports("sse2");
+        case SCAN_AVX2:
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+    }
+}
+
+ScanLevel set_scan_level(ScanLevel level) {
+    while (!is_supported(level)) {
+        level--;
+    }
+    scanner = scanners[level];
+    scan_level = level;
+    return level;
+}
+
+ScanLevel get_scan_level(void) {
+    return scan_level;
+}
+
+#ifdef __GNUC__
+// init_scanner selects the best scanners before main() runs, so that the
+// dispatch table is never written while lexers run on other threads.
+__attribute__((constructor))
+static void init_scanner(void) {
+#ifdef SCAN_X86
+    __builtin_cpu_init();
+#endif
+    set_scan_level(SCAN_AVX2);
+}
+#endif
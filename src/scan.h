@@ -0,0 +1,102 @@
+/**
+ * scan.h
+ *
+ * Vectorized byte scanners used by the lexer hot loops.
+ *
+ * Every scanner has a scalar implementation and, on x86, SSE2 and AVX2
+ * implementations. The best one supported by the CPU is selected at
+ * startup and can be overridden with `set_scan_level()`.
+ *
+ * The scanners stop at `end`. The vector scanners only issue aligned loads
+ * of blocks starting before `end`, so they may read up to 31 bytes past
+ * it, but never across a page boundary.
+ *
+ * The UTF-8 validator skips ASCII a block at a time at every level. The
+ * AVX2 one checks multibyte sequences with the lookup tables of Keiser and
+ * Lemire ("Validating UTF-8 In Less Than One Instruction Per Byte"), the
+ * others decode them one at a time.
+ *
+ */
+
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <stddef.h>
+
+typedef enum ScanLevel {
+    SCAN_SCALAR,
+    SCAN_SSE2,
+    SCAN_AVX2,
+} ScanLevel;
+
+// Scanner is the dispatch table of the selected scanners.
+typedef struct Scanner {
+    // skip_blanks returns the first byte in [p, end) that is not
+    // a space, tab, carriage return or newline, or `end`.
+    const char* (*skip_blanks)(const char* p, const char* end);
+    // find_eol returns the first newline in [p, end), or `end`.
+    const char* (*find_eol)(const char* p, const char* end);
+    // find_str_special returns the first backslash, double quote or
+    // newline in [p, end), or `end`.
+    const char* (*find_str_special)(const char* p, const char* end);
+    // validate_utf8 returns the first byte in [p, end) that doesn't start
+    // a valid UTF-8 sequence ending before `end`, or `end`.
+    const char* (*validate_utf8)(const char* p, const char* end);
+} Scanner;
+
+extern Scanner scanner;
+
+// utf8_char_len returns the length of the UTF-8 sequence at `p`, or 0 if
+// it is not a well-formed sequence ending before `end`. Overlong forms,
+// surrogates and code points past U+10FFFF are not well-formed.
+static inline size_t utf8_char_len(const char* p, const char* end) {
+    const unsigned char* s = (const unsigned char*)p;
+    size_t avail = end - p;
+    if (avail == 0) {
+        return 0;
+    }
+    unsigned char c = s[0];
+    if (c < 0x80) {
+        return 1;
+    }
+    // The length of the sequence and the range of its second byte.
+    size_t len;
+    unsigned char lo = 0x80, hi = 0xbf;
+    if (c >= 0xc2 && c <= 0xdf) {
+        len = 2;
+    } else if (c >= 0xe0 && c <= 0xef) {
+        len = 3;
+        if (c == 0xe0) {
+            lo = 0xa0;
+        } else if (c == 0xed) {
+            hi = 0x9f;
+        }
+    } else if (c >= 0xf0 && c <= 0xf4) {
+        len = 4;
+        if (c == 0xf0) {
+            lo = 0x90;
+        } else if (c == 0xf4) {
+            hi = 0x8f;
+        }
+    } else {
+        return 0;
+    }
+    if (avail < len || s[1] < lo || s[1] > hi) {
+        return 0;
+    }
+    for (size_t i = 2; i < len; i++) {
+        if ((s[i] & 0xc0) != 0x80) {
+            return 0;
+        }
+    }
+    return len;
+}
+
+// set_scan_level selects the scanners of the given level, or the best
+// level below it that is supported by the CPU. It returns the selected level.
+ScanLevel set_scan_level(ScanLevel level);
+
+// get_scan_level returns the level of the selected scanners.
+ScanLevel get_scan_level(void);
+
+#endif
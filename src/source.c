@@ -0,0 +1,107 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "source.h"
+
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+// SOURCE_PADDING is the number of zero bytes after the text of a source
+// that is read into memory, enough for one vector block.
+#define SOURCE_PADDING 64
+
+// map_file maps `len` bytes of the file followed by a zero page.
+// The whole range is reserved as anonymous zero pages first, then the
+// file is mapped over its beginning.
+static int map_file(Source* src, int fd, size_t len) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t size = (len + page - 1) / page * page + page;
+    void* base = mmap(NULL, size, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        return errno;
+    }
+    if (len > 0 && mmap(base, len, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        int err = errno;
+        munmap(base, size);
+        return err;
+    }
+#ifdef MADV_SEQUENTIAL
+    madvise(base, size, MADV_SEQUENTIAL);
+#endif
+    src->text = base;
+    src->len = len;
+    src->base = base;
+    src->size = size;
+    src->mapped = true;
+    return 0;
+}
+
+// read_file reads a file that can't be mapped, such as a pipe.
+static int read_file(Source* src, int fd) {
+    size_t cap = 4096, len = 0;
+    char* buf = NULL;
+    while (true) {
+        if (buf == NULL || cap - len < SOURCE_PADDING) {
+            cap *= 2;
+            char* grown = realloc(buf, cap);
+            if (grown == NULL) {
+                free(buf);
+                return ENOMEM;
+            }
+            buf = grown;
+        }
+        ssize_t n = read(fd, buf + len, cap - len - SOURCE_PADDING);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            int err = errno;
+            free(buf);
+            return err;
+        }
+        if (n == 0) {
+            break;
+        }
+        len += (size_t)n;
+    }
+    memset(buf + len, 0, SOURCE_PADDING);
+    src->text = buf;
+    src->len = len;
+    src->base = buf;
+    src->size = cap;
+    src->mapped = false;
+    return 0;
+}
+
+int open_source(Source* src, const char* path) {
+    memset(src, 0, sizeof(*src));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return errno;
+    }
+    struct stat st;
+    int err = 0;
+    if (fstat(fd, &st) != 0) {
+        err = errno;
+    } else if (S_ISREG(st.st_mode)) {
+        err = map_file(src, fd, (size_t)st.st_size);
+    } else {
+        err = read_file(src, fd);
+    }
+    close(fd);
+    return err;
+}
+
+void close_source(Source* src) {
+    if (src->mapped) {
+        munmap(src->base, src->size);
+    } else {
+        free(src->base);
+    }
+    memset(src, 0, sizeof(*src));
+}
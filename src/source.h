@@ -0,0 +1,38 @@
+/**
+ * source.h
+ *
+ * Source loads source files for the lexer and the parser.
+ *
+ * Regular files are mapped read-only instead of being read and copied.
+ * The mapping is followed by at least one zero page, so the text is always
+ * terminated by a '\0' sentinel and the vector scanners can read whole
+ * aligned blocks past its end without faulting.
+ *
+ */
+
+#ifndef SOURCE_H
+#define SOURCE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct Source {
+    // The text of the source, followed by a '\0' sentinel.
+    const char* text;
+    // The length of the text in bytes, without the sentinel.
+    size_t len;
+    // The reserved address range, including the zero pages.
+    void*  base;
+    size_t size;
+    // Whether the text is mapped from the file or read into memory.
+    bool   mapped;
+} Source;
+
+// open_source loads the file at the given path.
+// It returns 0 on success, or an errno value on failure.
+int open_source(Source* src, const char* path);
+
+// close_source releases the source loaded by `open_source()`.
+void close_source(Source* src);
+
+#endif
@@ -0,0 +1,259 @@
+#include <stdlib.h>
+#include <string.h>
+#include "scan.h"
+#include "stream.h"
+
+// STREAM_MIN_TAKE is the least number of bytes of a chunk copied to the
+// carry buffer at once. Each retry doubles it.
+#define STREAM_MIN_TAKE 64
+
+void init_stream_lexer(StreamLexer* stream) {
+    memset(stream, 0, sizeof(*stream));
+}
+
+void free_stream_lexer(StreamLexer* stream) {
+    free_lexer_state(&stream->state);
+    free(stream->carry);
+    init_stream_lexer(stream);
+}
+
+void feed_stream_lexer(StreamLexer* stream, const char* chunk, size_t len) {
+    stream->chunk_offset += stream->chunk_len;
+    stream->chunk = chunk;
+    stream->chunk_len = len;
+    stream->pos = 0;
+}
+
+void finish_stream_lexer(StreamLexer* stream) {
+    stream->finished = true;
+}
+
+// ends_in_comment returns whether the blanks and comments from `p` to `end`
+// end inside a line comment.
+static bool ends_in_comment(const char* p, const char* end) {
+    while (true) {
+        p = scanner.skip_blanks(p, end);
+        if (p == end) {
+            return false;
+        }
+        // Anything else than a blank starts a comment here.
+        p = scanner.find_eol(p + 1, end);
+        if (p == end) {
+            return true;
+        }
+        p++;
+    }
+}
+
+// reserve_carry makes room for at least `size` bytes in the carry buffer.
+static bool reserve_carry(StreamLexer* stream, size_t size) {
+    if (stream->carry_cap >= size) {
+        return true;
+    }
+    size_t cap = stream->carry_cap == 0 ? 256 : stream->carry_cap;
+    while (cap < size) {
+        cap <<= 1;
+    }
+    char* carry = realloc(stream->carry, cap);
+    if (carry == NULL) {
+        return false;
+    }
+    stream->carry = carry;
+    stream->carry_cap = cap;
+    return true;
+}
+
+// fail_no_memory reports that the memory for a token can't be allocated.
+static TokenKind fail_no_memory(StreamLexer* stream) {
+    stream->state.error = LEXER_ENOMEM;
+    stream->token.kind = TOKEN_ERROR;
+    stream->token.len = 0;
+    return TOKEN_ERROR;
+}
+
+// lex_window lexes the next token of the `len` bytes at `window` from `pos`.
+// It returns TOKEN_NEED_INPUT if the token may continue past the window,
+// unless it is the last window of the stream.
+static TokenKind lex_window(StreamLexer* stream, const char* window, size_t len, size_t pos, bool last) {
+    LexerState* state = &stream->state;
+    // Tokens may be lexed again once more input comes, so they are only
+    // interned and decoded by `emit()`.
+    InternPool* pool = state->intern;
+    Arena* strings = state->strings;
+    init_lexer_slice(state, window, len);
+    state->current = window + pos;
+    TokenKind kind = next_token(state);
+    state->intern = pool;
+    state->strings = strings;
+    const Token* token = &state->token;
+    // A token is final once LEXER_LOOKAHEAD bytes follow it, otherwise it
+    // may still change with more input.
+    if (kind != TOKEN_EOF && !last && token->start + token->len + LEXER_LOOKAHEAD > len) {
+        return TOKEN_NEED_INPUT;
+    }
+    return kind;
+}
+
+// emit records the token of the lexer, lexed from `window` which is at
+// `offset` in the stream.
+static TokenKind emit(StreamLexer* stream, const char* window, size_t offset) {
+    LexerState* state = &stream->state;
+    if (state->intern != NULL && !intern_tokens(state, &state->token, 1)) {
+        return fail_no_memory(stream);
+    }
+    if (state->strings != NULL) {
+        if (!decode_tokens(state, &state->token, 1)) {
+            return fail_no_memory(stream);
+        }
+        TokenStr* str = &state->token.value.str;
+        if (state->token.kind == TOKEN_STR_LITERAL && window == stream->carry &&
+            str->text >= window && str->text < window + stream->carry_len) {
+            // The carry buffer is reused, keep the value in the arena.
+            char* copy = arena_alloc(state->strings, str->len, 1);
+            if (copy == NULL) {
+                return fail_no_memory(stream);
+            }
+            memcpy(copy, str->text, str->len);
+            str->text = copy;
+        }
+    }
+    Token* token = &stream->token;
+    *token = stream->state.token;
+    stream->text = window + token->start;
+    token->start += offset;
+    return token->kind;
+}
+
+// leave_carry drops the carry buffer once only blanks and comments are left
+// in it, and goes on in the chunk.
+static void leave_carry(StreamLexer* stream) {
+    if (stream->carry_pos < stream->carried) {
+        stream->in_comment = ends_in_comment(stream->carry + stream->carry_pos,
+                                             stream->carry + stream->carried);
+    } else if (stream->pos == 0) {
+        stream->pos = stream->carry_pos - stream->carried;
+    }
+    stream->carry_len = 0;
+}
+
+// next_carry_token lexes the next token from the carry buffer, taking more
+// of the chunk until the token is complete. It returns false when the
+// carry buffer is left and the chunk goes on.
+static bool next_carry_token(StreamLexer* stream, TokenKind* kind) {
+    const Token* token = &stream->state.token;
+    while (true) {
+        size_t taken = stream->carry_len - stream->carried;
+        size_t avail = stream->pos == 0 ? stream->chunk_len - taken : 0;
+        bool last = stream->finished && avail == 0;
+        *kind = lex_window(stream, stream->carry, stream->carry_len, stream->carry_pos, last);
+        if (*kind == TOKEN_EOF && !last) {
+            leave_carry(stream);
+            return false;
+        }
+        if (*kind != TOKEN_NEED_INPUT) {
+            break;
+        }
+        if (token->start >= stream->carried && stream->pos == 0) {
+            // The token starts in the chunk, lex it in place.
+            stream->pos = token->start - stream->carried;
+            stream->carry_len = 0;
+            return false;
+        }
+        // Drop the bytes before the token.
+        size_t start = token->start;
+        memmove(stream->carry, stream->carry + start, stream->carry_len - start);
+        stream->carry_len -= start;
+        stream->carried -= start;
+        stream->carry_offset += start;
+        stream->carry_pos = 0;
+        if (avail == 0) {
+            // Wait for the next chunk with the whole token carried.
+            stream->carried = stream->carry_len;
+            stream->pos = stream->chunk_len;
+            return true;
+        }
+        size_t n = taken > STREAM_MIN_TAKE ? taken : STREAM_MIN_TAKE;
+        n = n < avail ? n : avail;
+        if (!reserve_carry(stream, stream->carry_len + n)) {
+            *kind = fail_no_memory(stream);
+            return true;
+        }
+        memcpy(stream->carry + stream->carry_len, stream->chunk + taken, n);
+        stream->carry_len += n;
+    }
+    *kind = emit(stream, stream->carry, stream->carry_offset);
+    if (*kind == TOKEN_ERROR || *kind == TOKEN_EOF) {
+        return true;
+    }
+    size_t end = token->start + token->len;
+    if (end >= stream->carried && stream->pos == 0) {
+        stream->pos = end - stream->carried;
+        stream->carry_len = 0;
+    } else {
+        stream->carry_pos = end;
+    }
+    return true;
+}
+
+// next_chunk_token lexes the next token in place in the chunk. A token
+// that may continue in the next chunk is moved to the carry buffer.
+static TokenKind next_chunk_token(StreamLexer* stream) {
+    const char* chunk = stream->chunk;
+    size_t len = stream->chunk_len;
+    if (stream->in_comment && stream->pos < len) {
+        const char* eol = scanner.find_eol(chunk + stream->pos, chunk + len);
+        stream->in_comment = eol == chunk + len;
+        stream->pos = stream->in_comment ? len : (size_t)(eol + 1 - chunk);
+    }
+    if (stream->pos == len) {
+        if (!stream->finished) {
+            return TOKEN_NEED_INPUT;
+        }
+        memset(&stream->token, 0, sizeof(stream->token));
+        stream->token.kind = TOKEN_EOF;
+        stream->token.start = stream->chunk_offset + len;
+        stream->text = "";
+        return TOKEN_EOF;
+    }
+    LexerState* state = &stream->state;
+    TokenKind kind = lex_window(stream, chunk, len, stream->pos, stream->finished);
+    if (kind == TOKEN_EOF && !stream->finished) {
+        stream->in_comment = ends_in_comment(chunk + stream->pos, chunk + len);
+        stream->pos = len;
+        return TOKEN_NEED_INPUT;
+    }
+    if (kind == TOKEN_NEED_INPUT) {
+        size_t start = state->token.start;
+        if (!reserve_carry(stream, len - start)) {
+            return fail_no_memory(stream);
+        }
+        memcpy(stream->carry, chunk + start, len - start);
+        stream->carry_len = len - start;
+        stream->carried = len - start;
+        stream->carry_pos = 0;
+        stream->carry_offset = stream->chunk_offset + start;
+        stream->pos = len;
+        return TOKEN_NEED_INPUT;
+    }
+    kind = emit(stream, chunk, stream->chunk_offset);
+    if (kind != TOKEN_ERROR && kind != TOKEN_EOF) {
+        // Blanks up to the end may end in a comment, leave them to the
+        // next call to find out.
+        if (state->current < state->end) {
+            stream->pos = state->current - chunk;
+        } else {
+            stream->pos = state->token.start + state->token.len;
+        }
+    }
+    return kind;
+}
+
+TokenKind next_stream_token(StreamLexer* stream) {
+    if (stream->carry_len > 0) {
+        TokenKind kind;
+        if (next_carry_token(stream, &kind)) {
+            return kind;
+        }
+    }
+    return next_chunk_token(stream);
+}
@@ -0,0 +1,76 @@
+/**
+ * stream.h
+ *
+ * StreamLexer tokenizes a source that arrives in chunks, such as a pipe,
+ * without holding the whole source in memory.
+ *
+ * Tokens are lexed in place in each chunk. A token that may continue past
+ * the end of a chunk is copied to a small carry buffer and completed with
+ * the start of the next chunk, so the memory used is bounded by the chunk
+ * size and the longest token, not by the size of the source.
+ *
+ */
+
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "lexer.h"
+
+typedef struct StreamLexer {
+    // The lexer of the chunk or the carry buffer being lexed.
+    LexerState state;
+    // The last token, with its offset from the start of the stream.
+    // The value of a string literal without escapes is a slice of the
+    // chunk it was lexed from, or a copy in the arena if it straddled
+    // chunks.
+    Token token;
+    // The text of the last token, valid until the next call.
+    const char* text;
+    // The current chunk, the stream offset of its start, and the
+    // position in it. The chunk is exhausted when `pos == chunk_len`.
+    const char* chunk;
+    size_t chunk_len;
+    size_t chunk_offset;
+    size_t pos;
+    // The carry buffer holds a token that straddles chunks: `carried`
+    // bytes from the earlier chunks, followed by a copy of the start of
+    // the current chunk up to `carry_len`. It is lexed from `carry_pos`,
+    // and `carry_offset` is the stream offset of its start.
+    char*  carry;
+    size_t carry_cap;
+    size_t carry_len;
+    size_t carried;
+    size_t carry_pos;
+    size_t carry_offset;
+    // Whether the last chunk ended inside a line comment.
+    bool in_comment;
+    // Whether the end of the stream has been reached.
+    bool finished;
+} StreamLexer;
+
+// init_stream_lexer initializes a stream lexer without input.
+void init_stream_lexer(StreamLexer* stream);
+
+// free_stream_lexer releases the memory held by the stream lexer.
+void free_stream_lexer(StreamLexer* stream);
+
+// feed_stream_lexer gives the next `len` bytes of the stream to the lexer.
+// It must only be called after `next_stream_token()` has returned
+// TOKEN_NEED_INPUT, and the chunk must stay valid until it does so again.
+void feed_stream_lexer(StreamLexer* stream, const char* chunk, size_t len);
+
+// finish_stream_lexer marks the chunk fed last as the end of the stream,
+// so that the tokens at its end are completed and the stream ends with
+// TOKEN_EOF instead of TOKEN_NEED_INPUT.
+void finish_stream_lexer(StreamLexer* stream);
+
+// next_stream_token returns the next token of the stream, or
+// TOKEN_NEED_INPUT when the chunk is exhausted before the end of the
+// stream. The token is kept in `stream->token` and its text in
+// `stream->text`. On failure, the error is kept in `stream->state.error`.
+// The tokens are interned to `stream->state.intern` if it is set.
+TokenKind next_stream_token(StreamLexer* stream);
+
+#endif
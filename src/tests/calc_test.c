@@ -0,0 +1,73 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "calc.h"
+#include "../test.h"
+
+// parse_calc parses `text` once, giving at most `chunk` bytes per read,
+// and returns the results of its statements.
+static calc_input_t parse_calc(const char *text, size_t len, size_t chunk) {
+    calc_input_t input = {0};
+    input.text = text;
+    input.len = len;
+    input.chunk = chunk;
+    calc_context_t *ctx = calc_create(&input);
+    calc_parse(ctx, NULL);
+    calc_destroy(ctx);
+    return input;
+}
+
+static void test_statements(size_t chunk) {
+    const char *text = "1 + 2; 3 * 4;\n(5 - 1) * 2 ;\n 7 - 2 - 1;";
+    calc_input_t input = parse_calc(text, strlen(text), chunk);
+    TEST_ASSERT(input.errors == 0);
+    TEST_ASSERT(input.count == 4);
+    TEST_ASSERT(input.results[0] == 3);
+    TEST_ASSERT(input.results[1] == 12);
+    TEST_ASSERT(input.results[2] == 8);
+    TEST_ASSERT(input.results[3] == 4);
+}
+
+// The statements before a syntax error are committed, so their actions
+// have run when the error is reported.
+static void test_error(size_t chunk) {
+    const char *text = "1 + 2; (3 * 4); 3 * ; 4;";
+    calc_input_t input = parse_calc(text, strlen(text), chunk);
+    TEST_ASSERT(input.errors == 1);
+    TEST_ASSERT(input.count == 2);
+    TEST_ASSERT(input.results[0] == 3);
+    TEST_ASSERT(input.results[1] == 12);
+
+    input = parse_calc("", 0, chunk);
+    TEST_ASSERT(input.errors == 0 && input.count == 0);
+    input = parse_calc("1 +", 3, chunk);
+    TEST_ASSERT(input.errors == 1 && input.count == 0);
+}
+
+// A long input is committed many times over, and read in many blocks.
+static void test_long_input(size_t chunk) {
+    const long n = 20000;
+    char *text = malloc(n * 16);
+    size_t len = 0;
+    for (long i = 1; i <= n; i++) {
+        len += sprintf(text + len, "%ld * 2 - 1;\n", i);
+    }
+    calc_input_t input = parse_calc(text, len, chunk);
+    TEST_ASSERT(input.errors == 0);
+    TEST_ASSERT(input.count == (size_t)n);
+    TEST_ASSERT(input.sum == n * n);
+    free(text);
+}
+
+int main(int argc, char **argv) {
+    static const size_t chunks[] = {1, 7, 1 << 20};
+    TEST_BEGIN(("%s", argv[0]));
+    for (size_t i = 0; i < sizeof(chunks) / sizeof(chunks[0]); i++) {
+        test_statements(chunks[i]);
+        test_error(chunks[i]);
+        test_long_input(chunks[i]);
+    }
+    TEST_END();
+    return 0;
+}
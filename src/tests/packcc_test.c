@@ -0,0 +1,71 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../test.h"
+
+#define PACKCC_TEST_INPUT "build/packcc_input.peg"
+
+// run_packcc runs src/packcc on `grammar` and returns its exit status,
+// with its messages in `output`.
+static int run_packcc(const char *grammar, char *output, size_t size) {
+    FILE *file = fopen(PACKCC_TEST_INPUT, "w");
+    if (file == NULL) return -1;
+    fputs(grammar, file);
+    fclose(file);
+    FILE *pipe = popen("src/packcc -o build/packcc_output " PACKCC_TEST_INPUT " 2>&1", "r");
+    if (pipe == NULL) return -1;
+    size_t len = fread(output, 1, size - 1, pipe);
+    output[len] = '\0';
+    return pclose(pipe);
+}
+
+#define TEST_PACKCC_PASS(grammar) {\
+    char output[1024]; \
+    const int status = run_packcc((grammar), output, sizeof(output)); \
+    TEST_ASSERT(status == 0); \
+    TEST_ASSERT_MSG(output[0] == '\0', ("%s", output)); \
+}
+
+#define TEST_PACKCC_FAILED(grammar, message) {\
+    char output[1024]; \
+    const int status = run_packcc((grammar), output, sizeof(output)); \
+    TEST_ASSERT(status != 0); \
+    TEST_ASSERT_MSG(strstr(output, (message)) != NULL, ("%s", output)); \
+}
+
+int main(int argc, char **argv) {
+    TEST_BEGIN(("packcc_test"));
+    TEST_PACKCC_PASS(
+        "%commit \"b\"\n%memo \"c\"\n%nomemo \"b\"\n"
+        "a <- b* !.\nb <- c ';'\nc <- [0-9]+\n");
+    TEST_PACKCC_FAILED(
+        "%nomemo \"x\"\na <- 'a'\n",
+        "No definition of rule 'x' in %nomemo");
+    TEST_PACKCC_FAILED(
+        "%memo \"x\"\na <- 'a'\n",
+        "No definition of rule 'x' in %memo");
+    TEST_PACKCC_FAILED(
+        "%memo \"b\"\n%nomemo \"b\"\na <- b\nb <- 'b'\n",
+        "Rule 'b' in both %memo and %nomemo");
+    TEST_PACKCC_FAILED(
+        "%nomemo \"e\"\ne <- e '+' 'n' / 'n'\n",
+        "Left-recursive rule 'e' not allowed with %nomemo");
+    TEST_PACKCC_FAILED(
+        "%commit \"x\"\na <- b*\nb <- 'b'\n",
+        "No definition of rule 'x' in %commit");
+    TEST_PACKCC_FAILED(
+        "%commit \"b\"\na <- b*\nb <- 'b' a?\n",
+        "Start rule 'a' referenced by rules not allowed with %commit");
+    TEST_PACKCC_FAILED(
+        "%commit \"b\"\na <- b* { }\nb <- 'b'\n",
+        "Start rule 'a' with actions or error handlers not allowed with %commit");
+    TEST_PACKCC_FAILED(
+        "%commit \"b\"\na <- (b / 'c')*\nb <- 'b'\n",
+        "Rule 'b' in %commit not referenced by the start rule outside of alternatives, predicates and captures");
+    TEST_PACKCC_FAILED(
+        "%commit \"1b\"\na <- b*\nb <- 'b'\n",
+        "Invalid identifier");
+    TEST_END();
+    return 0;
+}